@@ -0,0 +1,328 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "BlockCache.h"
+
+#include <climits>
+
+CBlockCache::CBlockCache()
+	: m_pStream(NULL)
+	, m_cbFile(0)
+	, m_cbBlock(0)
+	, m_cReadAheadBlocks(0)
+	, m_pArena(NULL)
+	, m_useClock(0)
+	, m_lastBlock(ULLONG_MAX)
+	, m_cReadAheadWindow(0)
+	, m_stats()
+{
+}
+
+CBlockCache::~CBlockCache()
+{
+	Reset();
+}
+
+HRESULT CBlockCache::Init(IStream* pStream, ULONGLONG cbFile, DWORD cbBlock, DWORD cbBudget, DWORD cReadAheadBlocks)
+{
+	Reset();
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	DWORD cbPage = si.dwPageSize;
+	if (cbBlock < cbPage)
+	{
+		cbBlock = cbPage;
+	}
+	cbBlock = (cbBlock + cbPage - 1) / cbPage * cbPage;
+
+	// no more slots than the file has blocks: a small file doesn't commit the whole budget
+	DWORD cSlots = cbBudget / cbBlock;
+	ULONGLONG cFileBlocks = (cbFile + cbBlock - 1) / cbBlock;
+	if (cFileBlocks < cSlots)
+	{
+		cSlots = static_cast<DWORD>(cFileBlocks);
+	}
+	if (cSlots != 0)
+	{
+		m_pArena = static_cast<BYTE*>(VirtualAlloc(NULL, static_cast<SIZE_T>(cSlots) * cbBlock, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		if (m_pArena == NULL)
+		{
+			return E_OUTOFMEMORY;
+		}
+		m_slots.assign(cSlots, Slot());
+		m_blockToSlot.reserve(cSlots);
+	}
+
+	// Read-ahead may use at most half of the cache, otherwise it would evict the blocks it is about to serve.
+	DWORD cMaxReadAhead = cSlots / 2;
+	m_cReadAheadBlocks = (cReadAheadBlocks < cMaxReadAhead) ? cReadAheadBlocks : cMaxReadAhead;
+
+	m_pStream = pStream;
+	m_pStream->AddRef();
+	m_cbFile = cbFile;
+	m_cbBlock = cbBlock;
+	return S_OK;
+}
+
+void CBlockCache::Reset()
+{
+	if (m_pStream)
+	{
+		m_pStream->Release();
+		m_pStream = NULL;
+	}
+	if (m_pArena)
+	{
+		VirtualFree(m_pArena, 0, MEM_RELEASE);
+		m_pArena = NULL;
+	}
+	m_slots.clear();
+	m_blockToSlot.clear();
+	m_run.clear();
+	m_useClock = 0;
+	m_lastBlock = ULLONG_MAX;
+	m_cReadAheadWindow = 0;
+	m_stats = Stats();
+}
+
+bool CBlockCache::Read(ULONGLONG position, BYTE* pBuf, DWORD size)
+{
+	++m_stats.cRequests;
+	m_stats.cbRequested += size;
+
+	if (m_pStream == NULL || position > m_cbFile || size > m_cbFile - position)
+	{
+		return false;
+	}
+	if (size == 0)
+	{
+		return true;
+	}
+	if (m_slots.empty())
+	{
+		return ReadStream(position, pBuf, size);
+	}
+
+	ULONGLONG first = position / m_cbBlock;
+	ULONGLONG last = (position + size - 1) / m_cbBlock;
+	ULONGLONG lastFileBlock = (m_cbFile - 1) / m_cbBlock;
+	bool fSequential = (first == m_lastBlock || first == m_lastBlock + 1);
+	if (!fSequential)
+	{
+		m_cReadAheadWindow = 0;
+	}
+
+	// blocks below this one were fetched by this call and are already counted as misses
+	ULONGLONG missedUntil = first;
+	DWORD cbLeft = size;
+	for (ULONGLONG block = first; block <= last; block++)
+	{
+		auto it = m_blockToSlot.find(block);
+		if (it == m_blockToSlot.end())
+		{
+			// coalesce the missing blocks of this request into one stream read
+			DWORD cBlocks = 1;
+			while (block + cBlocks <= last && cBlocks < m_slots.size() && m_blockToSlot.find(block + cBlocks) == m_blockToSlot.end())
+			{
+				cBlocks++;
+			}
+			m_stats.cMisses += cBlocks;
+			missedUntil = block + cBlocks;
+
+			if (fSequential && block + cBlocks > last && m_cReadAheadBlocks != 0)
+			{
+				m_cReadAheadWindow = (m_cReadAheadWindow == 0) ? 1 : m_cReadAheadWindow * 2;
+				if (m_cReadAheadWindow > m_cReadAheadBlocks)
+				{
+					m_cReadAheadWindow = m_cReadAheadBlocks;
+				}
+				for (DWORD x = 0; x < m_cReadAheadWindow; x++)
+				{
+					ULONGLONG next = block + cBlocks;
+					if (lastFileBlock < next || m_slots.size() <= cBlocks || m_blockToSlot.find(next) != m_blockToSlot.end())
+					{
+						break;
+					}
+					cBlocks++;
+				}
+			}
+
+			if (!Fill(block, cBlocks))
+			{
+				return false;
+			}
+			it = m_blockToSlot.find(block);
+		}
+		else if (missedUntil <= block)
+		{
+			++m_stats.cHits;
+		}
+
+		Slot& slot = m_slots[it->second];
+		slot.lastUse = ++m_useClock;
+
+		DWORD offset = static_cast<DWORD>(position - block * m_cbBlock);
+		DWORD cb = slot.cbValid - offset;
+		if (cbLeft < cb)
+		{
+			cb = cbLeft;
+		}
+		memcpy(pBuf, m_pArena + it->second * m_cbBlock + offset, cb);
+		pBuf += cb;
+		position += cb;
+		cbLeft -= cb;
+	}
+
+	m_lastBlock = last;
+	return true;
+}
+
+void CBlockCache::Prefetch(ULONGLONG position, ULONGLONG size)
+{
+	if (m_slots.empty() || size == 0 || m_cbFile <= position)
+	{
+		return;
+	}
+	if (m_cbFile - position < size)
+	{
+		size = m_cbFile - position;
+	}
+
+	ULONGLONG first = position / m_cbBlock;
+	ULONGLONG last = (position + size - 1) / m_cbBlock;
+	DWORD cBudget = static_cast<DWORD>(m_slots.size() / 2);
+	if (cBudget == 0)
+	{
+		return;
+	}
+	if (last - first + 1 > cBudget)
+	{
+		last = first + cBudget - 1;
+	}
+
+	for (ULONGLONG block = first; block <= last; block++)
+	{
+		if (m_blockToSlot.find(block) != m_blockToSlot.end())
+		{
+			continue;
+		}
+
+		DWORD cBlocks = 1;
+		while (block + cBlocks <= last && m_blockToSlot.find(block + cBlocks) == m_blockToSlot.end())
+		{
+			cBlocks++;
+		}
+		if (!Fill(block, cBlocks))
+		{
+			return;
+		}
+		m_stats.cPrefetched += cBlocks;
+		block += cBlocks - 1;
+	}
+}
+
+bool CBlockCache::Fill(ULONGLONG block, DWORD cBlocks)
+{
+	ULONGLONG position = block * m_cbBlock;
+	ULONGLONG cbRun = static_cast<ULONGLONG>(cBlocks) * m_cbBlock;
+	if (m_cbFile - position < cbRun)
+	{
+		cbRun = m_cbFile - position;
+	}
+
+	BYTE* pRun;
+	if (cBlocks == 1)
+	{
+		// a single block is read in place
+		size_t index = Evict();
+		pRun = m_pArena + index * m_cbBlock;
+		if (!ReadStream(position, pRun, static_cast<DWORD>(cbRun)))
+		{
+			return false;
+		}
+		Slot& slot = m_slots[index];
+		slot.block = block;
+		slot.cbValid = static_cast<DWORD>(cbRun);
+		slot.lastUse = ++m_useClock;
+		slot.fInUse = true;
+		m_blockToSlot[block] = index;
+		return true;
+	}
+
+	m_run.resize(static_cast<size_t>(cbRun));
+	pRun = m_run.data();
+	if (!ReadStream(position, pRun, static_cast<DWORD>(cbRun)))
+	{
+		return false;
+	}
+
+	for (DWORD x = 0; x < cBlocks; x++)
+	{
+		ULONGLONG offset = static_cast<ULONGLONG>(x) * m_cbBlock;
+		DWORD cbValid = static_cast<DWORD>((cbRun - offset < m_cbBlock) ? cbRun - offset : m_cbBlock);
+		size_t index = Evict();
+		memcpy(m_pArena + index * m_cbBlock, pRun + offset, cbValid);
+		Slot& slot = m_slots[index];
+		slot.block = block + x;
+		slot.cbValid = cbValid;
+		slot.lastUse = ++m_useClock;
+		slot.fInUse = true;
+		m_blockToSlot[block + x] = index;
+	}
+	return true;
+}
+
+size_t CBlockCache::Evict()
+{
+	size_t victim = 0;
+	for (size_t x = 0; x < m_slots.size(); x++)
+	{
+		if (!m_slots[x].fInUse)
+		{
+			return x;
+		}
+		if (m_slots[x].lastUse < m_slots[victim].lastUse)
+		{
+			victim = x;
+		}
+	}
+	m_blockToSlot.erase(m_slots[victim].block);
+	m_slots[victim].fInUse = false;
+	return victim;
+}
+
+bool CBlockCache::ReadStream(ULONGLONG position, BYTE* pBuf, DWORD size)
+{
+	HRESULT hr;
+	LARGE_INTEGER li;
+	li.QuadPart = static_cast<LONGLONG>(position);
+
+	++m_stats.cStreamReads;
+	if (SUCCEEDED(hr = m_pStream->Seek(li, STREAM_SEEK_SET, NULL)))
+	{
+		while (true)
+		{
+			if (size == 0)
+			{
+				return true;
+			}
+
+			ULONG cbRead = 0;
+			if (FAILED(hr = m_pStream->Read(pBuf, size, &cbRead)))
+			{
+				break;
+			}
+
+			if (cbRead == 0)
+			{
+				break;
+			}
+
+			m_stats.cbStreamRead += cbRead;
+			pBuf += cbRead;
+			size -= cbRead;
+		}
+	}
+
+	return false;
+}
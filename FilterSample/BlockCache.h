@@ -0,0 +1,128 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <windows.h>
+#include <objidl.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "../PdfTextCore/ByteSource.h"
+
+// Page-aligned read cache placed between PDFium's FPDF_FILEACCESS and the source IStream.
+//
+// PDFium issues many small, overlapping reads while it parses xref tables and object streams.
+// Each of them used to be a Seek + Read on the stream, which is a network round trip on SMB shares.
+// CBlockCache serves them from fixed size blocks, coalesces adjacent misses into one read,
+// and grows a read-ahead window while the access pattern stays sequential.
+class CBlockCache
+{
+public:
+	struct Stats
+	{
+		// Read() calls (one per FPDF_FILEACCESS::m_GetBlock callback)
+		ULONGLONG cRequests;
+		// bytes requested by Read() calls
+		ULONGLONG cbRequested;
+		// blocks served from the cache
+		ULONGLONG cHits;
+		// blocks that had to be fetched from the stream
+		ULONGLONG cMisses;
+		// Seek + Read sequences issued to the stream
+		ULONGLONG cStreamReads;
+		// bytes read from the stream
+		ULONGLONG cbStreamRead;
+		// blocks fetched by Prefetch()
+		ULONGLONG cPrefetched;
+	};
+
+	CBlockCache();
+	~CBlockCache();
+
+	// The cache commits cbBudget bytes, or the file's size rounded up to a block if that is less.
+	// cbBudget == 0 makes every Read() go straight to the stream.
+	HRESULT Init(IStream* pStream, ULONGLONG cbFile, DWORD cbBlock, DWORD cbBudget, DWORD cReadAheadBlocks);
+
+	// Drops the cached blocks and releases the stream.
+	void Reset();
+
+	// Copies [position, position + size) into pBuf.
+	bool Read(ULONGLONG position, BYTE* pBuf, DWORD size);
+
+	// Fetches the missing blocks of [position, position + size) ahead of use, one stream read per gap.
+	// Used for the download hints of linearized documents. At most half of the cache is filled.
+	void Prefetch(ULONGLONG position, ULONGLONG size);
+
+	ULONGLONG GetSize() const
+	{
+		return m_cbFile;
+	}
+
+	const Stats& GetStats() const
+	{
+		return m_stats;
+	}
+
+private:
+	struct Slot
+	{
+		ULONGLONG block;
+		ULONGLONG lastUse;
+		DWORD cbValid;
+		bool fInUse;
+	};
+
+	// Fetches cBlocks blocks starting at block into the cache with a single stream read.
+	bool Fill(ULONGLONG block, DWORD cBlocks);
+	// Returns the index of a free or least recently used slot.
+	size_t Evict();
+	bool ReadStream(ULONGLONG position, BYTE* pBuf, DWORD size);
+
+	IStream* m_pStream;
+	ULONGLONG m_cbFile;
+	DWORD m_cbBlock;
+	DWORD m_cReadAheadBlocks;
+
+	// storage of all slots, m_cbBlock bytes each. Allocated by VirtualAlloc so every block is page aligned.
+	BYTE* m_pArena;
+	std::vector<Slot> m_slots;
+	std::unordered_map<ULONGLONG, size_t> m_blockToSlot;
+	// staging area of a multi-block read
+	std::vector<BYTE> m_run;
+
+	ULONGLONG m_useClock;
+	// last block touched by the previous Read(), used to detect sequential access
+	ULONGLONG m_lastBlock;
+	// current read-ahead window in blocks; doubles on each sequential miss
+	DWORD m_cReadAheadWindow;
+
+	Stats m_stats;
+};
+
+// The cache as the byte source of a document.
+class CBlockCacheSource : public IByteSource
+{
+public:
+	CBlockCacheSource(CBlockCache& cache) : m_cache(cache)
+	{
+	}
+
+	uint64_t GetSize() const override
+	{
+		return m_cache.GetSize();
+	}
+
+	bool Read(uint64_t position, uint8_t* pBuf, uint32_t size) override
+	{
+		return m_cache.Read(position, pBuf, size);
+	}
+
+	void Prefetch(uint64_t position, uint64_t size) override
+	{
+		m_cache.Prefetch(position, size);
+	}
+
+private:
+	CBlockCache& m_cache;
+};
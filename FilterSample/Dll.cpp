@@ -11,7 +11,8 @@
 #include <shlwapi.h>
 
 // BEGIN: include
-#include <fpdfview.h>
+#include "../PdfTextCore/PdfiumLibrary.h"
+#include "../PdfTextCore/Trace.h"
 // END: include
 
 #define SZ_FILTERSAMPLE_CLSID L"{F58F718E-6C5F-40FC-B964-EA330E66B9D6}"
@@ -117,7 +118,7 @@ private:
 };
 
 // Standard DLL functions
-STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void *)
+STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void *pReserved)
 {
     if (dwReason == DLL_PROCESS_ATTACH)
     {
@@ -125,22 +126,17 @@ STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void *)
         DisableThreadLibraryCalls(hInstance);
 
         // BEGIN: DLL_PROCESS_ATTACH
-        {
-            FPDF_LIBRARY_CONFIG config;
-            config.version = 2;
-            config.m_pUserFontPaths = NULL;
-            config.m_pIsolate = NULL;
-            config.m_v8EmbedderSlot = 0;
-
-            FPDF_InitLibraryWithConfig(&config);
-        }
+        // Nothing under the loader lock: PDFium starts with the first filter (CPdfiumLibrary).
         // END: DLL_PROCESS_ATTACH
     }
     else if (dwReason == DLL_PROCESS_DETACH)
     {
 		// BEGIN: DLL_PROCESS_DETACH
+        // PDFium was torn down by DllCanUnloadNow. If the process is exiting instead, it is left to the OS.
+        if (pReserved == NULL)
         {
-            FPDF_DestroyLibrary();
+            // unloaded: the ETW provider must not outlive our code. The trace file is flushed after every document.
+            CTrace::Shutdown();
         }
 		// END: DLL_PROCESS_DETACH
 
@@ -151,7 +147,12 @@ STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void *)
 
 STDAPI DllCanUnloadNow()
 {
-    return (c_cRefModule == 0) ? S_OK : S_FALSE;
+    if (c_cRefModule != 0)
+    {
+        return S_FALSE;
+    }
+    // about to be unloaded: tear PDFium down here, outside the loader lock
+    return CPdfiumLibrary::Shutdown() ? S_OK : S_FALSE;
 }
 
 STDAPI DllGetClassObject(REFCLSID clsid, REFIID riid, void **ppv)
@@ -222,7 +223,7 @@ STDAPI DllRegisterServer()
             // RootKey             KeyName                                                                                  ValueName           Data
             {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_CLSID,                                     NULL,               L"PDFSampleFilter2"},
             {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_CLSID L"\\InProcServer32",                 NULL,               szModuleName},
-            {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_CLSID L"\\InProcServer32",                 L"ThreadingModel",  L"Apartment"},
+            {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_CLSID L"\\InProcServer32",                 L"ThreadingModel",  L"Both"},
             {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_HANDLER,                                   NULL,               L"PDFSampleFilter2 Persistent Handler"},
             {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_HANDLER L"\\PersistentAddinsRegistered",   NULL,               L""},
             {HKEY_LOCAL_MACHINE,   L"Software\\Classes\\CLSID\\" SZ_FILTERSAMPLE_HANDLER L"\\PersistentAddinsRegistered\\{89BCB740-6119-101A-BCB7-00DD010655AF}", NULL, SZ_FILTERSAMPLE_CLSID},
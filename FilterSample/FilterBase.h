@@ -31,6 +31,10 @@
  to you in the form of an IStream interface pointer stored in m_pStream.  (NOTE: In Windows Search only
  IStreams are supported.  For security reasons you don't have access to the file itself.) OnInit
  is the opportunity for you to do any initialization you want to do with the actual stream of data.
+ When initialized through IPersistFile::Load the file is mapped into memory instead: m_mappedFile is
+ open and m_pStream is NULL.  A stream is used when the file cannot be mapped, or is not on a local
+ fixed disk (see CMappedFile).  The mapping is closed again when OnInit fails; while it is open the
+ filter cannot be loaded with another document.
 
  After that, the indexer will call GetNextChunkValue() over and over.  Each time you are called you
  simply call the appropriate SetXXXValue method on ChunkValue with 2 pieces of information.  The first
@@ -88,6 +92,8 @@
 #include <filter.h>
 #include <filterr.h>
 
+#include "MappedFile.h"
+
 // This is a class which simplifies both chunk and property value pair logic
 // To use, you simply create a ChunkValue class of the right kind
 // Example:
@@ -98,7 +104,7 @@
 class CChunkValue
 {
 public:
-    CChunkValue() : m_fIsValid(false), m_pszValue(NULL)
+    CChunkValue() : m_fIsValid(false), m_pszValue(NULL), m_cchValue(0)
     {
         PropVariantInit(&m_propVariant);
         Clear();
@@ -115,8 +121,8 @@ public:
         m_fIsValid = false;
         ZeroMemory(&m_chunk, sizeof(m_chunk));
         PropVariantClear(&m_propVariant);
-        CoTaskMemFree(m_pszValue);
         m_pszValue = NULL;
+        m_cchValue = 0;
     }
 
     // Is this propvalue valid
@@ -161,11 +167,17 @@ public:
     }
 
     // get the string value
-    PWSTR GetString()
+    PCWSTR GetString()
     {
         return m_pszValue;
     };
 
+    // get the length of the string value, in characters
+    size_t GetLength()
+    {
+        return m_cchValue;
+    };
+
     // copy the chunk
     HRESULT CopyChunk(STAT_CHUNK *pStatChunk)
     {
@@ -194,24 +206,40 @@ public:
             return E_INVALIDARG;
         }
 
+        return SetTextValue(pkey, pszValue, wcslen(pszValue), chunkType, locale, cwcLenSource, cwcStartSource, chunkBreakType);
+    };
+
+    // set the property by key to a unicode string of a known length.  A text chunk (not CHUNK_VALUE)
+    // borrows pszValue rather than copying it: GetText reads it until the next GetChunk, so it must
+    // stay valid until then.  A value chunk is copied into the PROPVARIANT.
+    HRESULT SetTextValue(REFPROPERTYKEY pkey, PCWSTR pszValue, size_t cchValue, CHUNKSTATE chunkType = CHUNK_VALUE,
+                         LCID locale = 0, DWORD cwcLenSource = 0, DWORD cwcStartSource = 0,
+                         CHUNK_BREAKTYPE chunkBreakType = CHUNK_NO_BREAK)
+    {
+        if (pszValue == NULL)
+        {
+            return E_INVALIDARG;
+        }
+
         HRESULT hr = SetChunk(pkey, chunkType, locale, cwcLenSource, cwcStartSource, chunkBreakType);
-        if (SUCCEEDED(hr))
+        if (SUCCEEDED(hr) && !(chunkType & CHUNK_VALUE))
         {
-            size_t cch = wcslen(pszValue) + 1;
-            PWSTR pszCoTaskValue = static_cast<PWSTR>(CoTaskMemAlloc(cch * sizeof(WCHAR)));
+            // GetText copies straight from the caller's buffer into the host's
+            m_pszValue = pszValue;
+            m_cchValue = cchValue;
+            m_fIsValid = true;
+        }
+        else if (SUCCEEDED(hr))
+        {
+            // the PROPVARIANT owns its copy, which GetValue copies again for the host
+            PWSTR pszCoTaskValue = static_cast<PWSTR>(CoTaskMemAlloc((cchValue + 1) * sizeof(WCHAR)));
             if (pszCoTaskValue)
             {
-                StringCchCopy(pszCoTaskValue, cch, pszValue);
+                CopyMemory(pszCoTaskValue, pszValue, cchValue * sizeof(WCHAR));
+                pszCoTaskValue[cchValue] = L'\0';
+                m_propVariant.vt = VT_LPWSTR;
+                m_propVariant.pwszVal = pszCoTaskValue;
                 m_fIsValid = true;
-                if (chunkType & CHUNK_VALUE)
-                {
-                    m_propVariant.vt = VT_LPWSTR;
-                    m_propVariant.pwszVal = pszCoTaskValue;
-                }
-                else
-                {
-                    m_pszValue = pszCoTaskValue;
-                }
             }
             else
             {
@@ -323,7 +351,9 @@ private:
     bool m_fIsValid;
     STAT_CHUNK  m_chunk;
     PROPVARIANT m_propVariant;
-    PWSTR m_pszValue;
+    // text chunks: the caller's text, not null terminated
+    PCWSTR m_pszValue;
+    size_t m_cchValue;
 
 };
 
@@ -368,13 +398,56 @@ public:
     // return FILTER_E_END_OF_CHUNKS when there are no more chunks
     virtual HRESULT GetNextChunkValue(CChunkValue &chunkValue) = 0;
 
+    // OnInitAttributes() is called at the end of IFilter::Init, when IsAttributeRequested() can tell
+    // what the host wants.  The document may not be loaded yet if the host calls Init first.
+    virtual HRESULT OnInitAttributes()
+    {
+        return S_OK;
+    }
+
 protected:
     // Service functions for derived classes
     inline DWORD GetChunkId() const { return m_dwChunkId; }
 
+    // Held by every IFilter and initialization method, so the derived class sees one call at a time.
+    // The filter is registered with ThreadingModel=Both: a free-threaded host calls it directly from
+    // any of its threads, without marshaling.  PDFium is serialized process-wide by CPdfiumLock.
+    class CInstanceLock
+    {
+    public:
+        CInstanceLock(CFilterBase *pFilter) : m_pcs(&pFilter->m_csInstance)
+        {
+            EnterCriticalSection(m_pcs);
+        }
+
+        ~CInstanceLock()
+        {
+            LeaveCriticalSection(m_pcs);
+        }
+
+    private:
+        CInstanceLock(const CInstanceLock&);
+        CInstanceLock& operator=(const CInstanceLock&);
+
+        CRITICAL_SECTION *m_pcs;
+    };
+
+    // Whether the host asked for the property in IFilter::Init.  With no attributes in Init the flags
+    // decide, as IFilter::Init documents: any of IFILTER_INIT_APPLY_INDEX_ATTRIBUTES, _OTHER_ATTRIBUTES
+    // or _CRAWL_ATTRIBUTES wants every property, PKEY_Search_Contents (the text) included; without
+    // them only the contents (PID_STG_CONTENTS, which is PKEY_Search_Contents) are wanted.
+    bool IsAttributeRequested(REFPROPERTYKEY key) const;
+
+    // Whether IFilter::Init has been called, so that IsAttributeRequested() tells what the host wants.
+    bool HasAttributes() const
+    {
+        return m_fHasAttributes;
+    }
+
 public:
-    CFilterBase() : m_dwChunkId(0), m_iText(0), m_pStream(NULL)
+    CFilterBase() : m_dwChunkId(0), m_iText(0), m_pStream(NULL), m_fHasAttributes(false), m_fAllAttributes(true), m_pRequestedKeys(NULL), m_cRequestedKeys(0)
     {
+        InitializeCriticalSection(&m_csInstance);
     }
 
     virtual ~CFilterBase()
@@ -383,6 +456,8 @@ public:
         {
             m_pStream->Release();
         }
+        CoTaskMemFree(m_pRequestedKeys);
+        DeleteCriticalSection(&m_csInstance);
     }
 
     // IFilter
@@ -398,6 +473,12 @@ public:
     // IInitializeWithStream
     IFACEMETHODIMP Initialize(IStream *pStm, DWORD)
     {
+        CInstanceLock lock(this);
+        if (m_mappedFile.IsOpen())
+        {
+            return E_UNEXPECTED; // the derived class would read the mapping instead of the stream
+        }
+        m_currentChunk.Clear(); // it may borrow the text of the previous document
         if (m_pStream)
         {
             m_pStream->Release();
@@ -427,12 +508,26 @@ public:
     }
     IFACEMETHODIMP Load(LPCOLESTR pszFileName, DWORD dwMode)
     {
+        CInstanceLock lock(this);
+        if (m_mappedFile.IsOpen())
+        {
+            return E_UNEXPECTED; // the derived class may still read the mapping
+        }
+        m_currentChunk.Clear(); // it may borrow the text of the previous document
         if (m_pStream)
         {
             m_pStream->Release();
             m_pStream = NULL;
         }
         HRESULT hr;
+        if (SUCCEEDED(m_mappedFile.Open(pszFileName)))
+        {
+            if (FAILED(hr = OnInit()))
+            {
+                m_mappedFile.Close(); // or the next Load finds it open
+            }
+            return hr;
+        }
         if (FAILED(hr = SHCreateStreamOnFile(pszFileName, dwMode, &m_pStream)))
             return hr;
         return OnInit();
@@ -449,6 +544,12 @@ public:
     virtual HRESULT STDMETHODCALLTYPE Load(
         /* [unique][in] */ __RPC__in_opt IStream* pStm)
     {
+        CInstanceLock lock(this);
+        if (m_mappedFile.IsOpen())
+        {
+            return E_UNEXPECTED; // the derived class would read the mapping instead of the stream
+        }
+        m_currentChunk.Clear(); // it may borrow the text of the previous document
         if (m_pStream)
         {
             m_pStream->Release();
@@ -473,25 +574,88 @@ public:
 
 protected:
     IStream*                    m_pStream;         // stream of this document
+    CMappedFile                 m_mappedFile;      // mapping of this document, when loaded through IPersistFile
 
 private:
     DWORD                       m_dwChunkId;        // Current chunk id
     DWORD                       m_iText;            // index into ChunkValue
 
     CChunkValue                 m_currentChunk;     // the current chunk value
+    CRITICAL_SECTION            m_csInstance;       // see CInstanceLock
+
+    bool                        m_fHasAttributes;   // Init has been called
+    bool                        m_fAllAttributes;   // Init asked for everything
+    PROPERTYKEY*                m_pRequestedKeys;   // attributes named in Init, by property id
+    ULONG                       m_cRequestedKeys;
 };
 
-HRESULT CFilterBase::Init(ULONG, ULONG, const FULLPROPSPEC *, ULONG *)
+HRESULT CFilterBase::Init(ULONG grfFlags, ULONG cAttributes, const FULLPROPSPEC *aAttributes, ULONG *pFlags)
 {
+    CInstanceLock lock(this);
+
     // Common initialization
     m_dwChunkId = 0;
     m_iText = 0;
     m_currentChunk.Clear();
-    return S_OK;
+
+    if (pFlags)
+    {
+        *pFlags = 0;
+    }
+
+    // Remember which attributes are wanted.  Attributes named by string can't be one of ours.
+    // Named attributes take precedence over the flags.
+    CoTaskMemFree(m_pRequestedKeys);
+    m_pRequestedKeys = NULL;
+    m_cRequestedKeys = 0;
+    bool fNamed = (cAttributes != 0 && aAttributes != NULL);
+    m_fAllAttributes = !fNamed && (grfFlags & (IFILTER_INIT_APPLY_INDEX_ATTRIBUTES | IFILTER_INIT_APPLY_OTHER_ATTRIBUTES | IFILTER_INIT_APPLY_CRAWL_ATTRIBUTES)) != 0;
+    if (!m_fAllAttributes)
+    {
+        m_pRequestedKeys = static_cast<PROPERTYKEY*>(CoTaskMemAlloc((fNamed ? cAttributes : 1) * sizeof(PROPERTYKEY)));
+        if (m_pRequestedKeys == NULL)
+        {
+            return E_OUTOFMEMORY;
+        }
+        for (ULONG i = 0; fNamed && i < cAttributes; i++)
+        {
+            if (aAttributes[i].psProperty.ulKind == PRSPEC_PROPID)
+            {
+                m_pRequestedKeys[m_cRequestedKeys].fmtid = aAttributes[i].guidPropSet;
+                m_pRequestedKeys[m_cRequestedKeys].pid = aAttributes[i].psProperty.propid;
+                m_cRequestedKeys++;
+            }
+        }
+        if (!fNamed)
+        {
+            // the default set: the contents only
+            m_pRequestedKeys[m_cRequestedKeys++] = PKEY_Search_Contents;
+        }
+    }
+    m_fHasAttributes = true;
+
+    return OnInitAttributes();
+}
+
+bool CFilterBase::IsAttributeRequested(REFPROPERTYKEY key) const
+{
+    if (m_fAllAttributes)
+    {
+        return true;
+    }
+    for (ULONG i = 0; i < m_cRequestedKeys; i++)
+    {
+        if (IsEqualPropertyKey(m_pRequestedKeys[i], key))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 HRESULT CFilterBase::GetChunk(STAT_CHUNK *pStat)
 {
+    CInstanceLock lock(this);
     HRESULT hr = S_OK;
 
     // Get the chunk from the derived class.  A return of S_FALSE indicates the chunk should be skipped and we should
@@ -534,6 +698,7 @@ HRESULT CFilterBase::GetChunk(STAT_CHUNK *pStat)
 
 HRESULT CFilterBase::GetText(ULONG *pcwcBuffer, WCHAR *awcBuffer)
 {
+    CInstanceLock lock(this);
     HRESULT hr = S_OK;
 
     if ((pcwcBuffer == NULL) || (*pcwcBuffer == 0))
@@ -551,7 +716,7 @@ HRESULT CFilterBase::GetText(ULONG *pcwcBuffer, WCHAR *awcBuffer)
         return FILTER_E_NO_TEXT;
     }
 
-    ULONG cchTotal = static_cast<ULONG>(wcslen(m_currentChunk.GetString()));
+    ULONG cchTotal = static_cast<ULONG>(m_currentChunk.GetLength());
     ULONG cchLeft = cchTotal - m_iText;
     ULONG cchToCopy = min(*pcwcBuffer - 1, cchLeft);
 
@@ -560,7 +725,7 @@ HRESULT CFilterBase::GetText(ULONG *pcwcBuffer, WCHAR *awcBuffer)
         PCWSTR psz = m_currentChunk.GetString() + m_iText;
 
         // copy the chars
-        StringCchCopyN(awcBuffer, *pcwcBuffer, psz, cchToCopy);
+        CopyMemory(awcBuffer, psz, cchToCopy * sizeof(WCHAR));
 
         // null terminate it
         awcBuffer[cchToCopy] = '\0';
@@ -587,6 +752,7 @@ HRESULT CFilterBase::GetText(ULONG *pcwcBuffer, WCHAR *awcBuffer)
 
 HRESULT CFilterBase::GetValue(PROPVARIANT **ppPropValue)
 {
+    CInstanceLock lock(this);
     HRESULT hr = S_OK;
 
     // if this is not a value chunk they shouldn't be calling this
@@ -11,39 +11,82 @@
 #include <strsafe.h>
 #include <shlwapi.h>
 #include "FilterBase.h"
+#include "FilterSettings.h"
+#include "BlockCache.h"
+#include "PagePrefetcher.h"
 
 // BEGIN: include
 #include <atlbase.h>
 #include <atlstr.h>
 
-#include <cmath>
-
-#include <fpdfview.h>
-#include <fpdf_doc.h>
-#include <fpdf_text.h>
+#include "../PdfTextCore/ChunkCache.h"
+#include "../PdfTextCore/DocumentExtractor.h"
+#include "../PdfTextCore/PdfiumLibrary.h"
+#include "../PdfTextCore/Trace.h"
+#include "../PdfTextCore/Utf.h"
+#include "../PdfTextCore/WorkerPool.h"
 // END: include
 
+static_assert(sizeof(WCHAR) == sizeof(char16_t), "the core's UTF-16 text is handed to COM as is");
+
+extern HINSTANCE g_hInst;
+
 void DllAddRef();
 void DllRelease();
 
+// How long a document waits for a busy worker before it is extracted in process instead.
+// A host may hold more documents open than there are workers.
+const uint32_t WORKER_WAIT_MS = 5000;
+
+// The system properties the PDFPROPERTY go to. The producer, the format version, the tagged flag and
+// the page labels have none and are left out.
+const struct
+{
+	const PROPERTYKEY* pkey;
+	PDFPROPERTY property;
+} PROPERTY_KEYS[] = {
+	{ &PKEY_Title, PDFPROPERTY_TITLE },
+	{ &PKEY_Author, PDFPROPERTY_AUTHOR },
+	{ &PKEY_Subject, PDFPROPERTY_SUBJECT },
+	{ &PKEY_Keywords, PDFPROPERTY_KEYWORDS },
+	{ &PKEY_ApplicationName, PDFPROPERTY_CREATOR },
+	{ &PKEY_Document_DateCreated, PDFPROPERTY_CREATION_DATE },
+	{ &PKEY_Document_DateSaved, PDFPROPERTY_MOD_DATE },
+	{ &PKEY_Document_PageCount, PDFPROPERTY_PAGE_COUNT },
+};
+
 // Filter for ".filtersample" files
 
 class CFilterSample : public CFilterBase
 {
 public:
-	CFilterSample(REFCLSID clsid) : m_cRef(1), m_iEmitState(EMITSTATE_TITLE), m_doc(NULL), m_pageIndex(0), m_numPages(0), m_fileAccess(), m_clsid(clsid)
+	CFilterSample(REFCLSID clsid) : m_cRef(1), m_cacheSource(m_blockCache), m_fReplay(false), m_fRecord(false), m_fRemoteEnded(false), m_clsid(clsid)
 	{
+		const CFilterSettings& settings = CFilterSettings::Get();
+		m_pdf.SetMaxChunkChars(settings.cchMaxChunk);
+		ExtractionBudget budget = { settings.msDocumentBudget, settings.msPageBudget, settings.cchMaxDocument };
+		m_pdf.SetBudget(budget);
+		TEXTLAYOUT layout = (settings.textLayout == 0) ? TEXTLAYOUT_NONE : (settings.textLayout == 2) ? TEXTLAYOUT_STRUCTURE : TEXTLAYOUT_LINES;
+		m_pdf.SetLayout(layout);
+		m_remote.SetMaxChunkChars(settings.cchMaxChunk);
+		m_remote.SetBudget(budget);
+		m_remote.SetLayout(layout);
+
 		DllAddRef();
 	}
 
 	~CFilterSample()
 	{
 		// BEGIN: dtor
-		if (m_doc)
-		{
-			FPDF_CloseDocument(m_doc);
-			m_doc = NULL;
-		}
+		// the worker takes CPdfiumLock: join it before the document goes
+		m_prefetcher.Stop();
+		m_pdf.Close();
+		m_remote.Close();
+
+		const CBlockCache::Stats& stats = m_blockCache.GetStats();
+		ATLTRACE(L"PDFSampleFilter2: GetBlock calls %I64u (%I64u bytes), cache hits %I64u, misses %I64u, stream reads %I64u (%I64u bytes)\n",
+			stats.cRequests, stats.cbRequested, stats.cHits, stats.cMisses, stats.cStreamReads, stats.cbStreamRead);
+		ATLTRACE(L"PDFSampleFilter2: property text grown %u times\n", m_pdf.GetScratchGrowthCount());
 		// END: dtor
 		DllRelease();
 	}
@@ -94,17 +137,20 @@ public:
 	}
 
 	virtual HRESULT OnInit();
+	virtual HRESULT OnInitAttributes();
 	virtual HRESULT GetNextChunkValue(CChunkValue& chunkValue);
 
 private:
 	// BEGIN: IFilter implementation specific funcs
 
-	static int GetBlock(
-		void* param,
-		unsigned long position,
-		unsigned char* pBuf,
-		unsigned long size
-	);
+	// Starts extracting the following pages on a worker thread, if PrefetchPages is set.
+	void StartPrefetcher();
+
+	// The process-wide chunk cache, disabled unless ChunkCacheDirectory is set.
+	static CChunkCache& GetChunkCache();
+
+	// The process-wide PdfWorker processes, disabled unless ExtractionWorkers is set.
+	static CWorkerPool& GetWorkerPool();
 
 	// END: IFilter implementation specific funcs
 
@@ -112,27 +158,157 @@ private:
 
 	// BEGIN: IFilter implementation specific vars
 
-	FPDF_FILEACCESS m_fileAccess;
-	FPDF_DOCUMENT m_doc;
-	int m_numPages;
-	int m_pageIndex;
-	CLSID m_clsid;
+	// Hands the chunks of CDocumentExtractor to a CChunkValue.
+	class CChunkValueSink : public IChunkSink
+	{
+	public:
+		CChunkValueSink(CChunkValue& chunkValue) : m_chunkValue(chunkValue), m_hr(S_FALSE)
+		{
+		}
 
-	// some props we want to emit don't come from the doc.  We use this as our state
-	enum EMITSTATE {
-		EMITSTATE_TITLE,
-		EMITSTATE_AUTHOR,
-		EMITSTATE_SUBJECT,
-		EMITSTATE_KEYWORDS,
-		EMITSTATE_PAGES,
+		// S_FALSE when the step emitted nothing
+		HRESULT GetResult() const
+		{
+			return m_hr;
+		}
+
+		void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override
+		{
+			const PROPERTYKEY* pkey = FindKey(property);
+			if (pkey == NULL)
+			{
+				// left with S_FALSE: GetChunk moves on to the next one
+				return;
+			}
+			m_hr = m_chunkValue.SetTextValue(
+				*pkey,
+				reinterpret_cast<PCWSTR>(value),
+				cch,
+				CHUNK_VALUE,
+				0UL,
+				0UL,
+				0UL,
+				CHUNK_EOS
+			);
+		}
+
+		// the page count and the dates stay typed, so that the index can sort and filter on them
+		void OnPropertyUInt32(PDFPROPERTY property, uint32_t value) override
+		{
+			const PROPERTYKEY* pkey = FindKey(property);
+			if (pkey != NULL)
+			{
+				m_hr = m_chunkValue.SetIntValue(*pkey, (value < INT_MAX) ? static_cast<int>(value) : INT_MAX, CHUNK_VALUE, 0UL, 0UL, 0UL, CHUNK_EOS);
+			}
+		}
+
+		void OnPropertyTime(PDFPROPERTY property, const UtcTime& time) override
+		{
+			const PROPERTYKEY* pkey = FindKey(property);
+			SYSTEMTIME st = { static_cast<WORD>(time.year), static_cast<WORD>(time.month), 0, static_cast<WORD>(time.day),
+				static_cast<WORD>(time.hour), static_cast<WORD>(time.minute), static_cast<WORD>(time.second), 0 };
+			FILETIME ft;
+			if (pkey != NULL && SystemTimeToFileTime(&st, &ft))
+			{
+				m_hr = m_chunkValue.SetFileTimeValue(*pkey, ft, CHUNK_VALUE, 0UL, 0UL, 0UL, CHUNK_EOS);
+			}
+		}
+
+		void OnText(int, const char16_t* text, size_t cch, bool fContinued, const char* language) override
+		{
+			// the first sub-chunk of a page starts a new section, the following ones continue it
+			m_hr = m_chunkValue.SetTextValue(
+				PKEY_Search_Contents,
+				reinterpret_cast<PCWSTR>(text),
+				cch,
+				CHUNK_TEXT,
+				ToLocale(language),
+				0UL,
+				0UL,
+				fContinued ? CHUNK_NO_BREAK : CHUNK_EOS
+			);
+		}
+
+	private:
+		// LCID of the BCP 47 tag language, so that the indexer picks the word breaker of the language.
+		// 0 (the default of the system) for "" and for a tag Windows does not know.
+		static LCID ToLocale(const char* language)
+		{
+			// ChunkSink.h keeps the tags ASCII
+			WCHAR name[MAX_LANGUAGE_CHARS + 1];
+			size_t cch = 0;
+			for (; language[cch] != '\0' && cch < MAX_LANGUAGE_CHARS; cch++)
+			{
+				name[cch] = static_cast<WCHAR>(language[cch]);
+			}
+			name[cch] = L'\0';
+			return (cch == 0) ? 0UL : LocaleNameToLCID(name, LOCALE_ALLOW_NEUTRAL_NAMES);
+		}
+
+		// the PROPERTYKEY of property, NULL for one the filter does not map
+		static const PROPERTYKEY* FindKey(PDFPROPERTY property)
+		{
+			for (const auto& key : PROPERTY_KEYS)
+			{
+				if (key.property == property)
+				{
+					return key.pkey;
+				}
+			}
+			return NULL;
+		}
+
+		CChunkValue& m_chunkValue;
+		HRESULT m_hr;
 	};
-	DWORD m_iEmitState;
+
+	CBlockCache m_blockCache;
+	CBlockCacheSource m_cacheSource;
+	CMemoryByteSource m_memorySource;
+	CDocumentExtractor m_pdf;
+	// m_pdf run in a worker process, with ExtractionWorkers
+	CRemoteExtractor m_remote;
+	CPagePrefetcher m_prefetcher;
+	// chunks replayed from the chunk cache (m_fReplay), or recorded to be stored in it (m_fRecord)
+	CChunkRecording m_recording;
+	ChunkCacheKey m_cacheKey;
+	bool m_fReplay;
+	bool m_fRecord;
+	// m_remote went through the whole document and its worker is back in the pool
+	bool m_fRemoteEnded;
+	CLSID m_clsid;
 
 	// END: IFilter implementation specific vars
 };
 
+// Registers the ETW provider and opens TraceFile, once per load of the DLL. DllMain takes them down.
+static void StartTrace()
+{
+	static bool s_fStarted = []()
+		{
+			CTrace::RegisterProvider();
+			const CFilterSettings& settings = CFilterSettings::Get();
+			if (!settings.traceFile.empty() && !CTrace::OpenFile(settings.traceFile))
+			{
+				ATLTRACE(L"PDFSampleFilter2: can't open the trace file %s\n", settings.traceFile.c_str());
+			}
+			return true;
+		}();
+	(void)s_fStarted;
+}
+
 HRESULT CFilterSample_CreateInstance(REFCLSID clsid, REFIID riid, void** ppv)
 {
+	StartTrace();
+
+	// PDFium starts with the first filter of the process rather than when the DLL is loaded,
+	// so that the shell, property handlers and regsvr32 never pay for it
+	if (CPdfiumLibrary::Initialize())
+	{
+		ATLTRACE(L"PDFSampleFilter2: PDFium initialized in %I64u us (initialization #%u)\n",
+			CPdfiumLibrary::GetInitMicroseconds(), CPdfiumLibrary::GetInitCount());
+	}
+
 	HRESULT hr = E_OUTOFMEMORY;
 	CFilterSample* pFilter = new (std::nothrow) CFilterSample(clsid);
 	if (pFilter)
@@ -148,224 +324,290 @@ HRESULT CFilterSample_CreateInstance(REFCLSID clsid, REFIID riid, void** ppv)
 HRESULT CFilterSample::OnInit()
 {
 	// BEGIN: OnInit
+	if (m_pdf.IsOpen() || m_remote.IsOpen() || m_fReplay || m_fRemoteEnded)
+	{
+		return E_UNEXPECTED; // already initialized
+	}
+
+	CTraceSpan span(TRACEEVENT_FILTER_INIT, 0);
 	HRESULT hr;
+	IByteSource* pSource = NULL;
 	STATSTG statStg = { 0 };
-	if (m_doc == NULL)
+	if (m_mappedFile.IsOpen())
+	{
+		hr = S_OK;
+	}
+	else if (SUCCEEDED(hr = m_pStream->Stat(&statStg, span.IsOn() ? STATFLAG_DEFAULT : STATFLAG_NONAME)))
 	{
-		if (SUCCEEDED(hr = m_pStream->Stat(&statStg, STATFLAG_NONAME)))
+		if (statStg.pwcsName != NULL)
 		{
-			if (statStg.cbSize.QuadPart < 0xFFFFFFFFU)
-			{
-				m_fileAccess.m_FileLen = (ULONG)statStg.cbSize.QuadPart;
-				m_fileAccess.m_GetBlock = GetBlock;
-				m_fileAccess.m_Param = this;
-				m_doc = FPDF_LoadCustomDocument(&m_fileAccess, NULL);
-				if (m_doc != NULL)
-				{
-					m_numPages = FPDF_GetPageCount(m_doc);
+			// names the document in the trace
+			std::string name;
+			AppendUtf8(name, reinterpret_cast<const char16_t*>(statStg.pwcsName), wcslen(statStg.pwcsName));
+			span.SetName(name);
+			m_pdf.SetTraceName(name);
+			CoTaskMemFree(statStg.pwcsName);
+		}
 
-					return S_OK;
-				}
-				else
-				{
-					hr = E_FAIL;
-				}
-			}
-			else
+		if (statStg.cbSize.QuadPart < 0xFFFFFFFFU)
+		{
+			const CFilterSettings& settings = CFilterSettings::Get();
+			if (SUCCEEDED(hr = m_blockCache.Init(m_pStream, statStg.cbSize.QuadPart, settings.cbCacheBlock, settings.cbCacheBudget, settings.cCacheReadAheadBlocks)))
 			{
-				hr = E_FAIL; // file too big
+				pSource = &m_cacheSource;
 			}
 		}
 		else
 		{
-			hr = E_FAIL; // can't get size
+			// FPDF_FILEACCESS::m_FileLen is 32-bit and PDFium has no 64-bit custom loader: only a
+			// mapped file (IPersistFile) of this size can be loaded
+			hr = HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
 		}
 	}
 	else
 	{
-		hr = E_UNEXPECTED; // already initialized
+		hr = E_FAIL; // can't get size
 	}
-	return hr;
-	// END: OnInit
-}
 
-// When GetNextChunkValue() is called we fill in the ChunkValue by calling SetXXXValue() with the property and value (and other parameters that you want)
-// example:  chunkValue.SetTextValue(PKEY_ItemName, L"example text");
-// return FILTER_E_END_OF_CHUNKS when there are no more chunks
-HRESULT CFilterSample::GetNextChunkValue(CChunkValue& chunkValue)
-{
-	// BEGIN: GetNextChunkValue
-	chunkValue.Clear();
+	if (SUCCEEDED(hr) && pSource == NULL)
+	{
+		// zero-copy: PDFium parses the mapped view directly
+		m_memorySource = CMemoryByteSource(m_mappedFile.GetData(), m_mappedFile.GetSize());
+		pSource = &m_memorySource;
+	}
+	if (SUCCEEDED(hr))
+	{
+		span.Set(TRACEVALUE_BYTES, pSource->GetSize());
+	}
 
-	if (m_doc == NULL)
+	CChunkCache& cache = GetChunkCache();
+	if (SUCCEEDED(hr) && cache.IsEnabled() && CChunkCache::ComputeKey(*pSource, m_cacheKey))
 	{
-		return E_FAIL;
+		if (cache.Load(m_cacheKey, m_pdf.GetMaxChunkChars(), m_pdf.GetLayout(), m_recording))
+		{
+			// seen before: the chunks are replayed without PDFium
+			m_fReplay = true;
+			span.Set(TRACEVALUE_FLAGS, TRACEINIT_CACHE_HIT);
+			return S_OK;
+		}
+		// the emit filter is that of the last Init, which may have come first
+		m_recording.Reset(cache.GetMaxEntrySize());
+		m_fRecord = m_recording.IsComplete();
 	}
 
-	class Util1 {
-	public:
-		static HRESULT TryToReadMetaText(
-			FPDF_DOCUMENT doc,
-			FPDF_BYTESTRING tag,
-			const PROPERTYKEY& key,
-			CChunkValue& chunkValue
-		)
+	// a worker reads through FPDF_FILEACCESS, which is 32-bit: larger files are parsed in place here
+	CWorkerPool& pool = GetWorkerPool();
+	if (SUCCEEDED(hr) && pool.IsEnabled() && pSource->GetSize() < 0xFFFFFFFFU && m_remote.Attach(pool, WORKER_WAIT_MS))
+	{
+		if (!m_remote.Open(pSource))
 		{
-			WCHAR content[1024] = { 0 };
-			ULONG cb = FPDF_GetMetaText(doc, tag, content, sizeof(WCHAR) * 1024);
-			if (cb != 0 && lstrlenW(content) != 0)
+			if (m_remote.IsWorkerLost())
 			{
-				return chunkValue.SetTextValue(
-					key,
-					content,
-					CHUNK_VALUE,
-					0UL,
-					0UL,
-					0UL,
-					CHUNK_EOS
-				);
-			}
-			else
-			{
-				return S_FALSE;
+				ATLTRACE(L"PDFSampleFilter2: extraction worker lost while opening the document\n");
 			}
+			m_remote.Close();
+			hr = E_FAIL;
 		}
-	};
-
-	struct DblRect {
-		// left
-		double l;
-		// top (PDF coord, up is plus)
-		double t;
-		// right
-		double r;
-		// bottom (PDF coord, up is plus)
-		double b;
-
-		bool SeemsToContinue(const DblRect& prev) const
+	}
+	else if (SUCCEEDED(hr))
+	{
+		if (!m_pdf.Open(pSource))
 		{
-			double h = t - b;
-			double sharedHeight = std::fmin(t, prev.t) - std::fmax(b, prev.b);
-			return true
-				&& (prev.r <= l && l < prev.r + h / 2)
-				&& h * 0.5 <= sharedHeight
-				;
+			hr = E_FAIL;
 		}
-	};
+		else if (HasAttributes() && IsAttributeRequested(PKEY_Search_Contents))
+		{
+			// Init came first and OnInitAttributes had no document to prefetch from
+			StartPrefetcher();
+		}
+		// otherwise the prefetcher starts in OnInitAttributes, once we know the text is wanted
+	}
+	span.Set(TRACEVALUE_FLAGS, (m_remote.IsAttached() ? TRACEINIT_WORKER : 0) | (FAILED(hr) ? TRACEINIT_FAILED : 0));
+	return hr;
+	// END: OnInit
+}
 
-	// Not all data from the XML document has been read but additional props can be added
-	// For this we use the m_iEmitState to iterate through them, each call will go to the next one
-	switch (m_iEmitState)
+// IFilter::Init tells what the host wants. Without PKEY_Search_Contents (property-only crawls)
+// no page is ever loaded or laid out, so such a pass costs little more than reading the trailer.
+HRESULT CFilterSample::OnInitAttributes()
+{
+	uint32_t propertyMask = 0;
+	bool fAllProperties = true;
+	for (const auto& key : PROPERTY_KEYS)
 	{
-	case EMITSTATE_TITLE:
-		++m_iEmitState;
-		return Util1::TryToReadMetaText(m_doc, "Title", PKEY_Title, chunkValue);
-
-	case EMITSTATE_AUTHOR:
-		++m_iEmitState;
-		return Util1::TryToReadMetaText(m_doc, "Author", PKEY_Author, chunkValue);
-
-	case EMITSTATE_SUBJECT:
-		++m_iEmitState;
-		return Util1::TryToReadMetaText(m_doc, "Subject", PKEY_Subject, chunkValue);
-
-	case EMITSTATE_KEYWORDS:
-		++m_iEmitState;
-		return Util1::TryToReadMetaText(m_doc, "Keywords", PKEY_Keywords, chunkValue);
-
-	case EMITSTATE_PAGES:
-		if (m_numPages <= m_pageIndex)
+		if (IsAttributeRequested(*key.pkey))
 		{
-			++m_iEmitState;
-			return S_FALSE;
+			propertyMask |= PropertyBit(key.property);
 		}
-
-		CStringW text;
-
-		FPDF_PAGE page = FPDF_LoadPage(m_doc, m_pageIndex);
-		if (page != NULL)
+		else
 		{
-			WCHAR boundedText[2048];
-
-			FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
-			if (textPage != NULL)
-			{
-				int numRects = FPDFText_CountRects(textPage, 0, -1);
-				DblRect prevRect;
-				for (int x = 0; x < numRects; x++)
-				{
-					DblRect rect;
-					if (FPDFText_GetRect(textPage, x, &rect.l, &rect.t, &rect.r, &rect.b))
-					{
-						int numText = FPDFText_GetBoundedText(textPage, rect.l, rect.t, rect.r, rect.b, (PUSHORT)boundedText, 2048);
-						if (1 <= numText)
-						{
-							text.Append(boundedText, numText);
-
-							bool continuous = x != 0 && rect.SeemsToContinue(prevRect);
-
-							text.Append(continuous ? L"" : L"");
-						}
-						prevRect = rect;
-					}
-				}
-				FPDFText_ClosePage(textPage);
-			}
-			FPDF_ClosePage(page);
+			fAllProperties = false;
 		}
+	}
+	if (fAllProperties)
+	{
+		// the unmapped ones too, which the sink skips: the recording is then the complete sequence
+		propertyMask = PDFPROPERTY_ALL;
+	}
+	bool fText = IsAttributeRequested(PKEY_Search_Contents);
+	m_pdf.SetEmitFilter(propertyMask, fText);
+	m_remote.SetEmitFilter(propertyMask, fText);
+	m_recording.SetEmitFilter(propertyMask, fText);
+	if (!m_recording.IsComplete())
+	{
+		// only complete chunk sequences are cached
+		m_fRecord = false;
+	}
 
-		m_pageIndex += 1;
-
-		return chunkValue.SetTextValue(
-			PKEY_Search_Contents,
-			text,
-			CHUNK_TEXT,
-			0UL,
-			0UL,
-			0UL,
-			CHUNK_EOS
-		);
+	if (!fText)
+	{
+		// the worker takes CPdfiumLock: join it without holding it
+		m_prefetcher.Stop();
+		m_pdf.SetPageProvider(NULL);
+	}
+	else if (m_pdf.IsOpen() && !m_prefetcher.IsStarted())
+	{
+		StartPrefetcher();
 	}
+	return S_OK;
+}
 
-	// if we get to here we are done with this document
-	return FILTER_E_END_OF_CHUNKS;
+void CFilterSample::StartPrefetcher()
+{
+	const CFilterSettings& settings = CFilterSettings::Get();
+	if (settings.cPrefetchPages == 0 || m_pdf.GetPageCount() < 2)
+	{
+		return;
+	}
 
-	// END: GetNextChunkValue
+	CPagePrefetcher::Source source = {};
+	if (m_mappedFile.IsOpen())
+	{
+		source.pData = m_mappedFile.GetData();
+		source.cbData = m_mappedFile.GetSize();
+	}
+	else if (m_blockCache.GetSize() <= settings.cbCacheBudget)
+	{
+		// the prefetcher copies the stream for its worker: as much memory as the block cache at most
+		source.pStream = m_pStream;
+		source.cbData = m_blockCache.GetSize();
+	}
+	else
+	{
+		return;
+	}
+
+	// on failure the pages are extracted inline
+	if (SUCCEEDED(m_prefetcher.Start(source, m_pdf.GetPageCount(), m_pdf.GetFirstPage(), settings.cPrefetchPages, settings.msPageBudget, m_pdf.GetLayout())))
+	{
+		m_pdf.SetPageProvider(&m_prefetcher);
+	}
 }
 
-int CFilterSample::GetBlock(
-	void* param,
-	unsigned long position,
-	unsigned char* pBuf,
-	unsigned long size
-)
+CChunkCache& CFilterSample::GetChunkCache()
 {
-	HRESULT hr;
-	LPSTREAM pStm = reinterpret_cast<CFilterSample*>(param)->m_pStream;
-	if (SUCCEEDED(hr = pStm->Seek(LARGE_INTEGER{ position }, STREAM_SEEK_SET, NULL)))
-	{
-		while (true)
+	static CChunkCache s_cache = []()
 		{
-			if (size == 0)
-			{
-				return 1; // success
-			}
+			const CFilterSettings& settings = CFilterSettings::Get();
+			CChunkCache cache;
+			cache.Open(settings.chunkCacheDirectory, static_cast<uint64_t>(settings.cMBChunkCacheBudget) * 1024 * 1024, settings.cbChunkCacheMaxEntry);
+			return cache;
+		}();
+	return s_cache;
+}
 
-			ULONG cbRead = 0;
-			if (FAILED(hr = pStm->Read(pBuf, size, &cbRead)))
+CWorkerPool& CFilterSample::GetWorkerPool()
+{
+	static CWorkerPool s_pool;
+	static bool s_fOpened = []()
+		{
+			const CFilterSettings& settings = CFilterSettings::Get();
+			if (settings.cExtractionWorkers == 0)
 			{
-				break;
+				return false;
 			}
 
-			if (cbRead == 0)
+			// PdfWorker.exe is installed next to the DLL
+			WCHAR szPath[MAX_PATH];
+			DWORD cch = GetModuleFileNameW(g_hInst, szPath, ARRAYSIZE(szPath));
+			if (cch == 0 || cch == ARRAYSIZE(szPath) || !PathRemoveFileSpecW(szPath) || !PathAppendW(szPath, L"PdfWorker.exe"))
 			{
-				break;
+				return false;
 			}
+			s_pool.Open(szPath, settings.cExtractionWorkers, settings.cDocumentsPerWorker, static_cast<uint64_t>(settings.cMBWorkerMemory) * 1024 * 1024);
+			return true;
+		}();
+	(void)s_fOpened;
+	return s_pool;
+}
+
+// When GetNextChunkValue() is called we fill in the ChunkValue by calling SetXXXValue() with the property and value (and other parameters that you want)
+// example:  chunkValue.SetTextValue(PKEY_ItemName, L"example text");
+// return FILTER_E_END_OF_CHUNKS when there are no more chunks
+HRESULT CFilterSample::GetNextChunkValue(CChunkValue& chunkValue)
+{
+	// BEGIN: GetNextChunkValue
+	chunkValue.Clear();
+
+	CChunkValueSink sink(chunkValue);
+	if (m_fReplay)
+	{
+		return m_recording.Step(sink) ? sink.GetResult() : FILTER_E_END_OF_CHUNKS;
+	}
+
+	bool fRemote = m_remote.IsOpen();
+	if (!m_pdf.IsOpen() && !fRemote)
+	{
+		return m_fRemoteEnded ? FILTER_E_END_OF_CHUNKS : E_FAIL;
+	}
+
+	// CDocumentExtractor walks the properties, then the pages; each call goes to the next chunk
+	CTeeChunkSink tee(sink, m_recording);
+	IChunkSink& target = m_fRecord ? static_cast<IChunkSink&>(tee) : sink;
+	if (fRemote ? !m_remote.Step(target) : !m_pdf.Step(target))
+	{
+		if (fRemote && m_remote.IsWorkerLost())
+		{
+			// the worker crashed or hung on this document and has been replaced; the host lives on
+			ATLTRACE(L"PDFSampleFilter2: extraction worker lost, the rest of the document is left out\n");
+			m_remote.Close();
+			m_fRecord = false;
+			return E_FAIL;
+		}
 
-			pBuf += cbRead;
-			size -= cbRead;
+		uint32_t truncation = fRemote ? m_remote.GetTruncation() : m_pdf.GetTruncation();
+		if (truncation != TRUNCATION_NONE)
+		{
+			// what was emitted stands, the rest of the document is left out
+			ATLTRACE(L"PDFSampleFilter2: document truncated by its budget (%s%s%s)\n",
+				(truncation & TRUNCATION_DOCUMENT_TIME) ? L" DocumentTimeBudgetMs" : L"",
+				(truncation & TRUNCATION_PAGE_TIME) ? L" PageTimeBudgetMs" : L"",
+				(truncation & TRUNCATION_CHARS) ? L" MaxDocumentChars" : L"");
+			// the cut depends on the timing and the settings, neither of which is in the cache key
+			m_fRecord = false;
+		}
+		uint32_t cPagesWithUnicodeErrors = fRemote ? m_remote.GetPagesWithUnicodeErrors() : m_pdf.GetPagesWithUnicodeErrors();
+		if (cPagesWithUnicodeErrors != 0)
+		{
+			// the text of these pages is partly garbage: a font without a usable ToUnicode map
+			ATLTRACE(L"PDFSampleFilter2: %u pages with Unicode map errors\n", cPagesWithUnicodeErrors);
 		}
+		if (m_fRecord)
+		{
+			m_fRecord = false;
+			GetChunkCache().Store(m_cacheKey, m_pdf.GetMaxChunkChars(), m_pdf.GetLayout(), m_recording);
+			m_recording.Reset(0);
+		}
+		if (fRemote)
+		{
+			// the worker goes back to the pool now, not when the host releases the filter
+			m_remote.Close();
+			m_fRemoteEnded = true;
+		}
+		// if we get to here we are done with this document
+		return FILTER_E_END_OF_CHUNKS;
 	}
+	return sink.GetResult();
 
-	return 0; // fail
+	// END: GetNextChunkValue
 }
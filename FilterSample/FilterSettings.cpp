@@ -0,0 +1,100 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "FilterSettings.h"
+
+#define SZ_FILTERSETTINGS_KEY L"Software\\HIRAOKA HYPERS TOOLS, Inc.\\PDFSampleFilter2"
+
+CFilterSettings::CFilterSettings()
+	: cbCacheBlock(64 * 1024)
+	, cbCacheBudget(8 * 1024 * 1024)
+	, cCacheReadAheadBlocks(16)
+	, cchMaxChunk(64 * 1024)
+	, cPrefetchPages(0)
+	, msDocumentBudget(0)
+	, msPageBudget(0)
+	, cchMaxDocument(0)
+	, textLayout(1)
+	, cMBChunkCacheBudget(1024)
+	, cbChunkCacheMaxEntry(16 * 1024 * 1024)
+	, cExtractionWorkers(0)
+	, cDocumentsPerWorker(1000)
+	, cMBWorkerMemory(512)
+{
+}
+
+const CFilterSettings& CFilterSettings::Get()
+{
+	static const CFilterSettings s_settings = []()
+		{
+			CFilterSettings settings;
+			settings.LoadFromRegistry();
+			return settings;
+		}();
+	return s_settings;
+}
+
+void CFilterSettings::LoadFromRegistry()
+{
+	HKEY hKey;
+	if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, SZ_FILTERSETTINGS_KEY, 0, KEY_QUERY_VALUE, &hKey) != ERROR_SUCCESS)
+	{
+		return;
+	}
+
+	class Util1 {
+	public:
+		static void TryToReadDword(HKEY hKey, PCWSTR pszName, DWORD& value)
+		{
+			DWORD data = 0;
+			DWORD cb = sizeof(data);
+			DWORD type = 0;
+			if (RegQueryValueExW(hKey, pszName, NULL, &type, reinterpret_cast<LPBYTE>(&data), &cb) == ERROR_SUCCESS && type == REG_DWORD)
+			{
+				value = data;
+			}
+		}
+
+		static void TryToReadString(HKEY hKey, PCWSTR pszName, std::wstring& value)
+		{
+			WCHAR data[MAX_PATH] = { 0 };
+			DWORD cb = sizeof(data) - sizeof(WCHAR);
+			DWORD type = 0;
+			if (RegQueryValueExW(hKey, pszName, NULL, &type, reinterpret_cast<LPBYTE>(data), &cb) == ERROR_SUCCESS && (type == REG_SZ || type == REG_EXPAND_SZ))
+			{
+				if (type == REG_EXPAND_SZ)
+				{
+					WCHAR expanded[MAX_PATH];
+					DWORD cch = ExpandEnvironmentStringsW(data, expanded, ARRAYSIZE(expanded));
+					if (cch == 0 || ARRAYSIZE(expanded) < cch)
+					{
+						return;
+					}
+					value = expanded;
+				}
+				else
+				{
+					value = data;
+				}
+			}
+		}
+	};
+
+	Util1::TryToReadDword(hKey, L"BlockCacheBlockSize", cbCacheBlock);
+	Util1::TryToReadDword(hKey, L"BlockCacheBudget", cbCacheBudget);
+	Util1::TryToReadDword(hKey, L"BlockCacheReadAhead", cCacheReadAheadBlocks);
+	Util1::TryToReadDword(hKey, L"MaxChunkChars", cchMaxChunk);
+	Util1::TryToReadDword(hKey, L"PrefetchPages", cPrefetchPages);
+	Util1::TryToReadDword(hKey, L"DocumentTimeBudgetMs", msDocumentBudget);
+	Util1::TryToReadDword(hKey, L"PageTimeBudgetMs", msPageBudget);
+	Util1::TryToReadDword(hKey, L"MaxDocumentChars", cchMaxDocument);
+	Util1::TryToReadDword(hKey, L"TextLayout", textLayout);
+	Util1::TryToReadString(hKey, L"ChunkCacheDirectory", chunkCacheDirectory);
+	Util1::TryToReadDword(hKey, L"ChunkCacheBudgetMB", cMBChunkCacheBudget);
+	Util1::TryToReadDword(hKey, L"ChunkCacheMaxEntry", cbChunkCacheMaxEntry);
+	Util1::TryToReadDword(hKey, L"ExtractionWorkers", cExtractionWorkers);
+	Util1::TryToReadDword(hKey, L"WorkerDocuments", cDocumentsPerWorker);
+	Util1::TryToReadDword(hKey, L"WorkerMemoryMB", cMBWorkerMemory);
+	Util1::TryToReadString(hKey, L"TraceFile", traceFile);
+
+	RegCloseKey(hKey);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+
+// Tunables of the filter.
+//
+// They are read once per process from:
+//   HKEY_LOCAL_MACHINE\Software\HIRAOKA HYPERS TOOLS, Inc.\PDFSampleFilter2
+// A missing value keeps its default.
+struct CFilterSettings
+{
+	// BlockCacheBlockSize (DWORD): size of one cache block in bytes. Rounded up to a multiple of the system page size.
+	DWORD cbCacheBlock;
+	// BlockCacheBudget (DWORD): bytes of cache memory per filter instance. 0 disables the cache.
+	DWORD cbCacheBudget;
+	// BlockCacheReadAhead (DWORD): maximum number of blocks read ahead on sequential access.
+	DWORD cCacheReadAheadBlocks;
+	// MaxChunkChars (DWORD): page text is emitted in chunks of about this many characters. 0 emits one chunk per page.
+	DWORD cchMaxChunk;
+	// PrefetchPages (DWORD): pages extracted ahead of the host on a worker thread. 0 extracts each page when it is
+	// requested. A document read from a stream is prefetched only if it is no larger than BlockCacheBudget.
+	DWORD cPrefetchPages;
+	// DocumentTimeBudgetMs (DWORD): wall-clock milliseconds spent on one document, after which its remaining text is
+	// left out. 0 is no limit.
+	DWORD msDocumentBudget;
+	// PageTimeBudgetMs (DWORD): wall-clock milliseconds spent on one page, after which the rest of the page is left out.
+	// The time the host spends on the chunks of a page split in several is not counted. 0 is no limit.
+	DWORD msPageBudget;
+	// MaxDocumentChars (DWORD): characters of page text emitted per document. 0 is no limit.
+	DWORD cchMaxDocument;
+	// TextLayout (DWORD): 1 (the default) joins the runs of a page with spaces and line breaks from their positions,
+	// 0 glues them as the filter did before, 2 reads a tagged PDF in the order of its structure tree and gives the
+	// chunks the locale of its Lang (TEXTLAYOUT).
+	DWORD textLayout;
+	// ChunkCacheDirectory (REG_SZ): folder of the persistent chunk cache. Empty (the default) disables the cache.
+	// It must be writable by the filter host process, which runs with restricted rights.
+	std::wstring chunkCacheDirectory;
+	// ChunkCacheBudgetMB (DWORD): size of the chunk cache in MB. The least recently used documents go first.
+	DWORD cMBChunkCacheBudget;
+	// ChunkCacheMaxEntry (DWORD): bytes of chunk data above which a document is not cached.
+	DWORD cbChunkCacheMaxEntry;
+	// ExtractionWorkers (DWORD): PdfWorker processes that extract the documents, several at a time and out of the
+	// host process. 0 (the default) extracts in process.
+	DWORD cExtractionWorkers;
+	// WorkerDocuments (DWORD): documents after which a worker is replaced. 0 is no limit.
+	DWORD cDocumentsPerWorker;
+	// WorkerMemoryMB (DWORD): working set in MB above which a worker is replaced after its document. 0 is no limit.
+	DWORD cMBWorkerMemory;
+	// TraceFile (REG_SZ): file the spans of the extraction are appended to (CTrace), for PdfTraceDump. Empty (the
+	// default) traces only to ETW sessions. It must be writable by the filter host process.
+	std::wstring traceFile;
+
+	CFilterSettings();
+
+	// Returns the process-wide settings.
+	static const CFilterSettings& Get();
+
+private:
+	void LoadFromRegistry();
+};
@@ -0,0 +1,86 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "MappedFile.h"
+
+CMappedFile::CMappedFile() : m_hFile(INVALID_HANDLE_VALUE), m_pView(NULL), m_cbView(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+HRESULT CMappedFile::Open(PCWSTR pszFileName)
+{
+	Close();
+
+	// a read from a view whose medium went away raises EXCEPTION_IN_PAGE_ERROR in PDFium, which
+	// takes the host down: the files of shares and removable media are read as streams instead
+	WCHAR szVolume[MAX_PATH];
+	if (!GetVolumePathNameW(pszFileName, szVolume, ARRAYSIZE(szVolume)) || GetDriveTypeW(szVolume) != DRIVE_FIXED)
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	m_hFile = CreateFileW(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+	return Map();
+}
+
+HRESULT CMappedFile::Map()
+{
+	HRESULT hr;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+	}
+	else if (size.QuadPart == 0 || static_cast<ULONGLONG>(size.QuadPart) > static_cast<SIZE_T>(-1))
+	{
+		hr = E_FAIL; // empty, or larger than the address space
+	}
+	else
+	{
+		HANDLE hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping == NULL)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+		}
+		else
+		{
+			// the view keeps the section alive
+			m_pView = static_cast<const BYTE*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+			hr = (m_pView != NULL) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+			CloseHandle(hMapping);
+		}
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		m_cbView = static_cast<ULONGLONG>(size.QuadPart);
+	}
+	else
+	{
+		Close();
+	}
+	return hr;
+}
+
+void CMappedFile::Close()
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = NULL;
+	}
+	m_cbView = 0;
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+}
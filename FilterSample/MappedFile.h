@@ -0,0 +1,49 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <windows.h>
+
+// Read-only view of a whole file.
+//
+// Used by IPersistFile::Load so that PDFium can parse the document straight from the mapping
+// (FPDF_LoadMemDocument64) instead of copying every byte through IStream reads.
+// The file is opened with FILE_SHARE_READ only: nobody can modify it while it is mapped,
+// and a file already opened for writing elsewhere fails to map, so the caller falls back to a stream.
+// Only files on local fixed disks are mapped: a network share that drops or a medium that is pulled
+// would fault in the middle of PDFium, where a stream read just fails.
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	HRESULT Open(PCWSTR pszFileName);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_pView != NULL;
+	}
+
+	const BYTE* GetData() const
+	{
+		return m_pView;
+	}
+
+	ULONGLONG GetSize() const
+	{
+		return m_cbView;
+	}
+
+private:
+	CMappedFile(const CMappedFile&);
+	CMappedFile& operator=(const CMappedFile&);
+
+	// maps the whole of m_hFile
+	HRESULT Map();
+
+	HANDLE m_hFile;
+	const BYTE* m_pView;
+	ULONGLONG m_cbView;
+};
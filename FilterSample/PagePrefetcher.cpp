@@ -0,0 +1,268 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "PagePrefetcher.h"
+
+CPagePrefetcher::CPagePrefetcher()
+	: m_source(), m_pMarshaledStream(NULL), m_pCopy(NULL), m_numPages(0), m_firstPage(0), m_cPagesAhead(0), m_msPageBudget(0), m_layout(TEXTLAYOUT_LINES), m_hThread(NULL)
+	, m_hPageReady(NULL), m_fStop(false), m_nextOrdinal(0), m_nextToTake(0), m_fRunning(false)
+{
+	InitializeCriticalSection(&m_cs);
+	InitializeConditionVariable(&m_cvSpace);
+}
+
+CPagePrefetcher::~CPagePrefetcher()
+{
+	Stop();
+	DeleteCriticalSection(&m_cs);
+}
+
+HRESULT CPagePrefetcher::Start(const Source& source, int numPages, int firstPage, DWORD cPagesAhead, DWORD msPageBudget, TEXTLAYOUT layout)
+{
+	if (IsStarted() || cPagesAhead == 0)
+	{
+		return E_UNEXPECTED;
+	}
+
+	m_source = source;
+	m_numPages = numPages;
+	m_firstPage = firstPage;
+	m_cPagesAhead = cPagesAhead;
+	m_msPageBudget = msPageBudget;
+	m_layout = layout;
+	m_fStop = false;
+	m_nextOrdinal = 0;
+	m_nextToTake = 0;
+	m_slots.resize(cPagesAhead);
+	for (PageSlot& slot : m_slots)
+	{
+		slot.ordinal = -1;
+		slot.fReady = false;
+	}
+
+	HRESULT hr = S_OK;
+	if (m_source.pData == NULL)
+	{
+		// the worker copies the stream: a clone, so that its seek pointer is not the filter's
+		IStream* pClone = NULL;
+		if (m_source.cbData == 0 || static_cast<SIZE_T>(-1) < m_source.cbData)
+		{
+			hr = E_FAIL;
+		}
+		else if (SUCCEEDED(hr = m_source.pStream->Clone(&pClone)))
+		{
+			hr = CoMarshalInterThreadInterfaceInStream(IID_IStream, pClone, &m_pMarshaledStream);
+			pClone->Release();
+		}
+		m_source.pStream = NULL;
+	}
+
+	if (SUCCEEDED(hr) && (m_hPageReady = CreateEventW(NULL, FALSE, FALSE, NULL)) == NULL)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		EnterCriticalSection(&m_cs);
+		m_fRunning = true;
+		LeaveCriticalSection(&m_cs);
+
+		if ((m_hThread = CreateThread(NULL, 0, WorkerProc, this, 0, NULL)) == NULL)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+
+			EnterCriticalSection(&m_cs);
+			m_fRunning = false;
+			LeaveCriticalSection(&m_cs);
+		}
+	}
+
+	if (FAILED(hr))
+	{
+		Stop();
+	}
+	return hr;
+}
+
+void CPagePrefetcher::Stop()
+{
+	EnterCriticalSection(&m_cs);
+	m_fStop = true;
+	WakeAllConditionVariable(&m_cvSpace);
+	LeaveCriticalSection(&m_cs);
+
+	if (m_hThread)
+	{
+		// pumping: the worker may be reading the stream from this apartment
+		DWORD index;
+		if (FAILED(CoWaitForMultipleHandles(0, INFINITE, 1, &m_hThread, &index)))
+		{
+			WaitForSingleObject(m_hThread, INFINITE); // no COM on this thread
+		}
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+
+	if (m_pMarshaledStream)
+	{
+		// the worker never unmarshaled it
+		CoReleaseMarshalData(m_pMarshaledStream);
+		m_pMarshaledStream->Release();
+		m_pMarshaledStream = NULL;
+	}
+	if (m_pCopy)
+	{
+		VirtualFree(m_pCopy, 0, MEM_RELEASE);
+		m_pCopy = NULL;
+	}
+	if (m_hPageReady)
+	{
+		CloseHandle(m_hPageReady);
+		m_hPageReady = NULL;
+	}
+	for (PageSlot& slot : m_slots)
+	{
+		slot.fReady = false;
+	}
+}
+
+bool CPagePrefetcher::TakePage(int ordinal, PageText& page, bool& fTruncated)
+{
+	while (true)
+	{
+		EnterCriticalSection(&m_cs);
+		PageSlot* pSlot = m_slots.empty() ? NULL : &m_slots[ordinal % m_slots.size()];
+		if (pSlot != NULL && pSlot->fReady && pSlot->ordinal == ordinal)
+		{
+			// the slot keeps the buffer of the previous page for the worker of the next
+			page.Swap(pSlot->page);
+			fTruncated = pSlot->fTruncated;
+			pSlot->fReady = false;
+			m_nextToTake = ordinal + 1;
+			WakeAllConditionVariable(&m_cvSpace);
+			LeaveCriticalSection(&m_cs);
+			return true;
+		}
+		bool fWorking = m_fRunning && ordinal < m_numPages;
+		LeaveCriticalSection(&m_cs);
+
+		// not started, stopped, or no such page
+		DWORD index;
+		if (!fWorking || FAILED(CoWaitForMultipleHandles(0, INFINITE, 1, &m_hPageReady, &index)))
+		{
+			return false;
+		}
+	}
+}
+
+DWORD WINAPI CPagePrefetcher::WorkerProc(LPVOID param)
+{
+	CPagePrefetcher* pThis = static_cast<CPagePrefetcher*>(param);
+	pThis->Work();
+	return 0;
+}
+
+bool CPagePrefetcher::CopyStream()
+{
+	bool fRead = false;
+	if (SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED)))
+	{
+		IStream* pStream = NULL;
+		HRESULT hr = CoGetInterfaceAndReleaseStream(m_pMarshaledStream, IID_PPV_ARGS(&pStream));
+		m_pMarshaledStream = NULL;
+		if (SUCCEEDED(hr))
+		{
+			m_pCopy = static_cast<BYTE*>(VirtualAlloc(NULL, static_cast<SIZE_T>(m_source.cbData), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			const ULONG cbMaxRead = 1024 * 1024;
+			LARGE_INTEGER zero = { 0 };
+			fRead = m_pCopy != NULL && SUCCEEDED(pStream->Seek(zero, STREAM_SEEK_SET, NULL));
+			for (ULONGLONG cbDone = 0; fRead && cbDone < m_source.cbData; )
+			{
+				ULONG cbRead = 0;
+				ULONG cb = (m_source.cbData - cbDone < cbMaxRead) ? static_cast<ULONG>(m_source.cbData - cbDone) : cbMaxRead;
+				fRead = !IsStopping() && SUCCEEDED(pStream->Read(m_pCopy + cbDone, cb, &cbRead)) && cbRead != 0;
+				cbDone += cbRead;
+			}
+			pStream->Release();
+		}
+		CoUninitialize();
+	}
+	m_source.pData = m_pCopy;
+	return fRead;
+}
+
+bool CPagePrefetcher::IsStopping()
+{
+	EnterCriticalSection(&m_cs);
+	bool fStop = m_fStop;
+	LeaveCriticalSection(&m_cs);
+	return fStop;
+}
+
+void CPagePrefetcher::Work()
+{
+	if (m_pMarshaledStream != NULL && !CopyStream())
+	{
+		EnterCriticalSection(&m_cs);
+		m_fRunning = false;
+		LeaveCriticalSection(&m_cs);
+		SetEvent(m_hPageReady);
+		return;
+	}
+
+	CMemoryByteSource source(m_source.pData, m_source.cbData);
+	CDocumentExtractor doc;
+	ExtractionBudget budget = { 0, m_msPageBudget, 0 };
+	doc.SetBudget(budget);
+	doc.SetLayout(m_layout);
+	bool fOpen = doc.Open(&source);
+
+	while (true)
+	{
+		int ordinal;
+		EnterCriticalSection(&m_cs);
+		while (!m_fStop && m_nextOrdinal < m_numPages && m_nextToTake + static_cast<int>(m_cPagesAhead) <= m_nextOrdinal)
+		{
+			SleepConditionVariableCS(&m_cvSpace, &m_cs, INFINITE);
+		}
+		bool fDone = m_fStop || m_numPages <= m_nextOrdinal;
+		ordinal = m_nextOrdinal++;
+		// the page text goes into the buffer the slot holds
+		PageText page;
+		if (!fDone)
+		{
+			page.Swap(m_slots[ordinal % m_slots.size()].page);
+		}
+		LeaveCriticalSection(&m_cs);
+		if (fDone)
+		{
+			break;
+		}
+
+		// a page the worker can't load comes out empty, as in CDocumentExtractor::Step
+		bool fTruncated = false;
+		if (fOpen)
+		{
+			doc.ExtractPage(CDocumentExtractor::PageIndexOf(ordinal, m_firstPage), page, fTruncated);
+		}
+		else
+		{
+			page.Clear();
+		}
+
+		EnterCriticalSection(&m_cs);
+		PageSlot& slot = m_slots[ordinal % m_slots.size()];
+		slot.page.Swap(page);
+		slot.ordinal = ordinal;
+		slot.fReady = true;
+		slot.fTruncated = fTruncated;
+		LeaveCriticalSection(&m_cs);
+		SetEvent(m_hPageReady);
+	}
+	doc.Close();
+
+	EnterCriticalSection(&m_cs);
+	m_fRunning = false;
+	LeaveCriticalSection(&m_cs);
+	SetEvent(m_hPageReady);
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <windows.h>
+#include <objidl.h>
+
+#include <string>
+#include <vector>
+
+#include "../PdfTextCore/DocumentExtractor.h"
+
+// Extracts the text of the next pages ahead of the host on a worker thread.
+//
+// The worker opens its own CDocumentExtractor on the same bytes and extracts the pages in order.
+// At most cPagesAhead pages beyond the one the host is reading are extracted or kept, so memory
+// stays bounded however fast the worker is. Pages are handed out strictly in order.
+//
+// PDFium is not thread-safe, so the worker holds CPdfiumLock while it parses: extraction overlaps
+// with the host indexing the previous chunks, but PDFium itself never runs on two threads at once.
+// That is also why there is a single worker: more would each parse the document again, one after
+// another. A stream document is copied into memory by the worker, through a clone of the filter's
+// stream marshaled to it, before it takes the lock: a read marshaled to the host apartment while
+// holding the lock would never return if the host thread waited for the lock in another filter.
+// The host thread pumps while it waits for the worker (TakePage, Stop), so that those reads go through.
+class CPagePrefetcher : public IPageProvider
+{
+public:
+	// Where the worker loads the document from: a mapped view (pData), or the filter's stream of
+	// cbData bytes, which the worker copies.
+	struct Source
+	{
+		const BYTE* pData;
+		ULONGLONG cbData;
+		IStream* pStream;
+	};
+
+	CPagePrefetcher();
+	~CPagePrefetcher();
+
+	// Called under the filter's instance lock, on the thread the stream belongs to. Fails if the
+	// stream can't be cloned.
+	// firstPage is emitted first, the other pages follow in order (see CDocumentExtractor::PageIndexOf).
+	// msPageBudget is ExtractionBudget::msPage of the worker's document, layout its TEXTLAYOUT.
+	HRESULT Start(const Source& source, int numPages, int firstPage, DWORD cPagesAhead, DWORD msPageBudget, TEXTLAYOUT layout);
+
+	// Stops and joins the worker. Must not be called while holding CPdfiumLock.
+	void Stop();
+
+	bool IsStarted() const
+	{
+		return m_hThread != NULL;
+	}
+
+	// IPageProvider: waits for the page at ordinal.
+	bool TakePage(int ordinal, PageText& page, bool& fTruncated) override;
+
+private:
+	CPagePrefetcher(const CPagePrefetcher&);
+	CPagePrefetcher& operator=(const CPagePrefetcher&);
+
+	static DWORD WINAPI WorkerProc(LPVOID param);
+	// Opens a document on the source and extracts the pages until there are no more. A document that
+	// fails to open yields empty pages; a stream that can't be copied yields none, and the host
+	// extracts the pages itself.
+	void Work();
+	// Reads the whole marshaled stream into m_pCopy, unless Stop() is called first.
+	bool CopyStream();
+	bool IsStopping();
+
+	Source m_source;
+	// the clone of the filter's stream, marshaled to the worker until it unmarshals it
+	IStream* m_pMarshaledStream;
+	// the copy of the stream, VirtualAlloc'ed
+	BYTE* m_pCopy;
+	int m_numPages;
+	int m_firstPage;
+	DWORD m_cPagesAhead;
+	DWORD m_msPageBudget;
+	TEXTLAYOUT m_layout;
+
+	HANDLE m_hThread;
+
+	// guards everything below
+	CRITICAL_SECTION m_cs;
+	// signaled when the host took a page or Stop() was called
+	CONDITION_VARIABLE m_cvSpace;
+	// auto-reset, set when the worker finished a page
+	HANDLE m_hPageReady;
+	bool m_fStop;
+	// next ordinal the worker extracts
+	int m_nextOrdinal;
+	// ordinal the host waits for next
+	int m_nextToTake;
+	bool m_fRunning;
+	// The pages extracted ahead, in the slot at ordinal % m_cPagesAhead: the worker takes an ordinal
+	// only once the host has taken the page before it in the slot. The text buffers are swapped
+	// between the slots, the worker and the host rather than freed, so that they are reused from
+	// page to page and from one document to the next.
+	struct PageSlot
+	{
+		int ordinal;
+		bool fReady;
+		bool fTruncated;
+		PageText page;
+	};
+	std::vector<PageSlot> m_slots;
+};
@@ -0,0 +1,367 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+// PdfCorpusGen: writes the synthetic PDFs PdfBench runs over, so the benchmark needs no external data.
+//
+//   PdfCorpusGen outDir [--scale N]
+//
+// many-pages.pdf    many ordinary pages of Latin text
+// huge-page.pdf     a single page holding hundreds of thousands of characters
+// tiny-objects.pdf  pages made of one text object per glyph
+// cjk.pdf           Japanese text in a non-embedded Adobe-Japan1 font, like Samples/サンプル.pdf
+// scanned.pdf       image-only pages, a few with an invisible OCR text layer or text in a form XObject
+//
+// The files are written directly in PDF syntax: no PDFium, no fonts needed. The output is
+// deterministic for a given scale.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Deterministic pseudo random numbers: the corpus must be the same on every machine.
+class CRandom
+{
+public:
+	explicit CRandom(uint32_t seed) : m_state(seed)
+	{
+	}
+
+	uint32_t Next(uint32_t bound)
+	{
+		m_state = m_state * 1664525u + 1013904223u;
+		return (m_state >> 8) % bound;
+	}
+
+private:
+	uint32_t m_state;
+};
+
+// Collects numbered objects and writes them with their xref table.
+class CPdfWriter
+{
+public:
+	// Reserves an object number, so that objects can refer to each other before they are written.
+	int Reserve()
+	{
+		m_objects.push_back(std::string());
+		return static_cast<int>(m_objects.size());
+	}
+
+	void Set(int id, const std::string& body)
+	{
+		m_objects[id - 1] = body;
+	}
+
+	int Add(const std::string& body)
+	{
+		int id = Reserve();
+		Set(id, body);
+		return id;
+	}
+
+	int AddStream(const std::string& data)
+	{
+		return Add("<< /Length " + std::to_string(data.size()) + " >>\nstream\n" + data + "\nendstream");
+	}
+
+	bool Save(const fs::path& path, int catalog, int info) const
+	{
+		std::string pdf = "%PDF-1.7\n%\xE2\xE3\xCF\xD3\n";
+		std::vector<size_t> offsets;
+		for (size_t x = 0; x < m_objects.size(); x++)
+		{
+			offsets.push_back(pdf.size());
+			pdf += std::to_string(x + 1) + " 0 obj\n" + m_objects[x] + "\nendobj\n";
+		}
+
+		size_t xref = pdf.size();
+		pdf += "xref\n0 " + std::to_string(m_objects.size() + 1) + "\n0000000000 65535 f \n";
+		for (size_t offset : offsets)
+		{
+			char entry[32];
+			snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+			pdf += entry;
+		}
+		pdf += "trailer\n<< /Size " + std::to_string(m_objects.size() + 1)
+			+ " /Root " + std::to_string(catalog) + " 0 R /Info " + std::to_string(info) + " 0 R >>\n"
+			+ "startxref\n" + std::to_string(xref) + "\n%%EOF\n";
+
+		FILE* fp = fopen(path.string().c_str(), "wb");
+		if (fp == NULL)
+		{
+			return false;
+		}
+		bool fWritten = fwrite(pdf.data(), 1, pdf.size(), fp) == pdf.size();
+		return fclose(fp) == 0 && fWritten;
+	}
+
+private:
+	std::vector<std::string> m_objects;
+};
+
+// One document under construction: fonts, pages and metadata.
+class CDocument
+{
+public:
+	CDocument(const std::string& title)
+	{
+		m_catalog = m_writer.Reserve();
+		m_pages = m_writer.Reserve();
+		m_latinFont = m_writer.Add("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+		int descriptor = m_writer.Add("<< /Type /FontDescriptor /FontName /KozMinPr6N-Regular /Flags 4 /FontBBox [0 -120 1000 880]"
+			" /ItalicAngle 0 /Ascent 880 /Descent -120 /CapHeight 740 /StemV 80 >>");
+		int cidFont = m_writer.Add("<< /Type /Font /Subtype /CIDFontType0 /BaseFont /KozMinPr6N-Regular"
+			" /CIDSystemInfo << /Registry (Adobe) /Ordering (Japan1) /Supplement 6 >> /FontDescriptor "
+			+ std::to_string(descriptor) + " 0 R /DW 1000 >>");
+		m_cjkFont = m_writer.Add("<< /Type /Font /Subtype /Type0 /BaseFont /KozMinPr6N-Regular /Encoding /UniJIS-UCS2-H"
+			" /DescendantFonts [" + std::to_string(cidFont) + " 0 R] >>");
+		m_info = m_writer.Add("<< /Title (" + title + ") /Author (PdfCorpusGen) /Subject (Synthetic benchmark corpus)"
+			" /Keywords (benchmark;synthetic) /Creator (PdfCorpusGen) /CreationDate (D:20250101000000Z) >>");
+	}
+
+	// xobjects are the entries of the /XObject resources, e.g. "/Fm1 12 0 R"
+	void AddPage(double width, double height, const std::string& content, const std::string& xobjects = std::string())
+	{
+		int contents = m_writer.AddStream(content);
+		m_kids.push_back(m_writer.Add("<< /Type /Page /Parent " + std::to_string(m_pages) + " 0 R /MediaBox [0 0 "
+			+ std::to_string(static_cast<int>(width)) + " " + std::to_string(static_cast<int>(height)) + "]"
+			" /Resources << " + FontResources() + (xobjects.empty() ? "" : " /XObject << " + xobjects + " >>") + " >>"
+			" /Contents " + std::to_string(contents) + " 0 R >>"));
+	}
+
+	// A letter size form XObject drawing content with the same fonts as the pages.
+	int AddForm(const std::string& content)
+	{
+		return m_writer.Add("<< /Type /XObject /Subtype /Form /BBox [0 0 612 792] /Resources << " + FontResources() + " >>"
+			" /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "\nendstream");
+	}
+
+	bool Save(const fs::path& path)
+	{
+		std::string kids;
+		for (int kid : m_kids)
+		{
+			kids += std::to_string(kid) + " 0 R ";
+		}
+		m_writer.Set(m_catalog, "<< /Type /Catalog /Pages " + std::to_string(m_pages) + " 0 R >>");
+		m_writer.Set(m_pages, "<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(m_kids.size()) + " >>");
+		return m_writer.Save(path, m_catalog, m_info);
+	}
+
+private:
+	std::string FontResources() const
+	{
+		return "/Font << /F1 " + std::to_string(m_latinFont) + " 0 R /F2 " + std::to_string(m_cjkFont) + " 0 R >>";
+	}
+
+	CPdfWriter m_writer;
+	int m_catalog;
+	int m_pages;
+	int m_info;
+	int m_latinFont;
+	int m_cjkFont;
+	std::vector<int> m_kids;
+};
+
+// A line of Latin words, at most cchMax characters.
+std::string MakeLine(CRandom& random, size_t cchMax)
+{
+	static const char* const syllables[] = {
+		"ka", "ri", "to", "pen", "dor", "al", "mi", "sek", "ver", "on", "tha", "lus", "qui", "bra", "ne", "es",
+	};
+
+	std::string line;
+	while (true)
+	{
+		std::string word;
+		uint32_t cSyllables = 1 + random.Next(4);
+		for (uint32_t x = 0; x < cSyllables; x++)
+		{
+			word += syllables[random.Next(sizeof(syllables) / sizeof(syllables[0]))];
+		}
+		if (cchMax < line.size() + 1 + word.size())
+		{
+			return line;
+		}
+		if (!line.empty())
+		{
+			line += ' ';
+		}
+		line += word;
+	}
+}
+
+// A line of Japanese text as a hex string of UTF-16BE code units, for the UniJIS-UCS2-H font.
+std::string MakeCjkLine(CRandom& random, size_t cch)
+{
+	static const char16_t text[] =
+		u"全文検索のためにページのテキストを抽出します。日本語の文章は単語の間に空白を置かないため、"
+		u"抽出した文字列をそのまま索引へ渡します。漢字と平仮名と片仮名が混在する行を生成しています。";
+
+	std::string line = "<";
+	for (size_t x = 0; x < cch; x++)
+	{
+		char hex[8];
+		snprintf(hex, sizeof(hex), "%04X", static_cast<unsigned>(text[random.Next(sizeof(text) / sizeof(text[0]) - 1)]));
+		line += hex;
+	}
+	line += ">";
+	return line;
+}
+
+// Ordinary pages: one text object per line.
+bool WriteManyPages(const fs::path& path, int cPages)
+{
+	CRandom random(1);
+	CDocument doc("Many pages");
+	for (int page = 0; page < cPages; page++)
+	{
+		std::string content = "BT /F1 10 Tf 12 TL 50 780 Td\n";
+		for (int line = 0; line < 60; line++)
+		{
+			content += "(" + MakeLine(random, 90) + ") Tj T*\n";
+		}
+		content += "ET";
+		doc.AddPage(612, 792, content);
+	}
+	return doc.Save(path);
+}
+
+// One page at the maximum size PDF allows, filled with small text.
+bool WriteHugePage(const fs::path& path, int cLines)
+{
+	CRandom random(2);
+	CDocument doc("Huge page");
+	const double size = 14400;
+	const double leading = size / (cLines + 2);
+	std::string content = "BT /F1 " + std::to_string(leading * 0.8) + " Tf " + std::to_string(leading) + " TL 20 "
+		+ std::to_string(size - leading) + " Td\n";
+	for (int line = 0; line < cLines; line++)
+	{
+		content += "(" + MakeLine(random, 400) + ") Tj T*\n";
+	}
+	content += "ET";
+	doc.AddPage(size, size, content);
+	return doc.Save(path);
+}
+
+// Every glyph is its own text object, the worst case for the walk over text objects.
+bool WriteTinyObjects(const fs::path& path, int cPages, int cObjectsPerPage)
+{
+	CRandom random(3);
+	CDocument doc("Tiny objects");
+	const int columns = 100;
+	for (int page = 0; page < cPages; page++)
+	{
+		std::string content;
+		for (int x = 0; x < cObjectsPerPage; x++)
+		{
+			double left = 20 + (x % columns) * 5.7;
+			double top = 780 - (x / columns) * 7.5;
+			char glyph = static_cast<char>('a' + random.Next(26));
+			content += "BT /F1 6 Tf " + std::to_string(left) + " " + std::to_string(top) + " Td (" + glyph + ") Tj ET\n";
+		}
+		doc.AddPage(612, 792, content);
+	}
+	return doc.Save(path);
+}
+
+bool WriteCjk(const fs::path& path, int cPages)
+{
+	CRandom random(4);
+	CDocument doc("CJK");
+	for (int page = 0; page < cPages; page++)
+	{
+		std::string content = "BT /F2 12 Tf 15 TL 50 780 Td\n";
+		for (int line = 0; line < 48; line++)
+		{
+			content += MakeCjkLine(random, 40) + " Tj T*\n";
+		}
+		content += "ET";
+		doc.AddPage(612, 792, content);
+	}
+	return doc.Save(path);
+}
+
+// Scanned pages: a full page grayscale image each and no text object, the bulk of a scanned archive.
+// Every 10th page also has an invisible OCR text layer, every 25th draws its text through a form.
+bool WriteScanned(const fs::path& path, int cPages)
+{
+	CRandom random(5);
+	CDocument doc("Scanned");
+	const int width = 170, height = 220;
+	for (int page = 0; page < cPages; page++)
+	{
+		std::string content = "q 612 0 0 792 0 0 cm BI /W " + std::to_string(width) + " /H " + std::to_string(height) + " /CS /G /BPC 8 ID\n";
+		for (int x = 0; x < width * height; x++)
+		{
+			content += static_cast<char>(160 + random.Next(96));
+		}
+		content += "\nEI Q\n";
+
+		std::string xobjects;
+		if (page % 10 == 0)
+		{
+			content += "BT 3 Tr /F1 10 Tf 12 TL 50 780 Td\n";
+			for (int line = 0; line < 50; line++)
+			{
+				content += "(" + MakeLine(random, 90) + ") Tj T*\n";
+			}
+			content += "ET\n";
+		}
+		else if (page % 25 == 5)
+		{
+			int form = doc.AddForm("BT /F1 10 Tf 50 400 Td (" + MakeLine(random, 90) + ") Tj ET");
+			content += "/Fm1 Do\n";
+			xobjects = "/Fm1 " + std::to_string(form) + " 0 R";
+		}
+		doc.AddPage(612, 792, content, xobjects);
+	}
+	return doc.Save(path);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "PdfCorpusGen outDir [--scale N]" << std::endl;
+		return 1;
+	}
+
+	fs::path outDir = argv[1];
+	int scale = 1;
+	for (int argi = 2; argi + 1 < argc; argi += 2)
+	{
+		if (strcmp(argv[argi], "--scale") == 0)
+		{
+			scale = atoi(argv[argi + 1]);
+		}
+	}
+	if (scale < 1)
+	{
+		scale = 1;
+	}
+
+	std::error_code ec;
+	fs::create_directories(outDir, ec);
+
+	bool fOk = true
+		&& WriteManyPages(outDir / "many-pages.pdf", 500 * scale)
+		&& WriteHugePage(outDir / "huge-page.pdf", 1500 * scale)
+		&& WriteTinyObjects(outDir / "tiny-objects.pdf", 5 * scale, 8000)
+		&& WriteCjk(outDir / "cjk.pdf", 50 * scale)
+		&& WriteScanned(outDir / "scanned.pdf", 200 * scale)
+		;
+	if (!fOk)
+	{
+		std::cerr << "can't write to " << outDir.string() << std::endl;
+		return 1;
+	}
+	return 0;
+}
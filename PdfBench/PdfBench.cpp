@@ -0,0 +1,669 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+// PdfBench: runs the filter's extraction path over a corpus and reports throughput, latency and memory.
+//
+//   PdfBench [--repeat N] [--max-chunk N] [--properties-only] [--cache dir]
+//            [--doc-budget-ms N] [--page-budget-ms N] [--max-chars N] [--layout none|lines|structure]
+//            [--workers N] [--worker-path PdfWorker] [--worker-documents N] [--json out.json] corpusDir
+//
+// Each document goes through what CFilterSample does for the indexer: CDocumentExtractor::Open
+// (OnInit), Step until the end (GetNextChunkValue), and the chunk text copied out in GetText sized
+// pieces. The bytes are read through CFileByteSource, one read per GetBlock.
+// --properties-only measures a metadata-only crawl, IFilter::Init without PKEY_Search_Contents.
+// --cache goes through a CChunkCache in dir as the filter does with ChunkCacheDirectory: with
+// --repeat 2 the second round shows the replay.
+// The budget options set the ExtractionBudget, as DocumentTimeBudgetMs, PageTimeBudgetMs and
+// MaxDocumentChars do for the filter. --layout sets the TEXTLAYOUT, as TextLayout does; the words
+// (whitespace separated) and the longest of them show what the word breaker gets from each, and
+// the text chunks with a language what it is told of the language (TEXTLAYOUT_STRUCTURE).
+// --workers extracts through a CWorkerPool of N PdfWorker processes (next to PdfBench unless
+// --worker-path is given), N documents at a time, as the filter does with ExtractionWorkers.
+// --worker-documents recycles a worker after that many documents.
+// Each thread reuses one CDocumentExtractor for its documents, as a host reuses a filter instance.
+// The operator new calls of each document are counted: those of the extraction path, and those of
+// PDFium where it shares the C++ runtime of the process (a shared library on Linux, not the DLL on
+// Windows). The worker processes are not counted.
+// The summary goes to stdout; --json writes the per-document and aggregate figures for tracking
+// regressions across releases. PdfCorpusGen writes a synthetic corpus to run it on.
+// With PDFTEXT_TRACE=file the spans of each document and page are appended to file (PdfTraceDump).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "../PdfTextCore/ChunkCache.h"
+#include "../PdfTextCore/DocumentExtractor.h"
+#include "../PdfTextCore/FileByteSource.h"
+#include "../PdfTextCore/PdfiumLibrary.h"
+#include "../PdfTextCore/Trace.h"
+#include "../PdfTextCore/WorkerPool.h"
+
+namespace fs = std::filesystem;
+typedef std::chrono::steady_clock Clock;
+
+// operator new calls of the thread, for the allocations of each document. The array and nothrow
+// forms come here too.
+thread_local uint64_t t_cAllocations = 0;
+
+void* operator new(size_t cb)
+{
+	t_cAllocations++;
+	void* p = malloc((cb != 0) ? cb : 1);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// the buffer SearchFilterHost passes to IFilter::GetText, in characters
+const size_t CCH_GETTEXT_BUFFER = 4096;
+
+struct BenchOptions
+{
+	uint32_t cchMaxChunk;
+	bool fPages;
+	ExtractionBudget budget;
+	TEXTLAYOUT layout;
+	CChunkCache cache;
+	// enabled by --workers
+	CWorkerPool workerPool;
+};
+
+struct DocResult
+{
+	std::string path;
+	bool fOpened;
+	// replayed from the chunk cache
+	bool fCacheHit;
+	// TRUNCATION flags
+	uint32_t truncation;
+	// the worker crashed or hung
+	bool fWorkerLost;
+	uint64_t cbFile;
+	int cPages;
+	// pages without a text object, whose text page was not built
+	uint32_t cPagesWithoutText;
+	// pages with characters of no usable Unicode mapping
+	uint32_t cPagesWithUnicodeErrors;
+	uint64_t cChunks;
+	// text chunks in a language
+	uint64_t cLanguageChunks;
+	uint64_t cchText;
+	uint64_t cWords;
+	uint64_t cchLongestWord;
+	uint64_t cGetBlock;
+	uint64_t cbGetBlock;
+	// heap allocations from Open to Close
+	uint64_t cAllocations;
+	double openMs;
+	// from the start of Open to the first page text chunk; negative when there is none
+	double firstTextMs;
+	double totalMs;
+};
+
+// Takes the chunks the way the host does: every chunk is pulled through GetText sized copies.
+class CBenchSink : public IChunkSink
+{
+public:
+	CBenchSink() : m_cChunks(0), m_cLanguageChunks(0), m_cchText(0), m_cWords(0), m_cchLongestWord(0), m_cPages(0), m_fHaveText(false), m_cchWord(0)
+	{
+	}
+
+	void OnProperty(PDFPROPERTY, const char16_t* value, size_t cch) override
+	{
+		Consume(value, cch);
+	}
+
+	void OnText(int, const char16_t* text, size_t cch, bool fContinued, const char* language) override
+	{
+		m_cPages += fContinued ? 0 : 1;
+		m_cLanguageChunks += (*language != '\0') ? 1 : 0;
+		if (!m_fHaveText)
+		{
+			m_fHaveText = true;
+			m_firstText = Clock::now();
+		}
+		Consume(text, cch);
+		m_cchText += cch;
+		CountWords(text, cch, fContinued);
+	}
+
+	uint64_t m_cChunks;
+	uint64_t m_cLanguageChunks;
+	uint64_t m_cchText;
+	uint64_t m_cWords;
+	uint64_t m_cchLongestWord;
+	int m_cPages;
+	bool m_fHaveText;
+	Clock::time_point m_firstText;
+
+private:
+	void Consume(const char16_t* text, size_t cch)
+	{
+		m_cChunks++;
+		for (size_t ich = 0; ich < cch; ich += CCH_GETTEXT_BUFFER)
+		{
+			size_t cchCopy = std::min(cch - ich, CCH_GETTEXT_BUFFER);
+			memcpy(m_buffer, text + ich, cchCopy * sizeof(char16_t));
+		}
+	}
+
+	// a word goes on into a continued chunk, not into the next page
+	void CountWords(const char16_t* text, size_t cch, bool fContinued)
+	{
+		if (!fContinued)
+		{
+			m_cchWord = 0;
+		}
+		for (size_t ich = 0; ich < cch; ich++)
+		{
+			char16_t ch = text[ich];
+			if (ch == u' ' || ch == u'\n' || ch == u'\r' || ch == u'\t' || ch == 0x3000)
+			{
+				m_cchLongestWord = std::max(m_cchLongestWord, m_cchWord);
+				m_cchWord = 0;
+			}
+			else if (m_cchWord++ == 0)
+			{
+				m_cWords++;
+			}
+		}
+		m_cchLongestWord = std::max(m_cchLongestWord, m_cchWord);
+	}
+
+	char16_t m_buffer[CCH_GETTEXT_BUFFER];
+	uint64_t m_cchWord;
+};
+
+double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// CDocumentExtractor or CRemoteExtractor, to the end
+template <class TExtractor>
+void StepToEnd(TExtractor& pdf, IChunkSink& sink)
+{
+	while (pdf.Step(sink))
+	{
+	}
+}
+
+// pdf is the thread's extractor, reused from one document to the next
+DocResult RunDocument(const fs::path& path, BenchOptions& options, CDocumentExtractor& pdf)
+{
+	DocResult result = DocResult();
+	result.path = path.u8string();
+	result.firstTextMs = -1;
+
+	CBenchSink sink;
+	Clock::time_point start = Clock::now();
+	uint64_t cAllocationsBefore = t_cAllocations;
+	{
+		CFileByteSource source;
+		pdf.SetMaxChunkChars(options.cchMaxChunk);
+		pdf.SetEmitFilter(PDFPROPERTY_ALL, options.fPages);
+		pdf.SetBudget(options.budget);
+		pdf.SetLayout(options.layout);
+		pdf.SetTraceName(result.path);
+		CRemoteExtractor remote;
+		remote.SetMaxChunkChars(options.cchMaxChunk);
+		remote.SetEmitFilter(PDFPROPERTY_ALL, options.fPages);
+		remote.SetBudget(options.budget);
+		remote.SetLayout(options.layout);
+		bool fRemote = options.workerPool.IsEnabled();
+
+		CChunkRecording recording;
+		ChunkCacheKey key;
+		bool fRecord = false;
+		bool fSource = source.Open(path.c_str());
+		if (fSource && options.cache.IsEnabled() && CChunkCache::ComputeKey(source, key))
+		{
+			result.fCacheHit = options.cache.Load(key, options.cchMaxChunk, options.layout, recording);
+			recording.SetEmitFilter(PDFPROPERTY_ALL, options.fPages);
+			if (!result.fCacheHit)
+			{
+				recording.Reset(options.cache.GetMaxEntrySize());
+				fRecord = recording.IsComplete();
+			}
+		}
+
+		if (result.fCacheHit)
+		{
+			result.fOpened = true;
+			result.openMs = Milliseconds(start, Clock::now());
+			while (recording.Step(sink))
+			{
+			}
+			result.cPages = sink.m_cPages;
+		}
+		else
+		{
+			if (fRemote)
+			{
+				result.fOpened = fSource && remote.Attach(options.workerPool, 60 * 1000) && remote.Open(&source);
+			}
+			else
+			{
+				result.fOpened = fSource && pdf.Open(&source);
+			}
+			result.openMs = Milliseconds(start, Clock::now());
+			if (result.fOpened)
+			{
+				result.cPages = fRemote ? remote.GetPageCount() : pdf.GetPageCount();
+				CTeeChunkSink tee(sink, recording);
+				IChunkSink& target = fRecord ? static_cast<IChunkSink&>(tee) : sink;
+				if (fRemote)
+				{
+					StepToEnd(remote, target);
+				}
+				else
+				{
+					StepToEnd(pdf, target);
+				}
+				result.truncation = fRemote ? remote.GetTruncation() : pdf.GetTruncation();
+				result.cPagesWithoutText = fRemote ? remote.GetPagesWithoutText() : pdf.GetPagesWithoutText();
+				result.cPagesWithUnicodeErrors = fRemote ? remote.GetPagesWithUnicodeErrors() : pdf.GetPagesWithUnicodeErrors();
+				if (fRecord && result.truncation == TRUNCATION_NONE && !remote.IsWorkerLost())
+				{
+					options.cache.Store(key, options.cchMaxChunk, options.layout, recording);
+				}
+			}
+			result.fWorkerLost = remote.IsWorkerLost();
+			remote.Close();
+			pdf.Close();
+		}
+		result.cbFile = source.GetSize();
+		result.cGetBlock = source.GetReadCount();
+		result.cbGetBlock = source.GetReadBytes();
+	}
+	Clock::time_point end = Clock::now();
+	result.cAllocations = t_cAllocations - cAllocationsBefore;
+
+	result.cChunks = sink.m_cChunks;
+	result.cLanguageChunks = sink.m_cLanguageChunks;
+	result.cchText = sink.m_cchText;
+	result.cWords = sink.m_cWords;
+	result.cchLongestWord = sink.m_cchLongestWord;
+	result.totalMs = Milliseconds(start, end);
+	if (sink.m_fHaveText)
+	{
+		result.firstTextMs = Milliseconds(start, sink.m_firstText);
+	}
+	return result;
+}
+
+void CollectPdfs(const fs::path& path, std::vector<fs::path>& files)
+{
+	std::error_code ec;
+	if (fs::is_directory(path, ec))
+	{
+		for (const fs::directory_entry& entry : fs::recursive_directory_iterator(path, ec))
+		{
+			std::string ext = entry.path().extension().u8string();
+			std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+			if (ext == ".pdf" && entry.is_regular_file(ec))
+			{
+				files.push_back(entry.path());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+	else
+	{
+		files.push_back(path);
+	}
+}
+
+// nearest-rank percentile of sorted values
+double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+	size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.999999);
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+uint64_t GetPeakRssBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::string JsonString(const std::string& text)
+{
+	std::string json = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			json += '\\';
+			json += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+			json += escape;
+		}
+		else
+		{
+			json += c;
+		}
+	}
+	return json + "\"";
+}
+
+int main(int argc, char** argv)
+{
+	int cRepeat = 1;
+	BenchOptions options;
+	options.cchMaxChunk = 64 * 1024;
+	options.fPages = true;
+	options.budget = ExtractionBudget();
+	options.layout = TEXTLAYOUT_LINES;
+	uint32_t cWorkers = 0;
+	uint32_t cDocumentsPerWorker = 0;
+	fs::path workerPath = fs::path(argv[0]).parent_path() / "PdfWorker";
+#ifdef _WIN32
+	workerPath += ".exe";
+#endif
+	std::string jsonPath;
+	int argi = 1;
+	for (; argi + 1 < argc && strncmp(argv[argi], "--", 2) == 0; argi += 2)
+	{
+		if (strcmp(argv[argi], "--properties-only") == 0)
+		{
+			options.fPages = false;
+			argi--;
+		}
+		else if (strcmp(argv[argi], "--repeat") == 0)
+		{
+			cRepeat = std::max(1, atoi(argv[argi + 1]));
+		}
+		else if (strcmp(argv[argi], "--max-chunk") == 0)
+		{
+			options.cchMaxChunk = static_cast<uint32_t>(strtoul(argv[argi + 1], NULL, 10));
+		}
+		else if (strcmp(argv[argi], "--doc-budget-ms") == 0)
+		{
+			options.budget.msDocument = static_cast<uint32_t>(strtoul(argv[argi + 1], NULL, 10));
+		}
+		else if (strcmp(argv[argi], "--page-budget-ms") == 0)
+		{
+			options.budget.msPage = static_cast<uint32_t>(strtoul(argv[argi + 1], NULL, 10));
+		}
+		else if (strcmp(argv[argi], "--max-chars") == 0)
+		{
+			options.budget.cchDocument = strtoull(argv[argi + 1], NULL, 10);
+		}
+		else if (strcmp(argv[argi], "--layout") == 0)
+		{
+			options.layout = LayoutFromName(argv[argi + 1]);
+		}
+		else if (strcmp(argv[argi], "--cache") == 0)
+		{
+			if (!options.cache.Open(fs::path(argv[argi + 1]).native(), 1024ULL * 1024 * 1024, 64 * 1024 * 1024))
+			{
+				std::cerr << "can't use " << argv[argi + 1] << " as the chunk cache" << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[argi], "--workers") == 0)
+		{
+			cWorkers = static_cast<uint32_t>(strtoul(argv[argi + 1], NULL, 10));
+		}
+		else if (strcmp(argv[argi], "--worker-path") == 0)
+		{
+			workerPath = argv[argi + 1];
+		}
+		else if (strcmp(argv[argi], "--worker-documents") == 0)
+		{
+			cDocumentsPerWorker = static_cast<uint32_t>(strtoul(argv[argi + 1], NULL, 10));
+		}
+		else if (strcmp(argv[argi], "--json") == 0)
+		{
+			jsonPath = argv[argi + 1];
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (argc <= argi)
+	{
+		std::cerr << "PdfBench [--repeat N] [--max-chunk N] [--properties-only] [--cache dir]"
+			" [--doc-budget-ms N] [--page-budget-ms N] [--max-chars N] [--layout none|lines|structure]"
+			" [--workers N] [--worker-path PdfWorker] [--worker-documents N] [--json out.json] corpusDir" << std::endl;
+		return 1;
+	}
+
+	std::vector<fs::path> files;
+	CollectPdfs(argv[argi], files);
+	if (files.empty())
+	{
+		std::cerr << "no PDF in " << argv[argi] << std::endl;
+		return 1;
+	}
+
+	CTrace::OpenFileFromEnvironment();
+
+	// started here rather than by the first document, so that no document pays for it
+	CPdfiumLibrary::Initialize();
+	double initMs = CPdfiumLibrary::GetInitMicroseconds() / 1000.0;
+
+	std::vector<DocResult> results;
+	Clock::time_point start = Clock::now();
+	if (cWorkers == 0)
+	{
+		CDocumentExtractor pdf;
+		for (int repeat = 0; repeat < cRepeat; repeat++)
+		{
+			for (const fs::path& file : files)
+			{
+				results.push_back(RunDocument(file, options, pdf));
+			}
+		}
+	}
+	else
+	{
+		// one thread per worker, each taking the next document
+		options.workerPool.Open(workerPath.native(), cWorkers, cDocumentsPerWorker, 0);
+		results.resize(files.size() * cRepeat);
+		std::atomic<size_t> iNext(0);
+		std::vector<std::thread> threads;
+		for (uint32_t x = 0; x < cWorkers; x++)
+		{
+			threads.emplace_back([&]()
+				{
+					CDocumentExtractor pdf;
+					for (size_t i; (i = iNext++) < results.size();)
+					{
+						results[i] = RunDocument(files[i % files.size()], options, pdf);
+					}
+				});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+	double wallMs = Milliseconds(start, Clock::now());
+
+	CPdfiumLibrary::Shutdown();
+	CTrace::Shutdown();
+
+	uint64_t cPages = 0, cPagesWithoutText = 0, cPagesWithUnicodeErrors = 0, cbFiles = 0, cchText = 0, cWords = 0, cchLongestWord = 0, cChunks = 0, cLanguageChunks = 0, cGetBlock = 0, cbGetBlock = 0, cAllocations = 0;
+	int cFailed = 0;
+	int cCacheHits = 0;
+	int cTruncated = 0;
+	int cWorkersLost = 0;
+	std::vector<double> docMs, firstTextMs;
+	for (const DocResult& result : results)
+	{
+		cFailed += result.fOpened ? 0 : 1;
+		cCacheHits += result.fCacheHit ? 1 : 0;
+		cTruncated += (result.truncation != TRUNCATION_NONE) ? 1 : 0;
+		cWorkersLost += result.fWorkerLost ? 1 : 0;
+		cPages += result.cPages;
+		cPagesWithoutText += result.cPagesWithoutText;
+		cPagesWithUnicodeErrors += result.cPagesWithUnicodeErrors;
+		cbFiles += result.cbFile;
+		cchText += result.cchText;
+		cWords += result.cWords;
+		cchLongestWord = std::max(cchLongestWord, result.cchLongestWord);
+		cChunks += result.cChunks;
+		cLanguageChunks += result.cLanguageChunks;
+		cGetBlock += result.cGetBlock;
+		cbGetBlock += result.cbGetBlock;
+		cAllocations += result.cAllocations;
+		docMs.push_back(result.totalMs);
+		if (0 <= result.firstTextMs)
+		{
+			firstTextMs.push_back(result.firstTextMs);
+		}
+	}
+	std::sort(docMs.begin(), docMs.end());
+	std::sort(firstTextMs.begin(), firstTextMs.end());
+
+	double seconds = wallMs / 1000;
+	double pagesPerSec = (seconds > 0) ? cPages / seconds : 0;
+	double mbPerSec = (seconds > 0) ? cbFiles / (1024.0 * 1024.0) / seconds : 0;
+	uint64_t peakRss = GetPeakRssBytes();
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "documents        " << results.size() << " (" << cFailed << " failed, " << cCacheHits << " from the chunk cache, " << cTruncated << " truncated)" << std::endl
+		<< "pages            " << cPages << " (" << cPagesWithoutText << " without text objects, " << cPagesWithUnicodeErrors << " with Unicode map errors)" << std::endl
+		<< "wall             " << wallMs << " ms (PDFium init " << initMs << " ms)" << std::endl
+		<< "pages/sec        " << pagesPerSec << std::endl
+		<< "MB/sec           " << mbPerSec << std::endl
+		<< "doc ms p50/95/99 " << Percentile(docMs, 50) << " / " << Percentile(docMs, 95) << " / " << Percentile(docMs, 99) << std::endl
+		<< "first text p50/95 " << Percentile(firstTextMs, 50) << " / " << Percentile(firstTextMs, 95) << " ms" << std::endl
+		<< "chunks           " << cChunks << " (" << cchText << " chars, " << cLanguageChunks << " in a language)" << std::endl
+		<< "words            " << cWords << " (longest " << cchLongestWord << " chars, layout " << LayoutName(options.layout) << ")" << std::endl
+		<< "GetBlock         " << cGetBlock << " calls, " << cbGetBlock << " bytes" << std::endl
+		<< "allocations      " << cAllocations << " (" << ((cPages != 0) ? static_cast<double>(cAllocations) / cPages : 0) << " per page)" << std::endl
+		<< "peak RSS         " << peakRss / (1024 * 1024) << " MB" << std::endl;
+	if (cWorkers != 0)
+	{
+		std::cout << "workers          " << cWorkers << " (" << options.workerPool.GetStartCount() << " started, " << cWorkersLost << " lost)" << std::endl;
+	}
+
+	if (!jsonPath.empty())
+	{
+		std::ostringstream json;
+		json << std::fixed << std::setprecision(3)
+			<< "{\n"
+			<< "  \"documents\": " << results.size() << ",\n"
+			<< "  \"failed\": " << cFailed << ",\n"
+			<< "  \"cacheHits\": " << cCacheHits << ",\n"
+			<< "  \"truncated\": " << cTruncated << ",\n"
+			<< "  \"repeat\": " << cRepeat << ",\n"
+			<< "  \"maxChunkChars\": " << options.cchMaxChunk << ",\n"
+			<< "  \"pagesEmitted\": " << (options.fPages ? "true" : "false") << ",\n"
+			<< "  \"pages\": " << cPages << ",\n"
+			<< "  \"pagesWithoutText\": " << cPagesWithoutText << ",\n"
+			<< "  \"pagesWithUnicodeErrors\": " << cPagesWithUnicodeErrors << ",\n"
+			<< "  \"bytes\": " << cbFiles << ",\n"
+			<< "  \"chars\": " << cchText << ",\n"
+			<< "  \"chunks\": " << cChunks << ",\n"
+			<< "  \"languageChunks\": " << cLanguageChunks << ",\n"
+			<< "  \"layout\": \"" << LayoutName(options.layout) << "\",\n"
+			<< "  \"words\": " << cWords << ",\n"
+			<< "  \"longestWord\": " << cchLongestWord << ",\n"
+			<< "  \"pdfiumInitMs\": " << initMs << ",\n"
+			<< "  \"wallMs\": " << wallMs << ",\n"
+			<< "  \"pagesPerSec\": " << pagesPerSec << ",\n"
+			<< "  \"mbPerSec\": " << mbPerSec << ",\n"
+			<< "  \"docMs\": { \"p50\": " << Percentile(docMs, 50) << ", \"p95\": " << Percentile(docMs, 95) << ", \"p99\": " << Percentile(docMs, 99) << " },\n"
+			<< "  \"firstTextMs\": { \"p50\": " << Percentile(firstTextMs, 50) << ", \"p95\": " << Percentile(firstTextMs, 95) << ", \"p99\": " << Percentile(firstTextMs, 99) << " },\n"
+			<< "  \"getBlockCalls\": " << cGetBlock << ",\n"
+			<< "  \"getBlockBytes\": " << cbGetBlock << ",\n"
+			<< "  \"allocations\": " << cAllocations << ",\n"
+			<< "  \"peakRssBytes\": " << peakRss << ",\n"
+			<< "  \"workers\": " << cWorkers << ",\n"
+			<< "  \"workerStarts\": " << options.workerPool.GetStartCount() << ",\n"
+			<< "  \"workersLost\": " << cWorkersLost << ",\n"
+			<< "  \"results\": [\n";
+		for (size_t x = 0; x < results.size(); x++)
+		{
+			const DocResult& result = results[x];
+			json << "    { \"path\": " << JsonString(result.path)
+				<< ", \"opened\": " << (result.fOpened ? "true" : "false")
+				<< ", \"cacheHit\": " << (result.fCacheHit ? "true" : "false")
+				<< ", \"truncation\": " << result.truncation
+				<< ", \"workerLost\": " << (result.fWorkerLost ? "true" : "false")
+				<< ", \"bytes\": " << result.cbFile
+				<< ", \"pages\": " << result.cPages
+				<< ", \"pagesWithoutText\": " << result.cPagesWithoutText
+				<< ", \"pagesWithUnicodeErrors\": " << result.cPagesWithUnicodeErrors
+				<< ", \"chunks\": " << result.cChunks
+				<< ", \"languageChunks\": " << result.cLanguageChunks
+				<< ", \"chars\": " << result.cchText
+				<< ", \"words\": " << result.cWords
+				<< ", \"longestWord\": " << result.cchLongestWord
+				<< ", \"getBlockCalls\": " << result.cGetBlock
+				<< ", \"getBlockBytes\": " << result.cbGetBlock
+				<< ", \"allocations\": " << result.cAllocations
+				<< ", \"openMs\": " << result.openMs
+				<< ", \"firstTextMs\": " << result.firstTextMs
+				<< ", \"totalMs\": " << result.totalMs
+				<< " }" << (x + 1 < results.size() ? "," : "") << "\n";
+		}
+		json << "  ]\n}\n";
+
+		std::ofstream out(jsonPath, std::ios::binary);
+		out << json.str();
+		if (!out)
+		{
+			std::cerr << "can't write " << jsonPath << std::endl;
+			return 1;
+		}
+	}
+
+	return (cFailed == 0) ? 0 : 2;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Random access to the bytes of a PDF file, as PDFium reads them through FPDF_FILEACCESS.
+//
+// The COM filter implements it over its IStream (through CBlockCache) or a mapped file,
+// the console tools over a plain file.
+class IByteSource
+{
+public:
+	virtual ~IByteSource()
+	{
+	}
+
+	virtual uint64_t GetSize() const = 0;
+
+	// Copies [position, position + size) into pBuf. Returns false on a read error or past the end.
+	virtual bool Read(uint64_t position, uint8_t* pBuf, uint32_t size) = 0;
+
+	// [position, position + size) is needed soon: the download hints of linearized documents.
+	virtual void Prefetch(uint64_t position, uint64_t size)
+	{
+		(void)position;
+		(void)size;
+	}
+
+	// The whole file as contiguous memory, or NULL. Such a source is parsed in place and may exceed 4 GB.
+	virtual const uint8_t* GetData() const
+	{
+		return NULL;
+	}
+};
+
+// Bytes already in memory, e.g. a mapped view. The memory must outlive the document.
+class CMemoryByteSource : public IByteSource
+{
+public:
+	CMemoryByteSource() : m_pData(NULL), m_cbData(0)
+	{
+	}
+
+	CMemoryByteSource(const uint8_t* pData, uint64_t cbData) : m_pData(pData), m_cbData(cbData)
+	{
+	}
+
+	uint64_t GetSize() const override
+	{
+		return m_cbData;
+	}
+
+	bool Read(uint64_t position, uint8_t* pBuf, uint32_t size) override
+	{
+		if (position > m_cbData || size > m_cbData - position)
+		{
+			return false;
+		}
+		memcpy(pBuf, m_pData + position, size);
+		return true;
+	}
+
+	const uint8_t* GetData() const override
+	{
+		return m_pData;
+	}
+
+private:
+	const uint8_t* m_pData;
+	uint64_t m_cbData;
+};
@@ -0,0 +1,613 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "ChunkCache.h"
+#include "DocumentExtractor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+	const char ENTRY_MAGIC[8] = { 'P', 'D', 'F', 'C', 'H', 'N', 'K', '\0' };
+	// layout of the entry files; CDocumentExtractor::OUTPUT_VERSION covers their contents
+	// 3: the language of the text records
+	// 4: the page count and the dates typed
+	const uint32_t ENTRY_FORMAT = 4;
+	// written in native order: an entry from a machine of the other byte order is a miss
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	const uint8_t RECORD_PROPERTY = 0;
+	const uint8_t RECORD_TEXT = 1;
+	// a uint64_t in place of the text: the number, or the PackUtcTime of the date
+	const uint8_t RECORD_PROPERTY_UINT32 = 2;
+	const uint8_t RECORD_PROPERTY_TIME = 3;
+
+	const uint32_t SAMPLE_EDGE = 64 * 1024;
+	const uint32_t SAMPLE_BLOCK = 4 * 1024;
+	const uint32_t SAMPLE_BLOCKS = 64;
+
+	const uint64_t NS_PER_SECOND = 1000000000ULL;
+	// an entry whose temporary file is older than this was abandoned by a crashed writer
+	const uint64_t ABANDONED_NS = 60 * 60 * NS_PER_SECOND;
+	// The directory is scanned for the budget on the first store, then whenever this process has
+	// stored a tenth of the budget: the slack Trim() leaves. Other processes sharing the directory
+	// do the same, so the budget is exceeded by about that much per process at most.
+	std::atomic<uint64_t> s_cbSinceTrim(UINT64_MAX / 2);
+
+	struct EntryHeader
+	{
+		char magic[8];
+		uint32_t format;
+		uint32_t byteOrder;
+		uint32_t outputVersion;
+		uint32_t cchMaxChunk;
+		uint32_t layout;
+		uint32_t reserved;
+		uint64_t hash;
+		uint64_t cbFile;
+		uint64_t cbRecords;
+	};
+
+	struct RecordHeader
+	{
+		uint8_t kind;
+		// PDFPROPERTY, or 1 for a continued text chunk
+		uint8_t arg;
+		// characters of the language tag after the text, at most MAX_LANGUAGE_CHARS
+		uint16_t cchLanguage;
+		int32_t pageIndex;
+		uint32_t cch;
+	};
+
+	// FNV-1a, 64-bit
+	class CHash64
+	{
+	public:
+		CHash64() : m_hash(14695981039346656037ULL)
+		{
+		}
+
+		void Add(const void* pData, size_t cb)
+		{
+			const uint8_t* pb = static_cast<const uint8_t*>(pData);
+			for (size_t x = 0; x < cb; x++)
+			{
+				m_hash = (m_hash ^ pb[x]) * 1099511628211ULL;
+			}
+		}
+
+		uint64_t Get() const
+		{
+			return m_hash;
+		}
+
+	private:
+		uint64_t m_hash;
+	};
+
+	bool HashRange(IByteSource& source, uint64_t position, uint64_t cb, std::vector<uint8_t>& buffer, CHash64& hash)
+	{
+		while (cb != 0)
+		{
+			uint32_t cbRead = static_cast<uint32_t>(std::min<uint64_t>(cb, buffer.size()));
+			if (!source.Read(position, buffer.data(), cbRead))
+			{
+				return false;
+			}
+			hash.Add(buffer.data(), cbRead);
+			position += cbRead;
+			cb -= cbRead;
+		}
+		return true;
+	}
+
+	FILE* OpenFile(const PathString& path, bool fWrite)
+	{
+#ifdef _WIN32
+		FILE* fp = NULL;
+		return (_wfopen_s(&fp, path.c_str(), fWrite ? L"wb" : L"rb") == 0) ? fp : NULL;
+#else
+		return fopen(path.c_str(), fWrite ? "wb" : "rb");
+#endif
+	}
+
+	void DeleteEntry(const PathString& path)
+	{
+#ifdef _WIN32
+		DeleteFileW(path.c_str());
+#else
+		unlink(path.c_str());
+#endif
+	}
+
+	// Replaces target atomically, so that a reader sees the old entry or the new one, never a part.
+	bool ReplaceEntry(const PathString& source, const PathString& target)
+	{
+#ifdef _WIN32
+		return MoveFileExW(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+		return rename(source.c_str(), target.c_str()) == 0;
+#endif
+	}
+
+	// Marks an entry as used now, for the LRU order.
+	void TouchEntry(const PathString& path)
+	{
+#ifdef _WIN32
+		HANDLE hFile = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+		if (hFile != INVALID_HANDLE_VALUE)
+		{
+			FILETIME ftNow;
+			GetSystemTimeAsFileTime(&ftNow);
+			SetFileTime(hFile, NULL, NULL, &ftNow);
+			CloseHandle(hFile);
+		}
+#else
+		utime(path.c_str(), NULL);
+#endif
+	}
+
+	struct EntryInfo
+	{
+		PathString path;
+		uint64_t cb;
+		// modification time, nanoseconds since 1970
+		uint64_t lastUsed;
+		bool fTemporary;
+	};
+
+	bool EndsWith(const PathString& name, const PathString& suffix)
+	{
+		return suffix.size() <= name.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	void ListEntries(const PathString& directory, std::vector<EntryInfo>& entries)
+	{
+#ifdef _WIN32
+		WIN32_FIND_DATAW findData;
+		HANDLE hFind = FindFirstFileW((directory + L"\\*").c_str(), &findData);
+		if (hFind == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		do
+		{
+			if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			{
+				continue;
+			}
+			PathString name = findData.cFileName;
+			EntryInfo entry;
+			entry.path = directory + L"\\" + name;
+			entry.cb = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+			// FILETIME counts 100 ns from 1601
+			uint64_t ft = (static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime;
+			entry.lastUsed = (ft - 116444736000000000ULL) * 100;
+			entry.fTemporary = EndsWith(name, L".tmp");
+			if (entry.fTemporary || EndsWith(name, L".chunks"))
+			{
+				entries.push_back(entry);
+			}
+		} while (FindNextFileW(hFind, &findData));
+		FindClose(hFind);
+#else
+		DIR* pDir = opendir(directory.c_str());
+		if (pDir == NULL)
+		{
+			return;
+		}
+		while (struct dirent* pEntry = readdir(pDir))
+		{
+			PathString name = pEntry->d_name;
+			struct stat st;
+			EntryInfo entry;
+			entry.path = directory + "/" + name;
+			if (stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			{
+				continue;
+			}
+			entry.cb = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+			entry.lastUsed = static_cast<uint64_t>(st.st_mtimespec.tv_sec) * NS_PER_SECOND + st.st_mtimespec.tv_nsec;
+#else
+			entry.lastUsed = static_cast<uint64_t>(st.st_mtim.tv_sec) * NS_PER_SECOND + st.st_mtim.tv_nsec;
+#endif
+			entry.fTemporary = EndsWith(name, ".tmp");
+			if (entry.fTemporary || EndsWith(name, ".chunks"))
+			{
+				entries.push_back(entry);
+			}
+		}
+		closedir(pDir);
+#endif
+	}
+}
+
+CChunkRecording::CChunkRecording()
+	: m_cbLimit(0), m_fOverflowed(false), m_ibReplay(0), m_propertyMask(PDFPROPERTY_ALL), m_fEmitPages(true)
+{
+}
+
+void CChunkRecording::Reset(uint64_t cbLimit)
+{
+	m_data.clear();
+	m_cbLimit = cbLimit;
+	m_fOverflowed = false;
+	m_ibReplay = 0;
+}
+
+void CChunkRecording::OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch)
+{
+	Append(RECORD_PROPERTY, static_cast<uint8_t>(property), -1, value, cch, "");
+}
+
+void CChunkRecording::OnPropertyUInt32(PDFPROPERTY property, uint32_t value)
+{
+	AppendValue(RECORD_PROPERTY_UINT32, property, value);
+}
+
+void CChunkRecording::OnPropertyTime(PDFPROPERTY property, const UtcTime& time)
+{
+	AppendValue(RECORD_PROPERTY_TIME, property, PackUtcTime(time));
+}
+
+void CChunkRecording::OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language)
+{
+	Append(RECORD_TEXT, fContinued ? 1 : 0, pageIndex, text, cch, language);
+}
+
+void CChunkRecording::Append(uint8_t kind, uint8_t arg, int32_t pageIndex, const char16_t* text, size_t cch, const char* language)
+{
+	size_t cbText = cch * sizeof(char16_t);
+	size_t cchLanguage = strlen(language);
+	if (m_fOverflowed || (m_cbLimit != 0 && m_cbLimit < m_data.size() + sizeof(RecordHeader) + cbText + cchLanguage) || UINT32_MAX < cch
+		|| MAX_LANGUAGE_CHARS < cchLanguage)
+	{
+		m_fOverflowed = true;
+		m_data.clear();
+		m_data.shrink_to_fit();
+		return;
+	}
+
+	RecordHeader header = { kind, arg, static_cast<uint16_t>(cchLanguage), pageIndex, static_cast<uint32_t>(cch) };
+	size_t ib = m_data.size();
+	m_data.resize(ib + sizeof(header) + cbText + cchLanguage);
+	memcpy(&m_data[ib], &header, sizeof(header));
+	if (cbText != 0)
+	{
+		memcpy(&m_data[ib + sizeof(header)], text, cbText);
+	}
+	if (cchLanguage != 0)
+	{
+		memcpy(&m_data[ib + sizeof(header) + cbText], language, cchLanguage);
+	}
+}
+
+void CChunkRecording::AppendValue(uint8_t kind, PDFPROPERTY property, uint64_t value)
+{
+	char16_t text[sizeof(value) / sizeof(char16_t)];
+	memcpy(text, &value, sizeof(value));
+	Append(kind, static_cast<uint8_t>(property), -1, text, sizeof(text) / sizeof(text[0]), "");
+}
+
+bool CChunkRecording::Step(IChunkSink& sink)
+{
+	while (m_ibReplay + sizeof(RecordHeader) <= m_data.size())
+	{
+		RecordHeader header;
+		memcpy(&header, &m_data[m_ibReplay], sizeof(header));
+		if ((m_data.size() - m_ibReplay - sizeof(header)) / sizeof(char16_t) < header.cch
+			|| MAX_LANGUAGE_CHARS < header.cchLanguage
+			|| m_data.size() - m_ibReplay - sizeof(header) - header.cch * sizeof(char16_t) < header.cchLanguage)
+		{
+			break;
+		}
+		std::u16string& text = m_replayText;
+		text.resize(header.cch);
+		if (header.cch != 0)
+		{
+			memcpy(&text[0], &m_data[m_ibReplay + sizeof(header)], header.cch * sizeof(char16_t));
+		}
+		char language[MAX_LANGUAGE_CHARS + 1] = { 0 };
+		if (header.cchLanguage != 0)
+		{
+			memcpy(language, &m_data[m_ibReplay + sizeof(header) + header.cch * sizeof(char16_t)], header.cchLanguage);
+		}
+		m_ibReplay += sizeof(header) + header.cch * sizeof(char16_t) + header.cchLanguage;
+
+		if (header.kind != RECORD_TEXT)
+		{
+			PDFPROPERTY property = static_cast<PDFPROPERTY>(header.arg);
+			if (PDFPROPERTY_COUNT <= header.arg || (m_propertyMask & PropertyBit(property)) == 0)
+			{
+				continue;
+			}
+			uint64_t value = 0;
+			if (header.kind != RECORD_PROPERTY)
+			{
+				if (text.size() * sizeof(char16_t) != sizeof(value))
+				{
+					break;
+				}
+				memcpy(&value, text.data(), sizeof(value));
+			}
+			switch (header.kind)
+			{
+			case RECORD_PROPERTY_UINT32:
+				sink.OnPropertyUInt32(property, static_cast<uint32_t>(value));
+				break;
+			case RECORD_PROPERTY_TIME:
+				sink.OnPropertyTime(property, UnpackUtcTime(value));
+				break;
+			default:
+				sink.OnProperty(property, text.data(), text.size());
+				break;
+			}
+			return true;
+		}
+		else if (m_fEmitPages)
+		{
+			sink.OnText(header.pageIndex, text.data(), text.size(), header.arg != 0, language);
+			return true;
+		}
+	}
+	return false;
+}
+
+CChunkCache::CChunkCache() : m_cbBudget(0), m_cbMaxEntry(0)
+{
+}
+
+bool CChunkCache::Open(const PathString& directory, uint64_t cbBudget, uint64_t cbMaxEntry)
+{
+	m_directory.clear();
+	if (directory.empty() || cbBudget == 0)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	if (!CreateDirectoryW(directory.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		return false;
+	}
+#else
+	if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+	{
+		return false;
+	}
+#endif
+
+	m_directory = directory;
+	m_cbBudget = cbBudget;
+	m_cbMaxEntry = std::min(cbMaxEntry, cbBudget);
+	return true;
+}
+
+bool CChunkCache::ComputeKey(IByteSource& source, ChunkCacheKey& key)
+{
+	CHash64 hash;
+	std::vector<uint8_t> buffer(SAMPLE_EDGE);
+	uint64_t cbFile = source.GetSize();
+	hash.Add(&cbFile, sizeof(cbFile));
+
+	if (cbFile <= 16 * SAMPLE_EDGE)
+	{
+		if (!HashRange(source, 0, cbFile, buffer, hash))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (!HashRange(source, 0, SAMPLE_EDGE, buffer, hash))
+		{
+			return false;
+		}
+		uint64_t cbMiddle = cbFile - 2 * SAMPLE_EDGE;
+		for (uint32_t x = 0; x < SAMPLE_BLOCKS; x++)
+		{
+			uint64_t position = SAMPLE_EDGE + cbMiddle * x / SAMPLE_BLOCKS;
+			if (!HashRange(source, position, std::min<uint64_t>(SAMPLE_BLOCK, cbFile - SAMPLE_EDGE - position), buffer, hash))
+			{
+				return false;
+			}
+		}
+		if (!HashRange(source, cbFile - SAMPLE_EDGE, SAMPLE_EDGE, buffer, hash))
+		{
+			return false;
+		}
+	}
+
+	key.hash = hash.Get();
+	key.cbFile = cbFile;
+	return true;
+}
+
+PathString CChunkCache::GetEntryPath(const ChunkCacheKey& key) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx-%llx.chunks", static_cast<unsigned long long>(key.hash), static_cast<unsigned long long>(key.cbFile));
+#ifdef _WIN32
+	return m_directory + L"\\" + PathString(name, name + strlen(name));
+#else
+	return m_directory + "/" + name;
+#endif
+}
+
+bool CChunkCache::Load(const ChunkCacheKey& key, uint32_t cchMaxChunk, TEXTLAYOUT layout, CChunkRecording& recording)
+{
+	recording.Reset(0);
+	if (!IsEnabled())
+	{
+		return false;
+	}
+
+	PathString path = GetEntryPath(key);
+	FILE* fp = OpenFile(path, false);
+	if (fp == NULL)
+	{
+		return false;
+	}
+
+	EntryHeader header;
+	uint64_t checksum = 0;
+	bool fRead = fread(&header, sizeof(header), 1, fp) == 1
+		&& memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0
+		&& header.format == ENTRY_FORMAT
+		&& header.byteOrder == BYTE_ORDER_MARK
+		&& header.cbRecords <= m_cbMaxEntry;
+	if (fRead)
+	{
+		recording.m_data.resize(static_cast<size_t>(header.cbRecords));
+		fRead = (header.cbRecords == 0 || fread(recording.m_data.data(), static_cast<size_t>(header.cbRecords), 1, fp) == 1)
+			&& fread(&checksum, sizeof(checksum), 1, fp) == 1;
+	}
+	fclose(fp);
+
+	CHash64 hash;
+	if (fRead)
+	{
+		hash.Add(&header, sizeof(header));
+		hash.Add(recording.m_data.data(), recording.m_data.size());
+	}
+	if (!fRead || hash.Get() != checksum)
+	{
+		// torn or damaged
+		recording.Reset(0);
+		DeleteEntry(path);
+		return false;
+	}
+
+	if (header.outputVersion != CDocumentExtractor::OUTPUT_VERSION || header.cchMaxChunk != cchMaxChunk || header.layout != static_cast<uint32_t>(layout)
+		|| header.hash != key.hash || header.cbFile != key.cbFile)
+	{
+		// made by another version or with other settings: it is replaced when this document is stored
+		recording.Reset(0);
+		return false;
+	}
+
+	TouchEntry(path);
+	return true;
+}
+
+void CChunkCache::Store(const ChunkCacheKey& key, uint32_t cchMaxChunk, TEXTLAYOUT layout, const CChunkRecording& recording)
+{
+	if (!IsEnabled() || !recording.IsComplete() || recording.IsOverflowed() || m_cbMaxEntry < recording.m_data.size())
+	{
+		return;
+	}
+
+	EntryHeader header;
+	memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+	header.format = ENTRY_FORMAT;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.outputVersion = CDocumentExtractor::OUTPUT_VERSION;
+	header.cchMaxChunk = cchMaxChunk;
+	header.layout = layout;
+	header.reserved = 0;
+	header.hash = key.hash;
+	header.cbFile = key.cbFile;
+	header.cbRecords = recording.m_data.size();
+
+	CHash64 hash;
+	hash.Add(&header, sizeof(header));
+	hash.Add(recording.m_data.data(), recording.m_data.size());
+	uint64_t checksum = hash.Get();
+
+	// unique among the processes and threads that may store the same document at once
+	static std::atomic<unsigned> s_cStores(0);
+	unsigned iStore = s_cStores++;
+	char suffix[64];
+#ifdef _WIN32
+	snprintf(suffix, sizeof(suffix), ".%lu-%u.tmp", GetCurrentProcessId(), iStore);
+#else
+	snprintf(suffix, sizeof(suffix), ".%ld-%u.tmp", static_cast<long>(getpid()), iStore);
+#endif
+	PathString entryPath = GetEntryPath(key);
+	PathString tempPath = entryPath + PathString(suffix, suffix + strlen(suffix));
+
+	FILE* fp = OpenFile(tempPath, true);
+	if (fp == NULL)
+	{
+		return;
+	}
+	bool fWritten = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& (recording.m_data.empty() || fwrite(recording.m_data.data(), recording.m_data.size(), 1, fp) == 1)
+		&& fwrite(&checksum, sizeof(checksum), 1, fp) == 1;
+	fWritten = (fclose(fp) == 0) && fWritten;
+
+	if (!fWritten || !ReplaceEntry(tempPath, entryPath))
+	{
+		DeleteEntry(tempPath);
+		return;
+	}
+
+	uint64_t cbEntry = sizeof(header) + recording.m_data.size() + sizeof(checksum);
+	if (m_cbBudget / 10 <= (s_cbSinceTrim += cbEntry))
+	{
+		s_cbSinceTrim = 0;
+		Trim(entryPath);
+	}
+}
+
+void CChunkCache::Trim(const PathString& keep)
+{
+	std::vector<EntryInfo> entries;
+	ListEntries(m_directory, entries);
+
+	uint64_t now = static_cast<uint64_t>(time(NULL)) * NS_PER_SECOND;
+	uint64_t cbTotal = 0;
+	for (const EntryInfo& entry : entries)
+	{
+		cbTotal += entry.cb;
+	}
+	if (cbTotal <= m_cbBudget)
+	{
+		// only abandoned temporary files to clean up
+		for (const EntryInfo& entry : entries)
+		{
+			if (entry.fTemporary && entry.lastUsed + ABANDONED_NS < now)
+			{
+				DeleteEntry(entry.path);
+			}
+		}
+		return;
+	}
+
+	// least recently used first; go down to 90% so that the next stores don't trim again at once
+	std::sort(entries.begin(), entries.end(), [](const EntryInfo& a, const EntryInfo& b) { return a.lastUsed < b.lastUsed; });
+	uint64_t cbTarget = m_cbBudget / 10 * 9;
+	for (const EntryInfo& entry : entries)
+	{
+		if (cbTotal <= cbTarget)
+		{
+			break;
+		}
+		if (entry.path == keep || (entry.fTemporary && now <= entry.lastUsed + ABANDONED_NS))
+		{
+			continue; // just stored, or being written
+		}
+		DeleteEntry(entry.path);
+		cbTotal -= std::min(cbTotal, entry.cb);
+	}
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ByteSource.h"
+#include "ChunkSink.h"
+
+#ifdef _WIN32
+typedef std::wstring PathString;
+#else
+typedef std::string PathString;
+#endif
+
+// Identifies the content of a document: a hash of sampled blocks and the size.
+struct ChunkCacheKey
+{
+	uint64_t hash;
+	uint64_t cbFile;
+};
+
+// The chunk sequence of a document, in the format it is cached in.
+//
+// As a sink it records the chunks CDocumentExtractor emits; Step() then replays them
+// to another sink, one chunk per call, without PDFium.
+class CChunkRecording : public IChunkSink
+{
+public:
+	CChunkRecording();
+
+	// Forgets the chunks. Recording stops (IsOverflowed) beyond cbLimit bytes; 0 is no limit.
+	void Reset(uint64_t cbLimit);
+
+	bool IsOverflowed() const
+	{
+		return m_fOverflowed;
+	}
+
+	void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override;
+	void OnPropertyUInt32(PDFPROPERTY property, uint32_t value) override;
+	void OnPropertyTime(PDFPROPERTY property, const UtcTime& time) override;
+	void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language) override;
+
+	// Same contract as CDocumentExtractor::SetEmitFilter, for the replay.
+	void SetEmitFilter(uint32_t propertyMask, bool fPages)
+	{
+		m_propertyMask = propertyMask;
+		m_fEmitPages = fPages;
+	}
+
+	// Whether the emit filter lets every chunk through. The filter of the extractor being recorded is
+	// the same, so only then is the recording the complete sequence that may be cached.
+	bool IsComplete() const
+	{
+		return m_propertyMask == PDFPROPERTY_ALL && m_fEmitPages;
+	}
+
+	// Replays the next chunk to sink. Returns false after the last one. The text stays valid until
+	// the next Step or Reset.
+	bool Step(IChunkSink& sink);
+
+private:
+	friend class CChunkCache;
+
+	void Append(uint8_t kind, uint8_t arg, int32_t pageIndex, const char16_t* text, size_t cch, const char* language);
+	// a record of a typed property, with value in place of the text
+	void AppendValue(uint8_t kind, PDFPROPERTY property, uint64_t value);
+
+	// Records, each a RecordHeader followed by the UTF-16 text and the language
+	std::vector<uint8_t> m_data;
+	uint64_t m_cbLimit;
+	bool m_fOverflowed;
+	size_t m_ibReplay;
+	// the text of the chunk replayed last, copied out: the records are not aligned for char16_t
+	std::u16string m_replayText;
+	uint32_t m_propertyMask;
+	bool m_fEmitPages;
+};
+
+// Opt-in on-disk cache of chunk sequences, so that a document filtered again replays its chunks
+// instead of being parsed and laid out.
+//
+// One file per document, named after the key. Entries are written to a temporary file and renamed
+// into place, and carry a checksum: a torn or damaged entry is a miss and is deleted.
+// The total size is kept under a budget by deleting the least recently used entries; a hit touches
+// the modification time of its entry.
+class CChunkCache
+{
+public:
+	CChunkCache();
+
+	// Caches in directory, which is created if needed. cbMaxEntry bounds the chunk data of one document.
+	// Returns false if the directory can't be used; the cache then stays disabled.
+	bool Open(const PathString& directory, uint64_t cbBudget, uint64_t cbMaxEntry);
+
+	bool IsEnabled() const
+	{
+		return !m_directory.empty();
+	}
+
+	uint64_t GetMaxEntrySize() const
+	{
+		return m_cbMaxEntry;
+	}
+
+	// Hashes the size, the first and last 64 KB (header, trailer, /ID and the last xref) and 64
+	// blocks spread over the rest. Files up to 1 MB are hashed whole. Returns false on a read error.
+	static bool ComputeKey(IByteSource& source, ChunkCacheKey& key);
+
+	// Loads the chunks cached for key with the same chunk size and layout into recording, ready to replay.
+	bool Load(const ChunkCacheKey& key, uint32_t cchMaxChunk, TEXTLAYOUT layout, CChunkRecording& recording);
+
+	// Caches a complete recording; one made under a narrower emit filter (IsComplete) is not stored.
+	// Failures are ignored: the cache is only an optimization.
+	void Store(const ChunkCacheKey& key, uint32_t cchMaxChunk, TEXTLAYOUT layout, const CChunkRecording& recording);
+
+private:
+	PathString GetEntryPath(const ChunkCacheKey& key) const;
+	// Deletes the least recently used entries but keep while the cache is over its budget.
+	void Trim(const PathString& keep);
+
+	PathString m_directory;
+	uint64_t m_cbBudget;
+	uint64_t m_cbMaxEntry;
+};
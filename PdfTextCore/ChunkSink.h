@@ -0,0 +1,200 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Document properties emitted before the page text, in this order. The COM filter maps them to
+// PROPERTYKEYs. The values are text unless noted; an absent or unreadable property is not emitted.
+enum PDFPROPERTY {
+	PDFPROPERTY_TITLE,
+	PDFPROPERTY_AUTHOR,
+	PDFPROPERTY_SUBJECT,
+	PDFPROPERTY_KEYWORDS,
+	PDFPROPERTY_CREATOR,
+	PDFPROPERTY_PRODUCER,
+	// the Info dates in UTC, a UtcTime (IChunkSink::OnPropertyTime)
+	PDFPROPERTY_CREATION_DATE,
+	PDFPROPERTY_MOD_DATE,
+	// a number (IChunkSink::OnPropertyUInt32)
+	PDFPROPERTY_PAGE_COUNT,
+	// version of the file format, e.g. "1.7"
+	PDFPROPERTY_VERSION,
+	// "1" for a tagged PDF, absent otherwise
+	PDFPROPERTY_TAGGED,
+	// the page labels separated by ';', only if some label is not just the page number
+	PDFPROPERTY_PAGE_LABELS,
+	PDFPROPERTY_COUNT
+};
+
+// English name of a property, for the tools
+inline const char* PropertyName(PDFPROPERTY property)
+{
+	static const char* const NAMES[PDFPROPERTY_COUNT] = {
+		"Title", "Author", "Subject", "Keywords", "Creator", "Producer", "CreationDate", "ModDate",
+		"PageCount", "Version", "Tagged", "PageLabels",
+	};
+	return (0 <= property && property < PDFPROPERTY_COUNT) ? NAMES[property] : "?";
+}
+
+// for CDocumentExtractor::SetEmitFilter
+inline uint32_t PropertyBit(PDFPROPERTY property)
+{
+	return 1U << property;
+}
+
+const uint32_t PDFPROPERTY_ALL = ~0U;
+
+// How the runs of a page are joined into its text (CLayoutJoiner).
+enum TEXTLAYOUT {
+	// the runs glued as they come, the page text of OUTPUT_VERSION 1
+	TEXTLAYOUT_NONE,
+	// a space between the words of a line, a line break between lines and a blank line between
+	// blocks, from the rectangles of the runs
+	TEXTLAYOUT_LINES,
+	// as TEXTLAYOUT_LINES, but the runs of a tagged PDF in the reading order of its structure tree
+	// (CStructureOrder), with the ActualText and Alt of the elements and their Lang
+	TEXTLAYOUT_STRUCTURE,
+};
+
+// Name of a layout for the tools, as their --layout takes it
+inline const char* LayoutName(TEXTLAYOUT layout)
+{
+	return (layout == TEXTLAYOUT_NONE) ? "none" : (layout == TEXTLAYOUT_STRUCTURE) ? "structure" : "lines";
+}
+
+// and back: TEXTLAYOUT_LINES for a name it does not know
+inline TEXTLAYOUT LayoutFromName(const char* name)
+{
+	for (TEXTLAYOUT layout : { TEXTLAYOUT_NONE, TEXTLAYOUT_STRUCTURE })
+	{
+		if (strcmp(name, LayoutName(layout)) == 0)
+		{
+			return layout;
+		}
+	}
+	return TEXTLAYOUT_LINES;
+}
+
+// Languages of text are BCP 47 tags ("en-US") from the Lang of the structure elements, "" if
+// unknown. A tag is at most this many characters, the buffer RFC 5646 asks implementations to
+// allow; a longer one is taken as unknown.
+const size_t MAX_LANGUAGE_CHARS = 35;
+
+// A date in UTC, in the years FILETIME can hold (1601 to 9999)
+struct UtcTime
+{
+	int year;
+	// 1 to 12
+	int month;
+	int day;
+	int hour;
+	int minute;
+	int second;
+};
+
+// A UtcTime as one number, YYYYMMDDhhmmss, for the chunk cache and the worker channel. And back.
+inline uint64_t PackUtcTime(const UtcTime& time)
+{
+	return ((((static_cast<uint64_t>(time.year) * 100 + time.month) * 100 + time.day) * 100 + time.hour) * 100 + time.minute) * 100 + time.second;
+}
+
+inline UtcTime UnpackUtcTime(uint64_t packed)
+{
+	UtcTime time;
+	time.second = static_cast<int>(packed % 100);
+	time.minute = static_cast<int>(packed / 100 % 100);
+	time.hour = static_cast<int>(packed / 10000 % 100);
+	time.day = static_cast<int>(packed / 1000000 % 100);
+	time.month = static_cast<int>(packed / 100000000 % 100);
+	time.year = static_cast<int>(packed / 10000000000ULL % 10000);
+	return time;
+}
+
+// Receives the chunks of a document from CDocumentExtractor::Step, at most one per call.
+// The text is UTF-16 and not null terminated. The page text stays valid until the next Step or
+// Close of the extractor that emitted it (CDocumentExtractor, CRemoteExtractor, CChunkRecording),
+// so that the filter hands it to the host without a copy; a property value only during the call.
+// A sink must not call PDFium.
+class IChunkSink
+{
+public:
+	virtual ~IChunkSink()
+	{
+	}
+
+	virtual void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) = 0;
+
+	// The typed properties. A sink that only shows the values gets them as text by default: the
+	// number in decimal, the date as "YYYY-MM-DDTHH:MM:SSZ".
+	virtual void OnPropertyUInt32(PDFPROPERTY property, uint32_t value)
+	{
+		char text[16];
+		OnAsciiProperty(property, text, snprintf(text, sizeof(text), "%u", value));
+	}
+
+	virtual void OnPropertyTime(PDFPROPERTY property, const UtcTime& time)
+	{
+		char text[32];
+		OnAsciiProperty(property, text, snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+			time.year, time.month, time.day, time.hour, time.minute, time.second));
+	}
+
+	// Text of the page at pageIndex, in language. A page too long for one chunk, or in several
+	// languages, comes in several; all but the first have fContinued set.
+	virtual void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language) = 0;
+
+private:
+	void OnAsciiProperty(PDFPROPERTY property, const char* text, int cch)
+	{
+		char16_t value[32];
+		size_t cchValue = 0;
+		for (; 0 <= cch && cchValue < static_cast<size_t>(cch) && cchValue < sizeof(value) / sizeof(value[0]); cchValue++)
+		{
+			value[cchValue] = static_cast<char16_t>(text[cchValue]);
+		}
+		OnProperty(property, value, cchValue);
+	}
+};
+
+// Hands every chunk to two sinks, e.g. the host and a CChunkRecording.
+class CTeeChunkSink : public IChunkSink
+{
+public:
+	CTeeChunkSink(IChunkSink& first, IChunkSink& second) : m_first(first), m_second(second)
+	{
+	}
+
+	void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override
+	{
+		m_first.OnProperty(property, value, cch);
+		m_second.OnProperty(property, value, cch);
+	}
+
+	void OnPropertyUInt32(PDFPROPERTY property, uint32_t value) override
+	{
+		m_first.OnPropertyUInt32(property, value);
+		m_second.OnPropertyUInt32(property, value);
+	}
+
+	void OnPropertyTime(PDFPROPERTY property, const UtcTime& time) override
+	{
+		m_first.OnPropertyTime(property, time);
+		m_second.OnPropertyTime(property, time);
+	}
+
+	void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language) override
+	{
+		m_first.OnText(pageIndex, text, cch, fContinued, language);
+		m_second.OnText(pageIndex, text, cch, fContinued, language);
+	}
+
+private:
+	CTeeChunkSink& operator=(const CTeeChunkSink&);
+
+	IChunkSink& m_first;
+	IChunkSink& m_second;
+};
@@ -0,0 +1,974 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "DocumentExtractor.h"
+#include "PdfiumLibrary.h"
+#include "PdfiumLock.h"
+
+#include <fpdf_catalog.h>
+#include <fpdf_doc.h>
+#include <fpdf_edit.h>
+#include <fpdf_text.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// the clock is read before every this many runs, which are cheap compared to a clock read
+	const unsigned BUDGET_CHECK_RUNS = 64;
+
+	bool IsHighSurrogate(char16_t ch)
+	{
+		return 0xD800 <= ch && ch <= 0xDBFF;
+	}
+
+	// true for a text object, and for a form XObject that draws one
+	bool DrawsText(FPDF_PAGEOBJECT object)
+	{
+		switch (FPDFPageObj_GetType(object))
+		{
+		case FPDF_PAGEOBJ_PATH:
+		case FPDF_PAGEOBJ_IMAGE:
+		case FPDF_PAGEOBJ_SHADING:
+			return false;
+
+		case FPDF_PAGEOBJ_FORM:
+		{
+			int numObjects = FPDFFormObj_CountObjects(object);
+			for (int x = 0; x < numObjects; x++)
+			{
+				if (DrawsText(FPDFFormObj_GetObject(object, static_cast<unsigned long>(x))))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		default:
+			// text, or a type this code does not know: let the text page decide
+			return true;
+		}
+	}
+
+	// The text page holds the characters of the text objects only. A page without any, such as a
+	// scanned image, is known to be empty from its objects, which FPDF_LoadPage has already parsed,
+	// without building the text page.
+	bool HasTextObjects(FPDF_PAGE page)
+	{
+		int numObjects = FPDFPage_CountObjects(page);
+		for (int x = 0; x < numObjects; x++)
+		{
+			if (DrawsText(FPDFPage_GetObject(page, x)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Reads cDigits decimal digits at pos into value. Leaves both alone if they are not there.
+	bool ReadDigits(const char16_t* text, size_t cch, size_t& pos, size_t cDigits, int& value)
+	{
+		if (cch < pos + cDigits)
+		{
+			return false;
+		}
+		int n = 0;
+		for (size_t x = pos; x < pos + cDigits; x++)
+		{
+			if (text[x] < u'0' || u'9' < text[x])
+			{
+				return false;
+			}
+			n = n * 10 + (text[x] - u'0');
+		}
+		pos += cDigits;
+		value = n;
+		return true;
+	}
+
+	// days since 1970-01-01 in the proleptic Gregorian calendar, and back
+	int64_t DaysFromCivil(int year, int month, int day)
+	{
+		year -= (month <= 2) ? 1 : 0;
+		int64_t era = ((0 <= year) ? year : year - 399) / 400;
+		int64_t yearOfEra = year - era * 400;
+		int64_t dayOfYear = (153 * (month + ((2 < month) ? -3 : 9)) + 2) / 5 + day - 1;
+		int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		return era * 146097 + dayOfEra - 719468;
+	}
+
+	void CivilFromDays(int64_t days, int& year, int& month, int& day)
+	{
+		days += 719468;
+		int64_t era = ((0 <= days) ? days : days - 146096) / 146097;
+		int64_t dayOfEra = days - era * 146097;
+		int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+		int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+		int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+		day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+		month = static_cast<int>((monthIndex < 10) ? monthIndex + 3 : monthIndex - 9);
+		year = static_cast<int>(yearOfEra + era * 400) + ((month <= 2) ? 1 : 0);
+	}
+
+	// A PDF date, "D:YYYYMMDDHHmmSSOHH'mm'" with everything after the year optional, in UTC.
+	// A date without an offset is taken as UTC. Returns false if text is not a date or one
+	// FILETIME can't hold.
+	bool ToUtcTime(const char16_t* text, size_t cch, UtcTime& time)
+	{
+		size_t pos = (2 <= cch && text[0] == u'D' && text[1] == u':') ? 2 : 0;
+		int year = 0, month = 1, day = 1, hour = 0, minute = 0, second = 0;
+		if (!ReadDigits(text, cch, pos, 4, year))
+		{
+			return false;
+		}
+		if (ReadDigits(text, cch, pos, 2, month) && ReadDigits(text, cch, pos, 2, day) && ReadDigits(text, cch, pos, 2, hour)
+			&& ReadDigits(text, cch, pos, 2, minute))
+		{
+			ReadDigits(text, cch, pos, 2, second);
+		}
+		if (month < 1 || 12 < month || day < 1 || 31 < day || 23 < hour || 59 < minute || 59 < second)
+		{
+			return false;
+		}
+		int64_t days = DaysFromCivil(year, month, day);
+		int checkYear, checkMonth, checkDay;
+		CivilFromDays(days, checkYear, checkMonth, checkDay);
+		if (checkMonth != month || checkDay != day)
+		{
+			// e.g. February 30
+			return false;
+		}
+
+		int offsetMinutes = 0;
+		if (pos < cch && (text[pos] == u'+' || text[pos] == u'-'))
+		{
+			int sign = (text[pos++] == u'+') ? 1 : -1;
+			int offsetHour = 0, offsetMinute = 0;
+			if (!ReadDigits(text, cch, pos, 2, offsetHour) || 23 < offsetHour)
+			{
+				return false;
+			}
+			if (pos < cch && text[pos] == u'\'')
+			{
+				pos++;
+			}
+			ReadDigits(text, cch, pos, 2, offsetMinute);
+			if (59 < offsetMinute)
+			{
+				return false;
+			}
+			offsetMinutes = sign * (offsetHour * 60 + offsetMinute);
+		}
+
+		int64_t minutes = days * 24 * 60 + hour * 60 + minute - offsetMinutes;
+		days = (0 <= minutes) ? minutes / (24 * 60) : (minutes - (24 * 60 - 1)) / (24 * 60);
+		minutes -= days * 24 * 60;
+		CivilFromDays(days, year, month, day);
+		if (year < 1601 || 9999 < year)
+		{
+			return false;
+		}
+		time.year = year;
+		time.month = month;
+		time.day = day;
+		time.hour = static_cast<int>(minutes / 60);
+		time.minute = static_cast<int>(minutes % 60);
+		time.second = second;
+		return true;
+	}
+}
+
+CDocumentExtractor::CDocumentExtractor()
+	: m_pSource(NULL), m_fileAccess(), m_fileAvail(), m_downloadHints(), m_doc(NULL), m_avail(NULL)
+	, m_firstPage(0), m_numPages(0), m_pageIndex(0), m_cchMaxChunk(0), m_pProvider(NULL)
+	, m_propertyMask(PDFPROPERTY_ALL), m_fEmitPages(true), m_budget(), m_pageElapsed(), m_cchEmitted(0), m_truncation(TRUNCATION_NONE), m_cPagesWithoutText(0), m_cPagesWithUnicodeErrors(0)
+	, m_traceDocument(0)
+	, m_page(NULL), m_textPage(NULL), m_fPageContinued(false), m_fTagged(false), m_fStructurePage(false), m_structureTruncation(TRUNCATION_NONE)
+	, m_ichText(0), m_iLanguageChange(0), m_iProperty(0), m_iEmitState(EMITSTATE_READ_PROPERTIES)
+{
+	m_fileAvail.version = 1;
+	m_fileAvail.IsDataAvail = IsDataAvail;
+	m_fileAvail.pOwner = this;
+	m_downloadHints.version = 1;
+	m_downloadHints.AddSegment = AddSegment;
+	m_downloadHints.pOwner = this;
+}
+
+CDocumentExtractor::~CDocumentExtractor()
+{
+	Close();
+}
+
+bool CDocumentExtractor::Open(IByteSource* pSource)
+{
+	Close();
+
+	// the document budget counts from here: loading a damaged file may be the slow part
+	m_docStart = std::chrono::steady_clock::now();
+	m_cchEmitted = 0;
+	m_truncation = TRUNCATION_NONE;
+	m_cPagesWithoutText = 0;
+	m_cPagesWithUnicodeErrors = 0;
+	m_traceDocument = CTrace::IsEnabled() ? CTrace::NewDocumentId() : 0;
+	m_traceSpan.Begin(TRACEEVENT_DOCUMENT, m_traceDocument);
+	m_traceSpan.SetName(m_traceName);
+	m_traceSpan.Set(TRACEVALUE_BYTES, pSource->GetSize());
+
+	CPdfiumLock lock;
+	CPdfiumLibrary::EnsureInitialized();
+	CTraceSpan loadSpan(TRACEEVENT_LOAD_DOCUMENT, m_traceDocument);
+	loadSpan.Set(TRACEVALUE_BYTES, pSource->GetSize());
+	m_pSource = pSource;
+	if (pSource->GetData() != NULL)
+	{
+		// zero-copy: PDFium parses the memory directly
+		m_doc = FPDF_LoadMemDocument64(pSource->GetData(), static_cast<size_t>(pSource->GetSize()), NULL);
+	}
+	else if (pSource->GetSize() < 0xFFFFFFFFU)
+	{
+		m_fileAccess.m_FileLen = static_cast<unsigned long>(pSource->GetSize());
+		m_fileAccess.m_GetBlock = GetBlock;
+		m_fileAccess.m_Param = this;
+		m_doc = LoadLinearizedDocument();
+		if (m_doc == NULL)
+		{
+			m_doc = FPDF_LoadCustomDocument(&m_fileAccess, NULL);
+		}
+	}
+	// else FPDF_FILEACCESS::m_FileLen is 32-bit and PDFium has no 64-bit custom loader:
+	// such files need a source with GetData()
+
+	if (m_doc == NULL)
+	{
+		m_pSource = NULL;
+		loadSpan.End();
+		EndTrace();
+		return false;
+	}
+
+	CPdfiumLibrary::AddDocument();
+	m_numPages = FPDF_GetPageCount(m_doc);
+	m_fTagged = FPDFCatalog_IsTagged(m_doc) != 0;
+	loadSpan.Set(TRACEVALUE_PAGES, static_cast<uint64_t>(m_numPages));
+	loadSpan.Set(TRACEVALUE_FLAGS, (m_avail != NULL) ? 1 : 0);
+	if (m_firstPage < 0 || m_numPages <= m_firstPage)
+	{
+		m_firstPage = 0;
+	}
+	m_pageIndex = 0;
+	m_properties.clear();
+	m_iProperty = 0;
+	m_iEmitState = EMITSTATE_READ_PROPERTIES;
+	return true;
+}
+
+void CDocumentExtractor::Close()
+{
+	if (m_traceSpan.IsOn())
+	{
+		EndTrace();
+	}
+
+	CPdfiumLock lock;
+	ClosePage();
+	if (m_doc)
+	{
+		FPDF_CloseDocument(m_doc);
+		m_doc = NULL;
+		CPdfiumLibrary::ReleaseDocument();
+	}
+	if (m_avail)
+	{
+		FPDFAvail_Destroy(m_avail);
+		m_avail = NULL;
+	}
+	m_pSource = NULL;
+	m_firstPage = 0;
+	m_numPages = 0;
+	m_fPageContinued = false;
+	m_fTagged = false;
+	m_text.clear();
+	m_providedPage.Clear();
+	m_ichText = 0;
+	m_iLanguageChange = 0;
+	m_properties.clear();
+	m_propertyText.Clear();
+	m_iProperty = 0;
+}
+
+bool CDocumentExtractor::Step(IChunkSink& sink)
+{
+	if (m_doc == NULL)
+	{
+		return false;
+	}
+
+	switch (m_iEmitState)
+	{
+	case EMITSTATE_READ_PROPERTIES:
+		ReadProperties();
+		m_iEmitState = EMITSTATE_PROPERTIES;
+		// fall through
+
+	case EMITSTATE_PROPERTIES:
+		if (m_iProperty < m_properties.size())
+		{
+			const Property& property = m_properties[m_iProperty++];
+			m_traceSpan.Add(TRACEVALUE_CHUNKS, 1);
+			switch (property.property)
+			{
+			case PDFPROPERTY_CREATION_DATE:
+			case PDFPROPERTY_MOD_DATE:
+				sink.OnPropertyTime(property.property, property.time);
+				break;
+			case PDFPROPERTY_PAGE_COUNT:
+				sink.OnPropertyUInt32(property.property, property.number);
+				break;
+			default:
+				sink.OnProperty(property.property, m_propertyText.GetData(property.ich), property.cch);
+				break;
+			}
+			return true;
+		}
+		m_iEmitState = EMITSTATE_PAGES;
+		// fall through
+
+	case EMITSTATE_PAGES:
+		if (!m_fEmitPages || (!m_fPageContinued && m_numPages <= m_pageIndex))
+		{
+			++m_iEmitState;
+			return false;
+		}
+		if (CheckTime(false) != TRUNCATION_NONE)
+		{
+			// out of time between chunks: the remaining pages are left out
+			CPdfiumLock lock;
+			ClosePage();
+			m_fPageContinued = false;
+			m_truncation |= TRUNCATION_DOCUMENT_TIME;
+			m_iEmitState = EMITSTATE_DONE;
+			return false;
+		}
+		if (m_pProvider != NULL)
+		{
+			EmitProvidedPage(sink);
+		}
+		else
+		{
+			EmitPage(sink);
+		}
+		return true;
+	}
+
+	// if we get to here we are done with this document
+	return false;
+}
+
+bool CDocumentExtractor::ExtractPage(int pageIndex, PageText& pageText, bool& fTruncated)
+{
+	pageText.Clear();
+	fTruncated = false;
+
+	CPdfiumLock lock;
+	if (m_doc == NULL)
+	{
+		return false;
+	}
+
+	m_pageStart = std::chrono::steady_clock::now();
+	FPDF_PAGE page = LoadPage(pageIndex);
+	if (page == NULL)
+	{
+		return false;
+	}
+
+	FPDF_TEXTPAGE textPage = NULL;
+	if (HasTextObjects(page))
+	{
+		CTraceSpan span(TRACEEVENT_LOAD_TEXT_PAGE, m_traceDocument, pageIndex);
+		textPage = FPDFText_LoadPage(page);
+		if (span.IsOn() && textPage)
+		{
+			span.Set(TRACEVALUE_CHARS, static_cast<uint64_t>(FPDFText_CountChars(textPage)));
+		}
+	}
+	else
+	{
+		m_cPagesWithoutText++;
+	}
+	// the run buffers of m_extractor and m_structure are kept from page to page
+	m_extractor.Begin(textPage);
+	m_joiner.Begin();
+	CTraceSpan span(TRACEEVENT_PAGE_TEXT, m_traceDocument, pageIndex);
+	m_fStructurePage = ReadStructure(page, textPage);
+	fTruncated = m_fStructurePage && m_structureTruncation != TRUNCATION_NONE;
+	std::u16string& text = pageText.text;
+	const char* language = "";
+	CPageTextExtractor::Run run;
+	unsigned cRuns = 0;
+	while (ReadPageRun(run))
+	{
+		if (cRuns++ % BUDGET_CHECK_RUNS == 0 && CheckTime(true) != TRUNCATION_NONE)
+		{
+			fTruncated = true;
+			break;
+		}
+		const char* runLanguage = GetPageRunLanguage();
+		if (strcmp(runLanguage, language) != 0)
+		{
+			PageText::LanguageChange change;
+			change.ich = text.size();
+			memcpy(change.language, runLanguage, strlen(runLanguage) + 1);
+			pageText.languageChanges.push_back(change);
+			language = runLanguage;
+		}
+		AppendPageRun(text, run);
+	}
+	if (!fTruncated)
+	{
+		m_joiner.End(text);
+	}
+	span.Set(TRACEVALUE_CHARS, text.size());
+	span.End();
+	if (m_extractor.GetUnicodeErrorCount() != 0)
+	{
+		m_cPagesWithUnicodeErrors++;
+	}
+	m_extractor.Begin(NULL);
+	m_structure.End();
+	m_fStructurePage = false;
+	if (textPage)
+	{
+		FPDFText_ClosePage(textPage);
+	}
+	FPDF_ClosePage(page);
+	return true;
+}
+
+void CDocumentExtractor::ReadProperties()
+{
+	// the entries of the Info dictionary, in PDFPROPERTY order
+	static const struct
+	{
+		PDFPROPERTY property;
+		FPDF_BYTESTRING tag;
+	} INFO[] = {
+		{ PDFPROPERTY_TITLE, "Title" },
+		{ PDFPROPERTY_AUTHOR, "Author" },
+		{ PDFPROPERTY_SUBJECT, "Subject" },
+		{ PDFPROPERTY_KEYWORDS, "Keywords" },
+		{ PDFPROPERTY_CREATOR, "Creator" },
+		{ PDFPROPERTY_PRODUCER, "Producer" },
+		{ PDFPROPERTY_CREATION_DATE, "CreationDate" },
+		{ PDFPROPERTY_MOD_DATE, "ModDate" },
+	};
+	// labels beyond this many characters are left out
+	const size_t MAX_PAGE_LABEL_CHARS = 16 * 1024;
+
+	m_properties.clear();
+	m_propertyText.Clear();
+	m_iProperty = 0;
+
+	CPdfiumLock lock;
+	FPDF_DOCUMENT doc = m_doc;
+	for (const auto& info : INFO)
+	{
+		if ((m_propertyMask & PropertyBit(info.property)) == 0)
+		{
+			continue;
+		}
+		size_t ich = m_propertyText.GetSize();
+		FPDF_BYTESTRING tag = info.tag;
+		size_t cch = m_propertyText.AppendUtf16([doc, tag](void* pBuf, unsigned long cb) { return FPDF_GetMetaText(doc, tag, pBuf, cb); });
+		if (info.property == PDFPROPERTY_CREATION_DATE || info.property == PDFPROPERTY_MOD_DATE)
+		{
+			// the date replaces the text it was read from
+			Property entry = { info.property, 0, 0, 0, UtcTime() };
+			if (ToUtcTime(m_propertyText.GetData(ich), cch, entry.time))
+			{
+				m_properties.push_back(entry);
+			}
+			m_propertyText.Truncate(ich);
+			continue;
+		}
+		AddProperty(info.property, ich);
+	}
+
+	if (m_propertyMask & PropertyBit(PDFPROPERTY_PAGE_COUNT))
+	{
+		Property entry = { PDFPROPERTY_PAGE_COUNT, 0, 0, static_cast<uint32_t>(m_numPages), UtcTime() };
+		m_properties.push_back(entry);
+	}
+	int version;
+	if ((m_propertyMask & PropertyBit(PDFPROPERTY_VERSION)) && FPDF_GetFileVersion(m_doc, &version) && 0 < version)
+	{
+		size_t ich = m_propertyText.GetSize();
+		std::string text = std::to_string(version / 10) + "." + std::to_string(version % 10);
+		m_propertyText.AppendAscii(text.data(), text.size());
+		AddProperty(PDFPROPERTY_VERSION, ich);
+	}
+	if ((m_propertyMask & PropertyBit(PDFPROPERTY_TAGGED)) && FPDFCatalog_IsTagged(m_doc))
+	{
+		size_t ich = m_propertyText.GetSize();
+		m_propertyText.AppendAscii("1", 1);
+		AddProperty(PDFPROPERTY_TAGGED, ich);
+	}
+	if (m_propertyMask & PropertyBit(PDFPROPERTY_PAGE_LABELS))
+	{
+		// the labels come from the catalog, without loading the pages. A document with labels
+		// labels its first page.
+		size_t ich = m_propertyText.GetSize();
+		bool fNumbers = true;
+		for (int x = 0; x < m_numPages && m_propertyText.GetSize() - ich < MAX_PAGE_LABEL_CHARS; x++)
+		{
+			if (x != 0)
+			{
+				m_propertyText.AppendAscii(";", 1);
+			}
+			size_t ichLabel = m_propertyText.GetSize();
+			size_t cch = m_propertyText.AppendUtf16([doc, x](void* pBuf, unsigned long cb) { return FPDF_GetPageLabel(doc, x, pBuf, cb); });
+			if (x == 0 && cch == 0)
+			{
+				break;
+			}
+			if (fNumbers)
+			{
+				std::string number = std::to_string(x + 1);
+				const char16_t* label = m_propertyText.GetData(ichLabel);
+				fNumbers = cch == number.size() && std::equal(number.begin(), number.end(), label);
+			}
+		}
+		if (fNumbers)
+		{
+			m_propertyText.Truncate(ich);
+		}
+		AddProperty(PDFPROPERTY_PAGE_LABELS, ich);
+	}
+}
+
+void CDocumentExtractor::AddProperty(PDFPROPERTY property, size_t ich)
+{
+	// an empty value is no property
+	if (ich < m_propertyText.GetSize())
+	{
+		Property entry = { property, ich, m_propertyText.GetSize() - ich, 0, UtcTime() };
+		m_properties.push_back(entry);
+	}
+}
+
+void CDocumentExtractor::EmitPage(IChunkSink& sink)
+{
+	CPdfiumLock lock;
+
+	int pageIndex = PageIndexOf(m_pageIndex, m_firstPage);
+	if (m_page == NULL && !OpenPage())
+	{
+		// unreadable page: still one empty chunk for it
+		m_pageIndex += 1;
+		m_traceSpan.Add(TRACEVALUE_CHUNKS, 1);
+		sink.OnText(pageIndex, u"", 0, false, "");
+		return;
+	}
+	if (m_fPageContinued && m_budget.msPage != 0)
+	{
+		// the page clock resumes where the previous sub-chunk stopped it
+		m_pageStart = std::chrono::steady_clock::now() - m_pageElapsed;
+	}
+
+	m_text.clear();
+
+	CTraceSpan span(TRACEEVENT_PAGE_TEXT, m_traceDocument, pageIndex);
+	bool fPageDone = true;
+	uint32_t truncation = TRUNCATION_NONE;
+	unsigned cRuns = 0;
+	// of the first run of the chunk
+	const char* language = "";
+	CPageTextExtractor::Run run;
+	while (ReadPageRun(run))
+	{
+		const char* runLanguage = GetPageRunLanguage();
+		if (m_text.size() != 0 && ((m_cchMaxChunk != 0 && m_cchMaxChunk < m_text.size() + run.cch) || strcmp(runLanguage, language) != 0))
+		{
+			// this run starts the next sub-chunk
+			UnreadPageRun(run);
+			fPageDone = false;
+			break;
+		}
+
+		if (cRuns++ % BUDGET_CHECK_RUNS == 0 && (truncation = CheckTime(true)) != TRUNCATION_NONE)
+		{
+			break;
+		}
+
+		if (m_text.size() == 0)
+		{
+			language = runLanguage;
+		}
+		AppendPageRun(m_text, run);
+
+		if (LimitChars(m_text))
+		{
+			truncation = TRUNCATION_CHARS;
+			break;
+		}
+	}
+
+	if (fPageDone && truncation == TRUNCATION_NONE && m_fStructurePage)
+	{
+		// the page ran out of time before m_structure had read all of it
+		truncation = m_structureTruncation;
+	}
+
+	// the first sub-chunk of a page starts a new section, the following ones continue it
+	bool fContinued = m_fPageContinued;
+	m_fPageContinued = !fPageDone && truncation == TRUNCATION_NONE;
+	if (fPageDone && truncation == TRUNCATION_NONE)
+	{
+		m_joiner.End(m_text);
+	}
+	if (!m_fPageContinued)
+	{
+		if (m_extractor.GetUnicodeErrorCount() != 0)
+		{
+			m_cPagesWithUnicodeErrors++;
+		}
+		ClosePage();
+		m_pageIndex += 1;
+	}
+	else if (m_budget.msPage != 0)
+	{
+		// the host's time with this sub-chunk is not the page's
+		m_pageElapsed = std::chrono::steady_clock::now() - m_pageStart;
+	}
+
+	if (truncation == TRUNCATION_PAGE_TIME)
+	{
+		// on to the next page
+		m_truncation |= truncation;
+	}
+	else if (truncation != TRUNCATION_NONE)
+	{
+		StopEmitting(truncation);
+	}
+
+	span.Set(TRACEVALUE_CHARS, m_text.size());
+	span.End();
+
+	m_cchEmitted += m_text.size();
+	m_traceSpan.Add(TRACEVALUE_CHUNKS, 1);
+	// the languages stay valid until m_structure reads the next page
+	sink.OnText(pageIndex, m_text.data(), m_text.size(), fContinued, language);
+}
+
+// No PDFium call here: a provider may wait for threads that need CPdfiumLock.
+void CDocumentExtractor::EmitProvidedPage(IChunkSink& sink)
+{
+	if (!m_fPageContinued)
+	{
+		bool fTruncated = false;
+		if (!m_pProvider->TakePage(m_pageIndex, m_providedPage, fTruncated))
+		{
+			// the provider gave up: extract the rest inline
+			m_pProvider = NULL;
+			EmitPage(sink);
+			return;
+		}
+		if (fTruncated)
+		{
+			m_truncation |= TRUNCATION_PAGE_TIME;
+		}
+		m_ichText = 0;
+		m_iLanguageChange = 0;
+	}
+
+	// a sub-chunk ends where the language changes
+	const std::u16string& text = m_providedPage.text;
+	const std::vector<PageText::LanguageChange>& changes = m_providedPage.languageChanges;
+	while (m_iLanguageChange < changes.size() && changes[m_iLanguageChange].ich <= m_ichText)
+	{
+		m_iLanguageChange++;
+	}
+	const char* language = (m_iLanguageChange != 0) ? changes[m_iLanguageChange - 1].language : "";
+	size_t cch = ((m_iLanguageChange < changes.size()) ? changes[m_iLanguageChange].ich : text.size()) - m_ichText;
+	if (m_cchMaxChunk != 0 && m_cchMaxChunk < cch)
+	{
+		cch = m_cchMaxChunk;
+		// keep surrogate pairs in one sub-chunk
+		if (1 < cch && IsHighSurrogate(text[m_ichText + cch - 1]))
+		{
+			cch--;
+		}
+	}
+
+	bool fOutOfChars = m_budget.cchDocument != 0 && m_budget.cchDocument - m_cchEmitted < cch;
+	if (fOutOfChars)
+	{
+		cch = static_cast<size_t>(m_budget.cchDocument - m_cchEmitted);
+		if (cch != 0 && IsHighSurrogate(text[m_ichText + cch - 1]))
+		{
+			cch--;
+		}
+	}
+
+	int pageIndex = PageIndexOf(m_pageIndex, m_firstPage);
+	bool fContinued = m_fPageContinued;
+	size_t ich = m_ichText;
+	m_ichText += cch;
+	m_fPageContinued = !fOutOfChars && m_ichText < text.size();
+	if (!m_fPageContinued)
+	{
+		m_pageIndex += 1;
+	}
+	if (fOutOfChars)
+	{
+		StopEmitting(TRUNCATION_CHARS);
+	}
+
+	m_cchEmitted += cch;
+	m_traceSpan.Add(TRACEVALUE_CHUNKS, 1);
+	sink.OnText(pageIndex, text.data() + ich, cch, fContinued, language);
+}
+
+uint32_t CDocumentExtractor::CheckTime(bool fPage) const
+{
+	if (m_budget.msDocument == 0 && (!fPage || m_budget.msPage == 0))
+	{
+		return TRUNCATION_NONE;
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (m_budget.msDocument != 0 && std::chrono::milliseconds(m_budget.msDocument) <= now - m_docStart)
+	{
+		return TRUNCATION_DOCUMENT_TIME;
+	}
+	if (fPage && m_budget.msPage != 0 && std::chrono::milliseconds(m_budget.msPage) <= now - m_pageStart)
+	{
+		return TRUNCATION_PAGE_TIME;
+	}
+	return TRUNCATION_NONE;
+}
+
+bool CDocumentExtractor::LimitChars(std::u16string& text)
+{
+	if (m_budget.cchDocument == 0 || text.size() <= m_budget.cchDocument - m_cchEmitted)
+	{
+		return false;
+	}
+
+	text.resize(static_cast<size_t>(m_budget.cchDocument - m_cchEmitted));
+	if (!text.empty() && IsHighSurrogate(text.back()))
+	{
+		text.pop_back();
+	}
+	return true;
+}
+
+void CDocumentExtractor::StopEmitting(uint32_t truncation)
+{
+	m_truncation |= truncation;
+	m_iEmitState = EMITSTATE_DONE;
+}
+
+void CDocumentExtractor::EndTrace()
+{
+	m_traceSpan.Set(TRACEVALUE_PAGES, static_cast<uint64_t>(m_numPages));
+	m_traceSpan.Set(TRACEVALUE_CHARS, m_cchEmitted);
+	m_traceSpan.Set(TRACEVALUE_FLAGS, m_truncation);
+	m_traceSpan.End();
+	// a host may be killed on its next document: what was traced so far is in the file
+	CTrace::Flush();
+}
+
+int CDocumentExtractor::GetBlock(
+	void* param,
+	unsigned long position,
+	unsigned char* pBuf,
+	unsigned long size
+)
+{
+	CDocumentExtractor* pThis = static_cast<CDocumentExtractor*>(param);
+	if (!pThis->m_traceSpan.IsOn())
+	{
+		return pThis->m_pSource->Read(position, pBuf, static_cast<uint32_t>(size)) ? 1 : 0;
+	}
+
+	// the time blocked on the source, which in the filter is the host's stream
+	uint64_t usStart = CTrace::NowMicroseconds();
+	bool fRead = pThis->m_pSource->Read(position, pBuf, static_cast<uint32_t>(size));
+	pThis->m_traceSpan.Add(TRACEVALUE_BLOCK_CALLS, 1);
+	pThis->m_traceSpan.Add(TRACEVALUE_BLOCK_BYTES, size);
+	pThis->m_traceSpan.Add(TRACEVALUE_BLOCK_US, CTrace::NowMicroseconds() - usStart);
+	return fRead ? 1 : 0;
+}
+
+FPDF_PAGE CDocumentExtractor::LoadPage(int pageIndex)
+{
+	CTraceSpan span(TRACEEVENT_LOAD_PAGE, m_traceDocument, pageIndex);
+	if (m_avail)
+	{
+		// the download hints prefetch what this page needs, in as few reads as possible
+		FPDFAvail_IsPageAvail(m_avail, pageIndex, &m_downloadHints);
+	}
+
+	return FPDF_LoadPage(m_doc, pageIndex);
+}
+
+bool CDocumentExtractor::OpenPage()
+{
+	m_pageStart = std::chrono::steady_clock::now();
+	int pageIndex = PageIndexOf(m_pageIndex, m_firstPage);
+	m_page = LoadPage(pageIndex);
+	if (m_page == NULL)
+	{
+		return false;
+	}
+
+	if (HasTextObjects(m_page))
+	{
+		CTraceSpan span(TRACEEVENT_LOAD_TEXT_PAGE, m_traceDocument, pageIndex);
+		m_textPage = FPDFText_LoadPage(m_page);
+		if (span.IsOn() && m_textPage)
+		{
+			span.Set(TRACEVALUE_CHARS, static_cast<uint64_t>(FPDFText_CountChars(m_textPage)));
+		}
+	}
+	else
+	{
+		// still one empty chunk for the page
+		m_cPagesWithoutText++;
+	}
+	m_extractor.Begin(m_textPage);
+	m_joiner.Begin();
+	m_fStructurePage = ReadStructure(m_page, m_textPage);
+	m_fPageContinued = false;
+	return true;
+}
+
+void CDocumentExtractor::ClosePage()
+{
+	m_extractor.Begin(NULL);
+	m_structure.End();
+	m_fStructurePage = false;
+	if (m_textPage)
+	{
+		FPDFText_ClosePage(m_textPage);
+		m_textPage = NULL;
+	}
+	if (m_page)
+	{
+		FPDF_ClosePage(m_page);
+		m_page = NULL;
+	}
+}
+
+bool CDocumentExtractor::ReadStructure(FPDF_PAGE page, FPDF_TEXTPAGE textPage)
+{
+	m_structureTruncation = TRUNCATION_NONE;
+	if (GetLayout() != TEXTLAYOUT_STRUCTURE || !m_fTagged || !m_structure.Begin(page))
+	{
+		return false;
+	}
+
+	// the whole page first: its runs are found by their marked content
+	CPageTextExtractor::Run run;
+	unsigned cRuns = 0;
+	while (m_extractor.ReadRun(run))
+	{
+		if (cRuns++ % BUDGET_CHECK_RUNS == 0 && (m_structureTruncation = CheckTime(true)) != TRUNCATION_NONE)
+		{
+			break;
+		}
+		m_structure.AddRun(textPage, run);
+	}
+	m_structure.Order();
+	return true;
+}
+
+bool CDocumentExtractor::ReadPageRun(CPageTextExtractor::Run& run)
+{
+	return m_fStructurePage ? m_structure.ReadRun(run) : m_extractor.ReadRun(run);
+}
+
+void CDocumentExtractor::UnreadPageRun(const CPageTextExtractor::Run& run)
+{
+	if (m_fStructurePage)
+	{
+		m_structure.UnreadRun();
+	}
+	else
+	{
+		m_extractor.UnreadRun(run);
+	}
+}
+
+void CDocumentExtractor::AppendPageRun(std::u16string& text, const CPageTextExtractor::Run& run)
+{
+	if (m_fStructurePage && !m_structure.IsPlaced())
+	{
+		m_joiner.AppendBlock(text, run);
+	}
+	else
+	{
+		m_joiner.Append(text, run);
+	}
+}
+
+const char* CDocumentExtractor::GetPageRunLanguage() const
+{
+	return m_fStructurePage ? m_structure.GetLanguage() : "";
+}
+
+// The source is read synchronously through GetBlock, so every range is available.
+// FPDFAvail only uses the answer to decide how far it may parse.
+FPDF_BOOL CDocumentExtractor::IsDataAvail(
+	FX_FILEAVAIL*,
+	size_t,
+	size_t
+)
+{
+	return 1;
+}
+
+void CDocumentExtractor::AddSegment(
+	FX_DOWNLOADHINTS* pThis,
+	size_t offset,
+	size_t size
+)
+{
+	CDocumentExtractor* pOwner = static_cast<CDownloadHints*>(pThis)->pOwner;
+	pOwner->m_pSource->Prefetch(offset, size);
+}
+
+// Linearized ("fast web view") files carry the first page and the hint tables at their head.
+// FPDFAvail parses only that part here, so Open returns without reading the whole xref,
+// and the remaining pages are pulled one by one through FPDFAvail_IsPageAvail as they are emitted.
+// Returns NULL for other files, which are loaded by FPDF_LoadCustomDocument.
+FPDF_DOCUMENT CDocumentExtractor::LoadLinearizedDocument()
+{
+	m_avail = FPDFAvail_Create(&m_fileAvail, &m_fileAccess);
+	if (m_avail == NULL)
+	{
+		return NULL;
+	}
+
+	FPDF_DOCUMENT doc = NULL;
+	if (FPDFAvail_IsLinearized(m_avail) == PDF_LINEARIZED
+		&& FPDFAvail_IsDocAvail(m_avail, &m_downloadHints) == PDF_DATA_AVAIL)
+	{
+		doc = FPDFAvail_GetDocument(m_avail, NULL);
+	}
+
+	if (doc != NULL)
+	{
+		m_firstPage = FPDFAvail_GetFirstPageNum(doc);
+	}
+	else
+	{
+		FPDFAvail_Destroy(m_avail);
+		m_avail = NULL;
+	}
+	return doc;
+}
@@ -0,0 +1,377 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <fpdfview.h>
+#include <fpdf_dataavail.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ByteSource.h"
+#include "ChunkSink.h"
+#include "PageTextExtractor.h"
+#include "ScratchText.h"
+#include "StructureOrder.h"
+#include "TextLayout.h"
+#include "Trace.h"
+
+// The whole text of a page, as CDocumentExtractor::ExtractPage reads it.
+struct PageText
+{
+	// from ich on, the text is in language; the text before the first change is in ""
+	struct LanguageChange
+	{
+		size_t ich;
+		char language[MAX_LANGUAGE_CHARS + 1];
+	};
+
+	std::u16string text;
+	std::vector<LanguageChange> languageChanges;
+
+	// Forgets the text, keeping the memory.
+	void Clear()
+	{
+		text.clear();
+		languageChanges.clear();
+	}
+
+	void Swap(PageText& other)
+	{
+		text.swap(other.text);
+		languageChanges.swap(other.languageChanges);
+	}
+};
+
+// Supplies whole page text extracted elsewhere, e.g. ahead of time on other threads.
+class IPageProvider
+{
+public:
+	virtual ~IPageProvider()
+	{
+	}
+
+	// Moves the text of the page at ordinal (emission order) into page. Ordinals come in increasing order.
+	// fTruncated is set if the page ran out of its time budget (ExtractionBudget::msPage).
+	// Returns false if the page can't be provided; the extractor then reads it itself.
+	virtual bool TakePage(int ordinal, PageText& page, bool& fTruncated) = 0;
+};
+
+// Limits on the work spent on one document, so that a pathological file can't pin the host
+// until it is killed. 0 is no limit.
+//
+// Time is checked between runs: a single PDFium call (loading or laying out a page) can't be
+// interrupted and may overrun the budget.
+struct ExtractionBudget
+{
+	// wall-clock time from Open; the remaining pages are left out
+	uint32_t msDocument;
+	// wall-clock time of one page, loading included; the rest of the page is left out
+	uint32_t msPage;
+	// characters of page text; the rest of the document is left out
+	uint64_t cchDocument;
+};
+
+// What a budget cut, from CDocumentExtractor::GetTruncation
+enum TRUNCATION {
+	TRUNCATION_NONE = 0,
+	TRUNCATION_DOCUMENT_TIME = 1 << 0,
+	TRUNCATION_PAGE_TIME = 1 << 1,
+	TRUNCATION_CHARS = 1 << 2,
+};
+
+// Turns a PDF into the sequence of chunks the filter emits: the document properties, then the
+// text of every page, one call to Step() per chunk.
+//
+// Platform neutral: the bytes come from an IByteSource and the chunks go to an IChunkSink,
+// so the same code runs inside the COM filter and in the console tools on any OS.
+// Every PDFium call is made under CPdfiumLock. While CTrace is on, the document, the loads of
+// its pages and the reading of their text are traced as spans.
+class CDocumentExtractor
+{
+public:
+	// Bump when the chunks emitted for a document change, so that cached chunks
+	// (CChunkCache) from an older version are not replayed.
+	// 2: runs joined by CLayoutJoiner
+	// 3: de-hyphenation and the cleanup of CPageTextExtractor::SetCleanup
+	// 4: the properties after PDFPROPERTY_KEYWORDS
+	static const uint32_t OUTPUT_VERSION = 4;
+
+	CDocumentExtractor();
+	~CDocumentExtractor();
+
+	// pSource must outlive the document. Returns false if it is not a readable PDF.
+	bool Open(IByteSource* pSource);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_doc != NULL;
+	}
+
+	// For tools that look at the document directly. Hold CPdfiumLock if other threads use PDFium.
+	FPDF_DOCUMENT GetDocument() const
+	{
+		return m_doc;
+	}
+
+	int GetPageCount() const
+	{
+		return m_numPages;
+	}
+
+	// page emitted first: the linearized first page, which is available without the rest of the file
+	int GetFirstPage() const
+	{
+		return m_firstPage;
+	}
+
+	// Page text is emitted in chunks of about this many characters. 0 emits one chunk per page.
+	void SetMaxChunkChars(uint32_t cchMaxChunk)
+	{
+		m_cchMaxChunk = cchMaxChunk;
+	}
+
+	uint32_t GetMaxChunkChars() const
+	{
+		return m_cchMaxChunk;
+	}
+
+	// Restricts the chunks to the properties in propertyMask (PropertyBit) and, unless fPages is set,
+	// leaves out the page text. Without the text no page is loaded at all: a metadata-only pass reads
+	// little more than the trailer, the xref, the Info dictionary and the catalog.
+	// The properties are read at the first Step(), with the mask set then.
+	void SetEmitFilter(uint32_t propertyMask, bool fPages)
+	{
+		m_propertyMask = propertyMask;
+		m_fEmitPages = fPages;
+	}
+
+	bool IsEmittingPages() const
+	{
+		return m_fEmitPages;
+	}
+
+	void SetBudget(const ExtractionBudget& budget)
+	{
+		m_budget = budget;
+	}
+
+	// How the runs of a page are joined. TEXTLAYOUT_LINES by default, which also cleans the text up
+	// (CPageTextExtractor::SetCleanup); TEXTLAYOUT_NONE gives the text of OUTPUT_VERSION 1.
+	// TEXTLAYOUT_STRUCTURE reads the pages of a tagged document in the order of their structure
+	// tree, in the languages of its elements, and the others as TEXTLAYOUT_LINES.
+	// Set before the first page.
+	void SetLayout(TEXTLAYOUT layout)
+	{
+		m_joiner.SetLayout(layout);
+		m_extractor.SetCleanup(layout != TEXTLAYOUT_NONE);
+	}
+
+	TEXTLAYOUT GetLayout() const
+	{
+		return m_joiner.GetLayout();
+	}
+
+	// TRUNCATION flags of the budgets exceeded so far. The chunks emitted up to then are complete,
+	// but the document text is not.
+	uint32_t GetTruncation() const
+	{
+		return m_truncation;
+	}
+
+	// Pages found to have no text object, such as scanned images, whose text page was not built.
+	// They are emitted as empty chunks like any page without text. Counts the pages this
+	// extractor loaded, not those a page provider extracted.
+	uint32_t GetPagesWithoutText() const
+	{
+		return m_cPagesWithoutText;
+	}
+
+	// Pages with characters whose font has no usable Unicode mapping: their text is partly garbage,
+	// typically a subset font without a ToUnicode map. Counted as GetPagesWithoutText, and only with
+	// TEXTLAYOUT_LINES.
+	uint32_t GetPagesWithUnicodeErrors() const
+	{
+		return m_cPagesWithUnicodeErrors;
+	}
+
+	// Times the memory the property values are read into had to grow, over the life of the
+	// extractor. It is kept from one document to the next, and stops growing at the longest seen.
+	uint32_t GetScratchGrowthCount() const
+	{
+		return m_propertyText.GetGrowthCount();
+	}
+
+	// Names the next documents in the trace (TRACEEVENT_DOCUMENT), e.g. with their path in UTF-8.
+	void SetTraceName(const std::string& name)
+	{
+		m_traceName = name;
+	}
+
+	// Takes the page text from pProvider instead of extracting it. NULL extracts inline.
+	void SetPageProvider(IPageProvider* pProvider)
+	{
+		m_pProvider = pProvider;
+	}
+
+	// Emits the next chunk, if there is one at this step, to sink.
+	// Returns false when the document has no more chunks.
+	bool Step(IChunkSink& sink);
+
+	// Extracts the whole text of a page, within the msPage budget. Used by page providers on their own document,
+	// not mixed with Step(). fTruncated is set if the page ran out of time.
+	// page is cleared, keeping its memory: a caller that passes the same one each time allocates
+	// only when a page is longer than any before.
+	bool ExtractPage(int pageIndex, PageText& page, bool& fTruncated);
+
+	// Maps the emission ordinal of a page to its page index: the linearized first page goes first,
+	// then the others in order.
+	static int PageIndexOf(int ordinal, int firstPage)
+	{
+		return (ordinal == 0) ? firstPage : (ordinal <= firstPage) ? ordinal - 1 : ordinal;
+	}
+
+private:
+	CDocumentExtractor(const CDocumentExtractor&);
+	CDocumentExtractor& operator=(const CDocumentExtractor&);
+
+	static int GetBlock(
+		void* param,
+		unsigned long position,
+		unsigned char* pBuf,
+		unsigned long size
+	);
+
+	static FPDF_BOOL IsDataAvail(
+		FX_FILEAVAIL* pThis,
+		size_t offset,
+		size_t size
+	);
+
+	static void AddSegment(
+		FX_DOWNLOADHINTS* pThis,
+		size_t offset,
+		size_t size
+	);
+
+	FPDF_DOCUMENT LoadLinearizedDocument();
+
+	// Loads a page, pulling what it needs first when the document is linearized.
+	FPDF_PAGE LoadPage(int pageIndex);
+
+	// Loads the page at m_pageIndex and prepares its text page. Returns false if the page can't be loaded.
+	bool OpenPage();
+	void ClosePage();
+
+	// With TEXTLAYOUT_STRUCTURE, reads the runs of a page of a tagged document into m_structure in
+	// reading order, within the page budget. Returns false if the page is read in the order of its runs.
+	bool ReadStructure(FPDF_PAGE page, FPDF_TEXTPAGE textPage);
+	// The next run of the open page, from m_structure or m_extractor
+	bool ReadPageRun(CPageTextExtractor::Run& run);
+	void UnreadPageRun(const CPageTextExtractor::Run& run);
+	void AppendPageRun(std::u16string& text, const CPageTextExtractor::Run& run);
+	// language of the run read last
+	const char* GetPageRunLanguage() const;
+
+	// Reads the properties in m_propertyMask into m_properties, in one pass under the lock.
+	void ReadProperties();
+	// Adds the property whose value was appended to m_propertyText from ich, unless it is empty.
+	void AddProperty(PDFPROPERTY property, size_t ich);
+	void EmitPage(IChunkSink& sink);
+	void EmitProvidedPage(IChunkSink& sink);
+
+	// Returns the TRUNCATION flag of the time budget exceeded now, or TRUNCATION_NONE.
+	// The page budget counts only with fPage, while a page is being read.
+	uint32_t CheckTime(bool fPage) const;
+	// Cuts text, the next chunk, to what the character budget leaves. Returns true if it did.
+	bool LimitChars(std::u16string& text);
+	// Ends the document after the current chunk.
+	void StopEmitting(uint32_t truncation);
+	// Writes the span of the document.
+	void EndTrace();
+
+	struct CFileAvail : FX_FILEAVAIL {
+		CDocumentExtractor* pOwner;
+	};
+	struct CDownloadHints : FX_DOWNLOADHINTS {
+		CDocumentExtractor* pOwner;
+	};
+
+	IByteSource* m_pSource;
+	FPDF_FILEACCESS m_fileAccess;
+	CFileAvail m_fileAvail;
+	CDownloadHints m_downloadHints;
+	FPDF_DOCUMENT m_doc;
+	// non-NULL while a linearized document is loaded progressively
+	FPDF_AVAIL m_avail;
+	int m_firstPage;
+	int m_numPages;
+	int m_pageIndex;
+	uint32_t m_cchMaxChunk;
+	IPageProvider* m_pProvider;
+	uint32_t m_propertyMask;
+	bool m_fEmitPages;
+
+	ExtractionBudget m_budget;
+	std::chrono::steady_clock::time_point m_docStart;
+	std::chrono::steady_clock::time_point m_pageStart;
+	// time the current page took in its previous sub-chunks: the page clock stops while the host
+	// has the chunk, and resumes from here on the next one
+	std::chrono::steady_clock::duration m_pageElapsed;
+	// page text emitted so far
+	uint64_t m_cchEmitted;
+	uint32_t m_truncation;
+	uint32_t m_cPagesWithoutText;
+	uint32_t m_cPagesWithUnicodeErrors;
+
+	// CTrace: the document in the records, and its span from Open to Close
+	std::string m_traceName;
+	uint64_t m_traceDocument;
+	CTraceSpan m_traceSpan;
+
+	// page being emitted, kept open while its text is handed out in sub-chunks
+	FPDF_PAGE m_page;
+	FPDF_TEXTPAGE m_textPage;
+	CPageTextExtractor m_extractor;
+	CLayoutJoiner m_joiner;
+	bool m_fPageContinued;
+	// the document is tagged, and the runs of the page come from m_structure
+	bool m_fTagged;
+	bool m_fStructurePage;
+	CStructureOrder m_structure;
+	// TRUNCATION of the time budget exceeded while m_structure read the page
+	uint32_t m_structureTruncation;
+
+	// text of the chunk being built
+	std::u16string m_text;
+	// the provided page, how much of it went out and the next of its language changes
+	PageText m_providedPage;
+	size_t m_ichText;
+	size_t m_iLanguageChange;
+
+	// properties read by ReadProperties(), emitted one per step. The text values are in m_propertyText,
+	// which keeps its memory from one document to the next; the typed ones in number or time.
+	struct Property
+	{
+		PDFPROPERTY property;
+		size_t ich;
+		size_t cch;
+		uint32_t number;
+		UtcTime time;
+	};
+	std::vector<Property> m_properties;
+	CScratchText m_propertyText;
+	size_t m_iProperty;
+
+	// the properties come first, then the pages
+	enum EMITSTATE {
+		EMITSTATE_READ_PROPERTIES,
+		EMITSTATE_PROPERTIES,
+		EMITSTATE_PAGES,
+		EMITSTATE_DONE,
+	};
+	int m_iEmitState;
+};
@@ -0,0 +1,81 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "FileByteSource.h"
+
+#include <sys/types.h>
+
+CFileByteSource::CFileByteSource() : m_fp(NULL), m_cbFile(0), m_cReads(0), m_cbRead(0)
+{
+}
+
+CFileByteSource::~CFileByteSource()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool CFileByteSource::Open(const wchar_t* pszPath)
+{
+	Close();
+	FILE* fp = NULL;
+	return _wfopen_s(&fp, pszPath, L"rb") == 0 && OpenFile(fp);
+}
+#else
+bool CFileByteSource::Open(const char* pszPath)
+{
+	Close();
+	return OpenFile(fopen(pszPath, "rb"));
+}
+#endif
+
+bool CFileByteSource::OpenFile(FILE* fp)
+{
+	m_fp = fp;
+	if (m_fp == NULL || !Seek(0, SEEK_END))
+	{
+		Close();
+		return false;
+	}
+#ifdef _WIN32
+	m_cbFile = static_cast<uint64_t>(_ftelli64(m_fp));
+#else
+	m_cbFile = static_cast<uint64_t>(ftello(m_fp));
+#endif
+	return true;
+}
+
+void CFileByteSource::Close()
+{
+	if (m_fp)
+	{
+		fclose(m_fp);
+		m_fp = NULL;
+	}
+	m_cbFile = 0;
+	m_cReads = 0;
+	m_cbRead = 0;
+}
+
+bool CFileByteSource::Read(uint64_t position, uint8_t* pBuf, uint32_t size)
+{
+	++m_cReads;
+	m_cbRead += size;
+
+	return m_fp != NULL
+		&& position <= m_cbFile && size <= m_cbFile - position
+		&& Seek(position, SEEK_SET)
+		&& fread(pBuf, 1, size, m_fp) == size;
+}
+
+bool CFileByteSource::Seek(uint64_t position, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(m_fp, static_cast<__int64>(position), origin) == 0;
+#else
+	return fseeko(m_fp, static_cast<off_t>(position), origin) == 0;
+#endif
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstdio>
+
+#include "ByteSource.h"
+
+// A file read through stdio, one seek and read per request, as the filter reads its IStream.
+// Used by the console tools.
+class CFileByteSource : public IByteSource
+{
+public:
+	CFileByteSource();
+	~CFileByteSource();
+
+	// Takes the native path type of the platform (std::filesystem::path::c_str()).
+#ifdef _WIN32
+	bool Open(const wchar_t* pszPath);
+#else
+	bool Open(const char* pszPath);
+#endif
+	void Close();
+
+	uint64_t GetSize() const override
+	{
+		return m_cbFile;
+	}
+
+	bool Read(uint64_t position, uint8_t* pBuf, uint32_t size) override;
+
+	// Read() calls and bytes requested, i.e. the FPDF_FILEACCESS::m_GetBlock traffic
+	uint64_t GetReadCount() const
+	{
+		return m_cReads;
+	}
+
+	uint64_t GetReadBytes() const
+	{
+		return m_cbRead;
+	}
+
+private:
+	CFileByteSource(const CFileByteSource&);
+	CFileByteSource& operator=(const CFileByteSource&);
+
+	bool OpenFile(FILE* fp);
+	bool Seek(uint64_t position, int origin);
+
+	FILE* m_fp;
+	uint64_t m_cbFile;
+	uint64_t m_cReads;
+	uint64_t m_cbRead;
+};
@@ -0,0 +1,176 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "PageTextExtractor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const char16_t SOFT_HYPHEN = 0x00AD;
+	// what PDFium leaves of a hyphen that ends a line
+	const char16_t LINE_END_HYPHEN = 0x0002;
+	const char16_t HYPHEN = 0x2010;
+}
+
+bool DblRect::SeemsToContinue(const DblRect& prev) const
+{
+	double h = t - b;
+	double sharedHeight = std::fmin(t, prev.t) - std::fmax(b, prev.b);
+	return true
+		&& (prev.r <= l && l < prev.r + h / 2)
+		&& h * 0.5 <= sharedHeight
+		;
+}
+
+CPageTextExtractor::CPageTextExtractor() : m_textPage(NULL), m_fCleanup(false), m_numChars(0), m_next(0), m_fSoftHyphen(false), m_cUnicodeErrors(0), m_cUnicodeErrorsBefore(0), m_fHavePrevRect(false), m_prevRect(), m_fHadPrevRect(false), m_prevPrevRect()
+{
+}
+
+void CPageTextExtractor::Begin(FPDF_TEXTPAGE textPage)
+{
+	m_textPage = textPage;
+	m_numChars = (textPage != NULL) ? FPDFText_CountChars(textPage) : 0;
+	if (m_numChars < 0)
+	{
+		m_numChars = 0;
+	}
+	m_next = 0;
+	m_runText.clear();
+	m_cUnicodeErrors = 0;
+	m_fHavePrevRect = false;
+	m_fHadPrevRect = false;
+}
+
+bool CPageTextExtractor::ReadRun(Run& run)
+{
+	m_runText.clear();
+	m_fSoftHyphen = false;
+	m_cUnicodeErrorsBefore = m_cUnicodeErrors;
+
+	// skip what lies between rectangles
+	DblRect box;
+	int x = m_next;
+	while (x < m_numChars && !IsRunChar(x, box))
+	{
+		x++;
+	}
+	if (m_numChars <= x)
+	{
+		m_next = x;
+		return false;
+	}
+
+	FPDF_PAGEOBJECT textObject = FPDFText_GetTextObject(m_textPage, x);
+	run.first = x;
+	run.rect = box;
+	AppendChar(x, true);
+	x++;
+
+	while (x < m_numChars)
+	{
+		int y = x;
+		while (y < m_numChars && !IsRunChar(y, box))
+		{
+			y++;
+		}
+		if (m_numChars <= y || FPDFText_GetTextObject(m_textPage, y) != textObject)
+		{
+			break;
+		}
+
+		// characters inside the run without extent (e.g. spaces PDFium generated for wide kerning) belong to it
+		for (; x < y; x++)
+		{
+			AppendChar(x, false);
+		}
+		AppendChar(y, true);
+		x++;
+
+		run.rect.l = std::fmin(run.rect.l, box.l);
+		run.rect.t = std::fmax(run.rect.t, box.t);
+		run.rect.r = std::fmax(run.rect.r, box.r);
+		run.rect.b = std::fmin(run.rect.b, box.b);
+	}
+
+	m_next = x;
+	run.hyphenated = false;
+	if (m_fCleanup)
+	{
+		CleanUpRun(run);
+	}
+	run.text = m_runText.data();
+	run.cch = m_runText.size();
+	run.continuous = m_fHavePrevRect && run.rect.SeemsToContinue(m_prevRect);
+
+	m_fHadPrevRect = m_fHavePrevRect;
+	m_prevPrevRect = m_prevRect;
+	m_fHavePrevRect = true;
+	m_prevRect = run.rect;
+	return true;
+}
+
+bool CPageTextExtractor::IsRunChar(int index, DblRect& box) const
+{
+	if (FPDFText_IsGenerated(m_textPage, index) == 1)
+	{
+		return false;
+	}
+
+	if (!FPDFText_GetCharBox(m_textPage, index, &box.l, &box.r, &box.b, &box.t))
+	{
+		return false;
+	}
+
+	// same threshold as FPDFText_GetRect
+	return 0.01 <= std::fabs(box.r - box.l) && 0.01 <= std::fabs(box.t - box.b);
+}
+
+void CPageTextExtractor::AppendChar(int index, bool fRunChar)
+{
+	unsigned int unicode = FPDFText_GetUnicode(m_textPage, index);
+	if (m_fCleanup)
+	{
+		if (fRunChar)
+		{
+			if (FPDFText_HasUnicodeMapError(m_textPage, index) == 1)
+			{
+				m_cUnicodeErrors++;
+			}
+			m_fSoftHyphen |= unicode == SOFT_HYPHEN;
+		}
+		else if (unicode == u'\r' && FPDFText_IsGenerated(m_textPage, index) == 1)
+		{
+			// PDFium marks a line break inside a text object with a generated CR LF
+			return;
+		}
+	}
+
+	if (0x10000 <= unicode && unicode <= 0x10FFFF)
+	{
+		unicode -= 0x10000;
+		m_runText.push_back(static_cast<char16_t>(0xD800 + (unicode >> 10)));
+		m_runText.push_back(static_cast<char16_t>(0xDC00 + (unicode & 0x3FF)));
+	}
+	else if (unicode != 0)
+	{
+		m_runText.push_back(static_cast<char16_t>(unicode));
+	}
+}
+
+void CPageTextExtractor::CleanUpRun(Run& run)
+{
+	// the last character read is m_next - 1
+	char16_t last = m_runText.empty() ? 0 : m_runText.back();
+	if ((last == LINE_END_HYPHEN || last == u'-' || last == SOFT_HYPHEN || last == HYPHEN) && FPDFText_IsHyphen(m_textPage, m_next - 1) == 1)
+	{
+		m_runText.pop_back();
+		run.hyphenated = true;
+	}
+
+	// a soft hyphen inside a line is not printed and only splits the word for the indexer
+	if (m_fSoftHyphen)
+	{
+		m_runText.erase(std::remove(m_runText.begin(), m_runText.end(), SOFT_HYPHEN), m_runText.end());
+	}
+}
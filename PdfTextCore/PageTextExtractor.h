@@ -0,0 +1,107 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <fpdfview.h>
+#include <fpdf_text.h>
+
+#include <string>
+
+struct DblRect {
+	// left
+	double l;
+	// top (PDF coord, up is plus)
+	double t;
+	// right
+	double r;
+	// bottom (PDF coord, up is plus)
+	double b;
+
+	bool SeemsToContinue(const DblRect& prev) const;
+};
+
+// Extracts the text of a page as runs, in a single pass over its characters.
+//
+// A run is what FPDFText_GetRect reports as one rectangle: consecutive characters of the same
+// text object, ignoring generated characters and characters without extent between them.
+// Formerly the text of each rectangle was fetched by FPDFText_GetBoundedText, which rescans
+// every character of the page per rectangle (O(rects x chars)) and was cut at a fixed buffer size.
+// Here the run text is collected while the characters are walked, with no length limit.
+//
+// With SetCleanup, the same walk also tidies the text for the indexer: a hyphen PDFium found at
+// a line break is taken off its run (Run::hyphenated), soft hyphens inside a line are dropped,
+// a line break PDFium generated inside a text object becomes a single LF, and characters whose
+// font has no usable Unicode mapping are counted.
+class CPageTextExtractor
+{
+public:
+	struct Run
+	{
+		// index of the first character in the text page
+		int first;
+		// union of the character boxes
+		DblRect rect;
+		// the run seems to continue the previous one on the same line
+		bool continuous;
+		// with SetCleanup: the run ended with a line break hyphen, which is not in text
+		bool hyphenated;
+		// run text in UTF-16, valid until the next ReadRun()
+		const char16_t* text;
+		size_t cch;
+	};
+
+	CPageTextExtractor();
+
+	// Off by default, which gives the text FPDFText_GetBoundedText would.
+	void SetCleanup(bool fCleanup)
+	{
+		m_fCleanup = fCleanup;
+	}
+
+	// textPage stays owned by the caller and must outlive the extraction.
+	void Begin(FPDF_TEXTPAGE textPage);
+
+	// With SetCleanup: characters read since Begin() without a Unicode mapping
+	// (FPDFText_HasUnicodeMapError), which reach the text as garbage.
+	unsigned GetUnicodeErrorCount() const
+	{
+		return m_cUnicodeErrors;
+	}
+
+	// Reads the next run. Returns false at the end of the page.
+	bool ReadRun(Run& run);
+
+	// Makes the next ReadRun() return run again.
+	void UnreadRun(const Run& run)
+	{
+		m_next = run.first;
+		m_cUnicodeErrors = m_cUnicodeErrorsBefore;
+		m_fHavePrevRect = m_fHadPrevRect;
+		m_prevRect = m_prevPrevRect;
+	}
+
+private:
+	// true for the characters FPDFText_GetRect builds rectangles of
+	bool IsRunChar(int index, DblRect& box) const;
+	// fRunChar is the result of IsRunChar: the other characters may be generated
+	void AppendChar(int index, bool fRunChar);
+	// With SetCleanup: takes a line break hyphen off the end of the run and drops soft hyphens.
+	void CleanUpRun(Run& run);
+
+	FPDF_TEXTPAGE m_textPage;
+	bool m_fCleanup;
+	int m_numChars;
+	int m_next;
+	std::u16string m_runText;
+	// the run text has a soft hyphen
+	bool m_fSoftHyphen;
+	unsigned m_cUnicodeErrors;
+	// before the last run read, for UnreadRun()
+	unsigned m_cUnicodeErrorsBefore;
+
+	// rectangle of the last run read, and the one before it for UnreadRun()
+	bool m_fHavePrevRect;
+	DblRect m_prevRect;
+	bool m_fHadPrevRect;
+	DblRect m_prevPrevRect;
+};
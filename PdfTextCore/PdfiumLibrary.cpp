@@ -0,0 +1,85 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "PdfiumLibrary.h"
+#include "PdfiumLock.h"
+
+#include <fpdfview.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+	// guarded by CPdfiumLock
+	bool s_fInitialized = false;
+	uint32_t s_cDocuments = 0;
+
+	// read without the lock, for instrumentation
+	std::atomic<uint64_t> s_usInit(0);
+	std::atomic<uint32_t> s_cInits(0);
+}
+
+bool CPdfiumLibrary::Initialize()
+{
+	CPdfiumLock lock;
+	return EnsureInitialized();
+}
+
+bool CPdfiumLibrary::EnsureInitialized()
+{
+	if (s_fInitialized)
+	{
+		return false;
+	}
+
+	// [PDFium - Getting Started with PDFium](https://pdfium.googlesource.com/pdfium/+/HEAD/docs/getting-started.md)
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	FPDF_LIBRARY_CONFIG config;
+	config.version = 2;
+	config.m_pUserFontPaths = NULL;
+	config.m_pIsolate = NULL;
+	config.m_v8EmbedderSlot = 0;
+
+	FPDF_InitLibraryWithConfig(&config);
+
+	s_usInit = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	s_cInits++;
+	s_fInitialized = true;
+	return true;
+}
+
+void CPdfiumLibrary::AddDocument()
+{
+	s_cDocuments++;
+}
+
+void CPdfiumLibrary::ReleaseDocument()
+{
+	s_cDocuments--;
+}
+
+bool CPdfiumLibrary::Shutdown()
+{
+	CPdfiumLock lock;
+	if (s_cDocuments != 0)
+	{
+		return false;
+	}
+	if (s_fInitialized)
+	{
+		FPDF_DestroyLibrary();
+		s_fInitialized = false;
+	}
+	return true;
+}
+
+uint64_t CPdfiumLibrary::GetInitMicroseconds()
+{
+	return s_usInit;
+}
+
+uint32_t CPdfiumLibrary::GetInitCount()
+{
+	return s_cInits;
+}
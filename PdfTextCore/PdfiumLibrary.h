@@ -0,0 +1,32 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstdint>
+
+// FPDF_InitLibraryWithConfig and FPDF_DestroyLibrary, once per process and on demand.
+//
+// Loading the module costs nothing: PDFium starts when the first document needs it, not under
+// the loader lock, and only in processes that actually filter. CDocumentExtractor::Open calls
+// EnsureInitialized itself. The open documents keep the library alive; Shutdown() tears it down
+// when there are none, and the next document starts it again.
+class CPdfiumLibrary
+{
+public:
+	// Initializes PDFium if it is not. Takes CPdfiumLock. Returns true if this call initialized it.
+	static bool Initialize();
+
+	// Same, with CPdfiumLock already held.
+	static bool EnsureInitialized();
+
+	// Counts the documents open. With CPdfiumLock held.
+	static void AddDocument();
+	static void ReleaseDocument();
+
+	// Destroys PDFium unless a document is open. Takes CPdfiumLock. Returns false if a document is open.
+	static bool Shutdown();
+
+	// Duration of the last initialization in microseconds, and how many there were
+	static uint64_t GetInitMicroseconds();
+	static uint32_t GetInitCount();
+};
@@ -0,0 +1,30 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <mutex>
+
+// Process-wide lock around PDFium.
+//
+// PDFium keeps global state (font cache, page object caches, ...) and is not thread-safe,
+// not even for calls on different documents. Every sequence of PDFium calls that may run
+// concurrently with another thread's must hold it. The lock is not recursive.
+class CPdfiumLock
+{
+public:
+	CPdfiumLock() : m_guard(Get())
+	{
+	}
+
+private:
+	CPdfiumLock(const CPdfiumLock&);
+	CPdfiumLock& operator=(const CPdfiumLock&);
+
+	static std::mutex& Get()
+	{
+		static std::mutex s_mutex;
+		return s_mutex;
+	}
+
+	std::lock_guard<std::mutex> m_guard;
+};
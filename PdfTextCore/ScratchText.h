@@ -0,0 +1,98 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// UTF-16 text of PDFium calls that tell the size they need, kept by an instance across pages and
+// documents.
+//
+// Pieces are appended one after another and found again by their offset. The memory grows
+// geometrically and Clear() keeps it, so once the text has grown to the largest seen, the calls
+// allocate nothing; nothing is ever cut to fit a buffer.
+class CScratchText
+{
+public:
+	CScratchText() : m_cGrowths(0)
+	{
+	}
+
+	// Forgets the text, keeping the memory.
+	void Clear()
+	{
+		m_text.clear();
+	}
+
+	size_t GetSize() const
+	{
+		return m_text.size();
+	}
+
+	// Valid until the next Extend().
+	const char16_t* GetData(size_t ich) const
+	{
+		return m_text.data() + ich;
+	}
+
+	// Appends cch characters for the caller to fill in, and returns the first.
+	char16_t* Extend(size_t cch)
+	{
+		size_t ich = m_text.size();
+		if (m_text.capacity() < ich + cch)
+		{
+			m_text.reserve((ich + cch < m_text.capacity() * 2) ? m_text.capacity() * 2 : ich + cch);
+			m_cGrowths++;
+		}
+		m_text.resize(ich + cch);
+		return &m_text[ich];
+	}
+
+	// Cuts the text back to cch characters, e.g. what a call did not fill in.
+	void Truncate(size_t cch)
+	{
+		if (cch < m_text.size())
+		{
+			m_text.resize(cch);
+		}
+	}
+
+	// Appends text PDFium fills in after telling its size in bytes, terminator included: get(NULL, 0)
+	// tells the size and get(pBuf, cb) fills it. Returns the characters appended, up to the terminator.
+	template<typename Get>
+	size_t AppendUtf16(Get get)
+	{
+		unsigned long cb = get(static_cast<void*>(NULL), 0UL);
+		if (cb <= sizeof(char16_t))
+		{
+			return 0;
+		}
+		size_t ich = m_text.size();
+		char16_t* p = Extend(cb / sizeof(char16_t));
+		get(static_cast<void*>(p), cb);
+		size_t cch = m_text.find(u'\0', ich);
+		cch = ((cch == std::u16string::npos) ? m_text.size() : cch) - ich;
+		Truncate(ich + cch);
+		return cch;
+	}
+
+	// Appends ASCII text.
+	void AppendAscii(const char* text, size_t cch)
+	{
+		char16_t* p = Extend(cch);
+		for (size_t x = 0; x < cch; x++)
+		{
+			p[x] = static_cast<unsigned char>(text[x]);
+		}
+	}
+
+	// times the memory had to grow
+	uint32_t GetGrowthCount() const
+	{
+		return m_cGrowths;
+	}
+
+private:
+	std::u16string m_text;
+	uint32_t m_cGrowths;
+};
@@ -0,0 +1,276 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "StructureOrder.h"
+#include "ChunkSink.h"
+
+#include <fpdf_edit.h>
+#include <fpdf_structtree.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// elements nested deeper than this are left out: the tree of a damaged file may not end
+	const int MAX_DEPTH = 256;
+
+	bool IsLanguageChar(char16_t ch)
+	{
+		return (u'a' <= ch && ch <= u'z') || (u'A' <= ch && ch <= u'Z') || (u'0' <= ch && ch <= u'9') || ch == u'-';
+	}
+
+	void AddRect(DblRect& rect, bool fFirst, const DblRect& add)
+	{
+		if (fFirst)
+		{
+			rect = add;
+			return;
+		}
+		rect.l = std::fmin(rect.l, add.l);
+		rect.t = std::fmax(rect.t, add.t);
+		rect.r = std::fmax(rect.r, add.r);
+		rect.b = std::fmin(rect.b, add.b);
+	}
+}
+
+CStructureOrder::CStructureOrder() : m_tree(NULL), m_iNext(0), m_languages(1, '\0')
+{
+}
+
+CStructureOrder::~CStructureOrder()
+{
+	End();
+}
+
+bool CStructureOrder::Begin(FPDF_PAGE page)
+{
+	End();
+	m_runs.clear();
+	m_byMcid.clear();
+	m_pieces.clear();
+	m_iNext = 0;
+	m_text.Clear();
+	m_languages.resize(1);
+
+	m_tree = FPDF_StructTree_GetForPage(page);
+	if (m_tree != NULL && FPDF_StructTree_CountChildren(m_tree) <= 0)
+	{
+		End();
+	}
+	return m_tree != NULL;
+}
+
+void CStructureOrder::AddRun(FPDF_TEXTPAGE textPage, const CPageTextExtractor::Run& run)
+{
+	// the runs of a text object share its marked content
+	PageRun pageRun;
+	pageRun.mcid = FPDFPageObj_GetMarkedContentID(FPDFText_GetTextObject(textPage, run.first));
+	pageRun.fClaimed = false;
+	pageRun.hyphenated = run.hyphenated;
+	pageRun.rect = run.rect;
+	pageRun.ich = m_text.GetSize();
+	pageRun.cch = run.cch;
+	std::copy(run.text, run.text + run.cch, m_text.Extend(run.cch));
+	m_runs.push_back(pageRun);
+}
+
+void CStructureOrder::Order()
+{
+	m_byMcid.resize(m_runs.size());
+	for (size_t x = 0; x < m_runs.size(); x++)
+	{
+		m_byMcid[x] = x;
+	}
+	std::stable_sort(m_byMcid.begin(), m_byMcid.end(), [this](size_t a, size_t b) { return m_runs[a].mcid < m_runs[b].mcid; });
+
+	int cElements = FPDF_StructTree_CountChildren(m_tree);
+	for (int x = 0; x < cElements; x++)
+	{
+		FPDF_STRUCTELEMENT element = FPDF_StructTree_GetChildAtIndex(m_tree, x);
+		if (element != NULL)
+		{
+			AddElement(element, 0, 0);
+		}
+	}
+	FPDF_StructTree_Close(m_tree);
+	m_tree = NULL;
+
+	// what no element claimed, e.g. artifacts
+	for (const PageRun& pageRun : m_runs)
+	{
+		if (!pageRun.fClaimed)
+		{
+			Piece piece = { true, pageRun.hyphenated, pageRun.rect, pageRun.ich, pageRun.cch, 0 };
+			m_pieces.push_back(piece);
+		}
+	}
+	m_iNext = 0;
+}
+
+bool CStructureOrder::ReadRun(CPageTextExtractor::Run& run)
+{
+	if (m_pieces.size() <= m_iNext)
+	{
+		return false;
+	}
+
+	const Piece& piece = m_pieces[m_iNext];
+	run.first = 0;
+	run.rect = piece.rect;
+	run.continuous = piece.fPlaced && 0 < m_iNext && m_pieces[m_iNext - 1].fPlaced && piece.rect.SeemsToContinue(m_pieces[m_iNext - 1].rect);
+	run.hyphenated = piece.hyphenated;
+	run.text = m_text.GetData(piece.ich);
+	run.cch = piece.cch;
+	m_iNext++;
+	return true;
+}
+
+void CStructureOrder::End()
+{
+	if (m_tree != NULL)
+	{
+		FPDF_StructTree_Close(m_tree);
+		m_tree = NULL;
+	}
+}
+
+void CStructureOrder::AddElement(FPDF_STRUCTELEMENT element, size_t ichLanguage, int depth)
+{
+	if (MAX_DEPTH < depth)
+	{
+		return;
+	}
+	ichLanguage = ReadLanguage(element, ichLanguage);
+
+	size_t ich = m_text.GetSize();
+	size_t cch = m_text.AppendUtf16([element](void* pBuf, unsigned long cb) { return FPDF_StructElement_GetActualText(element, pBuf, cb); });
+	if (cch != 0)
+	{
+		// the text stands where the content it replaces was drawn
+		Piece piece = { false, false, DblRect(), ich, cch, ichLanguage };
+		piece.fPlaced = ClaimContent(element, piece.rect, depth);
+		m_pieces.push_back(piece);
+		return;
+	}
+
+	size_t cPieces = m_pieces.size();
+	int cKids = FPDF_StructElement_CountChildren(element);
+	for (int x = 0; x < cKids; x++)
+	{
+		FPDF_STRUCTELEMENT kid = FPDF_StructElement_GetChildAtIndex(element, x);
+		if (kid != NULL)
+		{
+			AddElement(kid, ichLanguage, depth + 1);
+		}
+		else
+		{
+			// marked content on this page, or an object reference (-1), such as an annotation
+			AddContent(FPDF_StructElement_GetChildMarkedContentID(element, x), ichLanguage);
+		}
+	}
+
+	if (m_pieces.size() == cPieces)
+	{
+		// nothing to read: a figure, or a formula drawn with paths
+		ich = m_text.GetSize();
+		cch = m_text.AppendUtf16([element](void* pBuf, unsigned long cb) { return FPDF_StructElement_GetAltText(element, pBuf, cb); });
+		if (cch != 0)
+		{
+			Piece piece = { false, false, DblRect(), ich, cch, ichLanguage };
+			m_pieces.push_back(piece);
+		}
+	}
+}
+
+void CStructureOrder::AddContent(int mcid, size_t ichLanguage)
+{
+	if (mcid < 0)
+	{
+		return;
+	}
+	std::pair<size_t, size_t> range = FindContent(mcid);
+	for (size_t x = range.first; x < range.second; x++)
+	{
+		PageRun& pageRun = m_runs[m_byMcid[x]];
+		if (!pageRun.fClaimed)
+		{
+			pageRun.fClaimed = true;
+			Piece piece = { true, pageRun.hyphenated, pageRun.rect, pageRun.ich, pageRun.cch, ichLanguage };
+			m_pieces.push_back(piece);
+		}
+	}
+}
+
+bool CStructureOrder::ClaimContent(FPDF_STRUCTELEMENT element, DblRect& rect, int depth)
+{
+	bool fAny = false;
+	int cKids = (depth <= MAX_DEPTH) ? FPDF_StructElement_CountChildren(element) : 0;
+	for (int x = 0; x < cKids; x++)
+	{
+		FPDF_STRUCTELEMENT kid = FPDF_StructElement_GetChildAtIndex(element, x);
+		if (kid != NULL)
+		{
+			DblRect kidRect;
+			if (ClaimContent(kid, kidRect, depth + 1))
+			{
+				AddRect(rect, !fAny, kidRect);
+				fAny = true;
+			}
+			continue;
+		}
+
+		int mcid = FPDF_StructElement_GetChildMarkedContentID(element, x);
+		std::pair<size_t, size_t> range = (0 <= mcid) ? FindContent(mcid) : std::pair<size_t, size_t>(0, 0);
+		for (size_t y = range.first; y < range.second; y++)
+		{
+			PageRun& pageRun = m_runs[m_byMcid[y]];
+			if (!pageRun.fClaimed)
+			{
+				pageRun.fClaimed = true;
+				AddRect(rect, !fAny, pageRun.rect);
+				fAny = true;
+			}
+		}
+	}
+	return fAny;
+}
+
+size_t CStructureOrder::ReadLanguage(FPDF_STRUCTELEMENT element, size_t ichLanguage)
+{
+	size_t ich = m_text.GetSize();
+	size_t cch = m_text.AppendUtf16([element](void* pBuf, unsigned long cb) { return FPDF_StructElement_GetLang(element, pBuf, cb); });
+	const char16_t* lang = m_text.GetData(ich);
+	bool fUsable = 0 < cch && cch <= MAX_LANGUAGE_CHARS && std::all_of(lang, lang + cch, IsLanguageChar);
+	std::string tag(1, '\0');
+	if (fUsable)
+	{
+		for (size_t x = 0; x < cch; x++)
+		{
+			tag += static_cast<char>(lang[x]);
+		}
+		tag += '\0';
+	}
+	m_text.Truncate(ich);
+	if (!fUsable)
+	{
+		return ichLanguage;
+	}
+
+	// most elements repeat the Lang of the document
+	size_t pos = m_languages.find(tag);
+	if (pos == std::string::npos)
+	{
+		pos = m_languages.size() - 1;
+		m_languages.append(tag, 1, std::string::npos);
+	}
+	return pos + 1;
+}
+
+std::pair<size_t, size_t> CStructureOrder::FindContent(int mcid) const
+{
+	std::vector<size_t>::const_iterator first = std::lower_bound(m_byMcid.begin(), m_byMcid.end(), mcid,
+		[this](size_t x, int value) { return m_runs[x].mcid < value; });
+	std::vector<size_t>::const_iterator last = std::upper_bound(first, m_byMcid.end(), mcid,
+		[this](int value, size_t x) { return value < m_runs[x].mcid; });
+	return std::pair<size_t, size_t>(first - m_byMcid.begin(), last - m_byMcid.begin());
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <fpdfview.h>
+
+#include <string>
+#include <vector>
+
+#include "PageTextExtractor.h"
+#include "ScratchText.h"
+
+// Orders the runs of a page of a tagged PDF by its structure tree (TEXTLAYOUT_STRUCTURE).
+//
+// The runs of the whole page are read first (AddRun) and found again by the marked content ID of
+// their text object. Order() then walks the elements depth first, as a screen reader reads them:
+// the content of an element comes in the order of its kids, whatever order the content stream
+// draws it in. An element with ActualText gives that text in place of its content, in the place
+// of its runs; one without any text content, such as a figure, gives its Alt text instead, as a
+// block of its own. Each run carries the Lang of its element, inherited from the elements above.
+// Runs that no element claims, such as artifacts (running heads, page numbers), come last in their
+// order on the page, in no language.
+//
+// Cheaper than it looks: the walk visits each element once and PDFium builds the tree of the
+// page only, from the parent tree. The memory of the runs is kept from page to page.
+class CStructureOrder
+{
+public:
+	CStructureOrder();
+	~CStructureOrder();
+
+	// Loads the structure tree of page. Returns false if it has none, or an empty one: the page is
+	// then read in the order of its runs. page stays owned by the caller.
+	bool Begin(FPDF_PAGE page);
+
+	// Takes run, read from textPage by a CPageTextExtractor, into the page.
+	void AddRun(FPDF_TEXTPAGE textPage, const CPageTextExtractor::Run& run);
+
+	// Orders the runs added since Begin() and releases the tree.
+	void Order();
+
+	// Reads the next run in reading order. Returns false at the end of the page.
+	// Run::continuous is relative to the run read before.
+	bool ReadRun(CPageTextExtractor::Run& run);
+
+	// Makes the next ReadRun() return the last run read again.
+	void UnreadRun()
+	{
+		m_iNext--;
+	}
+
+	// Language of the last run read, valid until the next Begin().
+	const char* GetLanguage() const
+	{
+		return m_languages.c_str() + m_pieces[m_iNext - 1].ichLanguage;
+	}
+
+	// false if the last run read has no place on the page: the Alt text of an element without text
+	// content, a block of its own (CLayoutJoiner::AppendBlock).
+	bool IsPlaced() const
+	{
+		return m_pieces[m_iNext - 1].fPlaced;
+	}
+
+	// Releases the tree if Order() was not called. The runs read stay valid until the next Begin().
+	void End();
+
+private:
+	CStructureOrder(const CStructureOrder&);
+	CStructureOrder& operator=(const CStructureOrder&);
+
+	// a run as added, its text in m_text
+	struct PageRun
+	{
+		int mcid;
+		bool fClaimed;
+		bool hyphenated;
+		DblRect rect;
+		size_t ich;
+		size_t cch;
+	};
+
+	// a run in reading order: a page run, ActualText or Alt text
+	struct Piece
+	{
+		bool fPlaced;
+		bool hyphenated;
+		DblRect rect;
+		size_t ich;
+		size_t cch;
+		// of the NUL terminated tag in m_languages
+		size_t ichLanguage;
+	};
+
+	// Adds the pieces of element and the elements below it.
+	void AddElement(FPDF_STRUCTELEMENT element, size_t ichLanguage, int depth);
+	// Adds the runs of the marked content mcid not claimed yet.
+	void AddContent(int mcid, size_t ichLanguage);
+	// Claims the runs of element and the elements below it for its ActualText, and gives it their
+	// place. Returns whether there were any.
+	bool ClaimContent(FPDF_STRUCTELEMENT element, DblRect& rect, int depth);
+	// Returns the tag of the Lang of element in m_languages, or ichLanguage if it has none usable.
+	size_t ReadLanguage(FPDF_STRUCTELEMENT element, size_t ichLanguage);
+	// indexes in m_byMcid of the runs of mcid
+	std::pair<size_t, size_t> FindContent(int mcid) const;
+
+	FPDF_STRUCTTREE m_tree;
+	std::vector<PageRun> m_runs;
+	// indexes of m_runs by marked content ID, then by order on the page
+	std::vector<size_t> m_byMcid;
+	std::vector<Piece> m_pieces;
+	size_t m_iNext;
+	// text of the runs and of the replacements
+	CScratchText m_text;
+	// the language tags, each NUL terminated; "" at 0
+	std::string m_languages;
+};
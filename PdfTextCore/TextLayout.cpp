@@ -0,0 +1,185 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "TextLayout.h"
+
+#include <cmath>
+
+namespace
+{
+	// Kana, CJK ideographs and punctuation, and the full and half width forms: scripts written
+	// without spaces between words. Hangul is written with spaces and is not among them.
+	bool IsUnspacedChar(char16_t ch)
+	{
+		return (0x2E80 <= ch && ch <= 0x2FDF)		// CJK radicals
+			|| (0x3000 <= ch && ch <= 0x30FF)		// CJK punctuation, hiragana, katakana
+			|| (0x3190 <= ch && ch <= 0x31FF)		// kanbun, CJK strokes, katakana extensions
+			|| (0x3400 <= ch && ch <= 0x4DBF)		// CJK extension A
+			|| (0x4E00 <= ch && ch <= 0x9FFF)		// CJK unified ideographs
+			|| (0xF900 <= ch && ch <= 0xFAFF)		// CJK compatibility ideographs
+			|| (0xFE30 <= ch && ch <= 0xFE4F)		// CJK compatibility forms
+			|| (0xFF00 <= ch && ch <= 0xFFEF);		// full and half width forms
+	}
+
+	// The supplementary ideographic plane (U+20000-U+2FFFF) as a surrogate pair.
+	bool IsUnspacedPair(char16_t high)
+	{
+		return 0xD840 <= high && high <= 0xD87F;
+	}
+
+	bool IsSpace(char16_t ch)
+	{
+		return ch == u' ' || ch == u'\t' || ch == u'\r' || ch == u'\n' || ch == 0x3000;
+	}
+
+	// The rectangle of a run, with a height. Fonts without metrics (a non-embedded CID font, as in
+	// Samples/サンプル.pdf) give boxes of no height at the baseline: the average character width
+	// stands in for it.
+	DblRect GetLayoutRect(const DblRect& rect, size_t cch)
+	{
+		DblRect layout = rect;
+		if (rect.t - rect.b < 0.5 && cch != 0)
+		{
+			layout.t = rect.b + std::fmax(rect.t - rect.b, (rect.r - rect.l) / cch);
+		}
+		return layout;
+	}
+}
+
+CLayoutJoiner::CLayoutJoiner() : m_layout(TEXTLAYOUT_LINES), m_fHavePrev(false), m_prev(), m_chLast(0), m_fLastUnspaced(false), m_fPendingHyphen(false), m_fAfterBlock(false)
+{
+}
+
+void CLayoutJoiner::Begin()
+{
+	m_fHavePrev = false;
+	m_chLast = 0;
+	m_fLastUnspaced = false;
+	m_fPendingHyphen = false;
+	m_fAfterBlock = false;
+}
+
+void CLayoutJoiner::Append(std::u16string& text, const CPageTextExtractor::Run& run)
+{
+	if (run.cch == 0 && !run.hyphenated)
+	{
+		return;
+	}
+
+	if (m_layout != TEXTLAYOUT_NONE && m_fHavePrev)
+	{
+		SEPARATOR separator = m_fAfterBlock ? SEPARATOR_BLOCK : GetSeparator(run);
+		if (m_fPendingHyphen)
+		{
+			m_fPendingHyphen = false;
+			if (separator == SEPARATOR_LINE)
+			{
+				// the rest of the word
+				separator = SEPARATOR_NONE;
+			}
+			else
+			{
+				text.push_back(u'-');
+			}
+		}
+
+		switch (separator)
+		{
+		case SEPARATOR_SPACE:
+			text.push_back(u' ');
+			break;
+		case SEPARATOR_LINE:
+			text.push_back(u'\n');
+			break;
+		case SEPARATOR_BLOCK:
+			text.append(u"\n\n");
+			break;
+		default:
+			break;
+		}
+	}
+	text.append(run.text, run.cch);
+
+	m_fHavePrev = true;
+	m_prev = GetLayoutRect(run.rect, run.cch);
+	m_fAfterBlock = false;
+	m_fPendingHyphen = run.hyphenated;
+	m_chLast = run.hyphenated ? u'-' : run.text[run.cch - 1];
+	m_fLastUnspaced = !run.hyphenated && (IsUnspacedChar(m_chLast)
+		|| (2 <= run.cch && 0xDC00 <= m_chLast && m_chLast <= 0xDFFF && IsUnspacedPair(run.text[run.cch - 2])));
+}
+
+void CLayoutJoiner::AppendBlock(std::u16string& text, const CPageTextExtractor::Run& run)
+{
+	if (run.cch == 0)
+	{
+		return;
+	}
+
+	if (m_layout != TEXTLAYOUT_NONE && m_fHavePrev)
+	{
+		End(text);
+		text.append(u"\n\n");
+	}
+	text.append(run.text, run.cch);
+
+	m_fHavePrev = true;
+	m_fAfterBlock = true;
+	m_chLast = run.text[run.cch - 1];
+	m_fLastUnspaced = false;
+}
+
+void CLayoutJoiner::End(std::u16string& text)
+{
+	if (m_fPendingHyphen)
+	{
+		text.push_back(u'-');
+		m_fPendingHyphen = false;
+	}
+}
+
+CLayoutJoiner::SEPARATOR CLayoutJoiner::GetSeparator(const CPageTextExtractor::Run& run) const
+{
+	DblRect rect = GetLayoutRect(run.rect, run.cch);
+	double h = rect.t - rect.b;
+	double hPrev = m_prev.t - m_prev.b;
+	double hLine = std::fmax(h, hPrev);
+	double sharedHeight = std::fmin(rect.t, m_prev.t) - std::fmax(rect.b, m_prev.b);
+
+	SEPARATOR separator;
+	if (h * 0.5 <= sharedHeight || hPrev * 0.5 <= sharedHeight)
+	{
+		// the same line, unless the run goes back to its left: the next line of vertical writing,
+		// or text drawn out of order
+		if (rect.l < m_prev.l - hLine * 0.5)
+		{
+			separator = SEPARATOR_LINE;
+		}
+		else
+		{
+			separator = run.continuous ? SEPARATOR_NONE : SEPARATOR_SPACE;
+		}
+	}
+	else if (m_prev.t <= rect.b)
+	{
+		// above the previous run: the top of the next column
+		separator = SEPARATOR_BLOCK;
+	}
+	else
+	{
+		// below: the next line, or the next paragraph when the baselines are further apart than
+		// the line spacing of solid text
+		separator = (m_prev.b - rect.b <= hLine * 1.8) ? SEPARATOR_LINE : SEPARATOR_BLOCK;
+	}
+
+	char16_t chFirst = (run.cch != 0) ? run.text[0] : u'-';
+	bool fFirstUnspaced = IsUnspacedChar(chFirst) || IsUnspacedPair(chFirst);
+	if (m_fLastUnspaced && fFirstUnspaced)
+	{
+		return (separator == SEPARATOR_BLOCK) ? SEPARATOR_LINE : SEPARATOR_NONE;
+	}
+	if (separator == SEPARATOR_SPACE && (IsSpace(m_chLast) || IsSpace(chFirst)))
+	{
+		return SEPARATOR_NONE;
+	}
+	return separator;
+}
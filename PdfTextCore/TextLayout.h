@@ -0,0 +1,68 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <string>
+
+#include "ChunkSink.h"
+#include "PageTextExtractor.h"
+
+// Joins the runs of a page, in reading order, into the page text.
+//
+// Runs on one line are joined with a space unless they touch (Run::continuous), runs on the next
+// line with a line break, and a run above the previous one (the next column) or well below it
+// (the next paragraph) with a blank line. Japanese and Chinese have no spaces between words and
+// wrap lines inside them: between two such characters there is no separator, and a blank line
+// becomes a line break. A word hyphenated at the end of a line (Run::hyphenated) is joined with
+// its rest on the next line; anywhere else the hyphen is put back.
+class CLayoutJoiner
+{
+public:
+	CLayoutJoiner();
+
+	void SetLayout(TEXTLAYOUT layout)
+	{
+		m_layout = layout;
+	}
+
+	TEXTLAYOUT GetLayout() const
+	{
+		return m_layout;
+	}
+
+	// Starts a page.
+	void Begin();
+
+	// Appends run to text, after the separator its position calls for. text may be a new chunk of
+	// the same page: the separator then starts it.
+	void Append(std::u16string& text, const CPageTextExtractor::Run& run);
+
+	// Appends run as a block of its own, whatever its rectangle: text without a place on the page,
+	// such as the Alt text of a figure (CStructureOrder::IsPlaced).
+	void AppendBlock(std::u16string& text, const CPageTextExtractor::Run& run);
+
+	// Ends the page: appends the hyphen of a last run that was hyphenated.
+	void End(std::u16string& text);
+
+private:
+	enum SEPARATOR {
+		SEPARATOR_NONE,
+		SEPARATOR_SPACE,
+		SEPARATOR_LINE,
+		SEPARATOR_BLOCK,
+	};
+
+	SEPARATOR GetSeparator(const CPageTextExtractor::Run& run) const;
+
+	TEXTLAYOUT m_layout;
+	bool m_fHavePrev;
+	DblRect m_prev;
+	// last character of the previous run, 0 if none
+	char16_t m_chLast;
+	// the previous run ends in a character written without spaces (CJK)
+	bool m_fLastUnspaced;
+	// the previous run was hyphenated and its hyphen is not written yet
+	bool m_fPendingHyphen;
+	// the previous run was a block of its own: m_prev is not its place
+	bool m_fAfterBlock;
+};
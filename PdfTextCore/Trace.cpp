@@ -0,0 +1,364 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "Trace.h"
+
+#ifndef PDFTEXT_NO_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <share.h>
+#include <TraceLoggingProvider.h>
+#else
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef _WIN32
+// {080FF014-2034-475A-B645-782B3C967071}
+TRACELOGGING_DEFINE_PROVIDER(g_hTraceProvider, "PDFSampleFilter2",
+	(0x080ff014, 0x2034, 0x475a, 0xb6, 0x45, 0x78, 0x2b, 0x3c, 0x96, 0x70, 0x71));
+#endif
+
+namespace
+{
+	enum TRACESINK {
+		TRACESINK_FILE = 1 << 0,
+		TRACESINK_ETW = 1 << 1,
+	};
+
+	struct EventInfo
+	{
+		const char* name;
+		// bits of the TRACEVALUE written to the file
+		uint32_t valueMask;
+	};
+
+	const uint32_t ALL_VALUES = (1U << TRACEVALUE_COUNT) - 1;
+
+	const EventInfo EVENTS[TRACEEVENT_COUNT] = {
+		{ "Document", ALL_VALUES },
+		{ "LoadDocument", (1U << TRACEVALUE_BYTES) | (1U << TRACEVALUE_PAGES) | (1U << TRACEVALUE_FLAGS) },
+		{ "LoadPage", 0 },
+		{ "LoadTextPage", 1U << TRACEVALUE_CHARS },
+		{ "PageText", 1U << TRACEVALUE_CHARS },
+		{ "FilterInit", (1U << TRACEVALUE_BYTES) | (1U << TRACEVALUE_FLAGS) },
+	};
+
+	const char* const VALUE_NAMES[TRACEVALUE_COUNT] = {
+		"bytes", "pages", "chars", "chunks", "blockCalls", "blockBytes", "blockUs", "flags",
+	};
+
+	// the lines are written out when this much is buffered, and after every document
+	const size_t FLUSH_BYTES = 64 * 1024;
+
+	// guards the file and the buffer
+	std::mutex s_mutex;
+	FILE* s_pFile = NULL;
+	std::string s_buffer;
+#ifdef _WIN32
+	// the ETW provider is registered
+	bool s_fRegistered = false;
+#endif
+
+	std::atomic<uint64_t> s_lastDocumentId(0);
+
+	uint64_t GetProcessId()
+	{
+#ifdef _WIN32
+		return ::GetCurrentProcessId();
+#else
+		return static_cast<uint64_t>(getpid());
+#endif
+	}
+
+	uint64_t GetThreadId()
+	{
+#ifdef _WIN32
+		return ::GetCurrentThreadId();
+#elif defined(__linux__)
+		// the id perf and /proc show
+		return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+		return static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+	}
+
+	void AppendJsonString(std::string& out, const std::string& text)
+	{
+		static const char HEX[] = "0123456789abcdef";
+		out += '"';
+		for (char ch : text)
+		{
+			unsigned char uch = static_cast<unsigned char>(ch);
+			if (ch == '"' || ch == '\\')
+			{
+				out += '\\';
+				out += ch;
+			}
+			else if (uch < 0x20)
+			{
+				out += "\\u00";
+				out += HEX[uch >> 4];
+				out += HEX[uch & 0xF];
+			}
+			else
+			{
+				out += ch;
+			}
+		}
+		out += '"';
+	}
+
+	// with s_mutex held
+	void WriteBuffer()
+	{
+		if (s_pFile != NULL && !s_buffer.empty())
+		{
+			// one write of whole lines, so that the lines of processes sharing the file don't mix
+			fwrite(s_buffer.data(), 1, s_buffer.size(), s_pFile);
+		}
+		s_buffer.clear();
+	}
+
+	void WriteLine(const TraceRecord& record)
+	{
+		const EventInfo& info = EVENTS[record.event];
+		std::string line;
+		line.reserve(256);
+		line += "{\"name\":\"";
+		line += info.name;
+		line += "\",\"ph\":\"X\",\"ts\":";
+		line += std::to_string(record.usStart);
+		line += ",\"dur\":";
+		line += std::to_string(record.usDuration);
+		line += ",\"pid\":";
+		line += std::to_string(GetProcessId());
+		line += ",\"tid\":";
+		line += std::to_string(GetThreadId());
+		line += ",\"args\":{\"doc\":";
+		line += std::to_string(record.document);
+		if (0 <= record.page)
+		{
+			line += ",\"page\":";
+			line += std::to_string(record.page);
+		}
+		for (int x = 0; x < TRACEVALUE_COUNT; x++)
+		{
+			if (info.valueMask & (1U << x))
+			{
+				line += ",\"";
+				line += VALUE_NAMES[x];
+				line += "\":";
+				line += std::to_string(record.values[x]);
+			}
+		}
+		if (!record.name.empty())
+		{
+			line += ",\"file\":";
+			AppendJsonString(line, record.name);
+		}
+		line += "}}\n";
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_buffer += line;
+		if (FLUSH_BYTES <= s_buffer.size())
+		{
+			WriteBuffer();
+		}
+	}
+
+#ifdef _WIN32
+	// TraceLoggingWrite takes the event name as a literal
+#define WRITE_ETW_EVENT(eventName) \
+	TraceLoggingWrite(g_hTraceProvider, eventName, \
+		TraceLoggingUInt64(record.document, "doc"), \
+		TraceLoggingInt32(record.page, "page"), \
+		TraceLoggingUInt64(record.usStart, "startUs"), \
+		TraceLoggingUInt64(record.usDuration, "us"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_BYTES], "bytes"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_PAGES], "pages"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_CHARS], "chars"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_CHUNKS], "chunks"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_BLOCK_CALLS], "blockCalls"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_BLOCK_BYTES], "blockBytes"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_BLOCK_US], "blockUs"), \
+		TraceLoggingUInt64(record.values[TRACEVALUE_FLAGS], "flags"), \
+		TraceLoggingUtf8String(record.name.c_str(), "file"))
+
+	void WriteEtwEvent(const TraceRecord& record)
+	{
+		switch (record.event)
+		{
+		case TRACEEVENT_DOCUMENT:
+			WRITE_ETW_EVENT("Document");
+			break;
+		case TRACEEVENT_LOAD_DOCUMENT:
+			WRITE_ETW_EVENT("LoadDocument");
+			break;
+		case TRACEEVENT_LOAD_PAGE:
+			WRITE_ETW_EVENT("LoadPage");
+			break;
+		case TRACEEVENT_LOAD_TEXT_PAGE:
+			WRITE_ETW_EVENT("LoadTextPage");
+			break;
+		case TRACEEVENT_PAGE_TEXT:
+			WRITE_ETW_EVENT("PageText");
+			break;
+		case TRACEEVENT_FILTER_INIT:
+			WRITE_ETW_EVENT("FilterInit");
+			break;
+		default:
+			break;
+		}
+	}
+
+#undef WRITE_ETW_EVENT
+#endif
+}
+
+std::atomic<uint32_t> CTrace::s_sinks(0);
+
+bool CTrace::OpenFile(const PathString& path)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (s_pFile != NULL)
+	{
+		WriteBuffer();
+		fclose(s_pFile);
+		s_pFile = NULL;
+		s_sinks &= ~static_cast<uint32_t>(TRACESINK_FILE);
+	}
+
+#ifdef _WIN32
+	// shared with the other processes tracing to the file
+	s_pFile = _wfsopen(path.c_str(), L"ab", _SH_DENYNO);
+#else
+	s_pFile = fopen(path.c_str(), "ab");
+#endif
+	if (s_pFile == NULL)
+	{
+		return false;
+	}
+	// the lines are buffered here, in whole lines
+	setvbuf(s_pFile, NULL, _IONBF, 0);
+	s_sinks |= TRACESINK_FILE;
+	return true;
+}
+
+bool CTrace::OpenFileFromEnvironment()
+{
+#ifdef _WIN32
+	WCHAR path[MAX_PATH];
+	DWORD cch = GetEnvironmentVariableW(L"PDFTEXT_TRACE", path, ARRAYSIZE(path));
+	return cch != 0 && cch < ARRAYSIZE(path) && OpenFile(path);
+#else
+	const char* path = getenv("PDFTEXT_TRACE");
+	return path != NULL && *path != 0 && OpenFile(path);
+#endif
+}
+
+void CTrace::RegisterProvider()
+{
+#ifdef _WIN32
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (s_fRegistered)
+	{
+		return;
+	}
+	// sessions come and go while the provider is registered
+	s_fRegistered = SUCCEEDED(TraceLoggingRegisterEx(g_hTraceProvider,
+		[](LPCGUID, ULONG isEnabled, UCHAR, ULONGLONG, ULONGLONG, PEVENT_FILTER_DESCRIPTOR, PVOID)
+		{
+			if (isEnabled != EVENT_CONTROL_CODE_DISABLE_PROVIDER)
+			{
+				s_sinks |= TRACESINK_ETW;
+			}
+			else
+			{
+				s_sinks &= ~static_cast<uint32_t>(TRACESINK_ETW);
+			}
+		},
+		NULL));
+#endif
+}
+
+void CTrace::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (s_pFile != NULL)
+	{
+		WriteBuffer();
+		fclose(s_pFile);
+		s_pFile = NULL;
+	}
+	s_buffer.shrink_to_fit();
+#ifdef _WIN32
+	if (s_fRegistered)
+	{
+		TraceLoggingUnregister(g_hTraceProvider);
+		s_fRegistered = false;
+	}
+#endif
+	s_sinks = 0;
+}
+
+uint64_t CTrace::NewDocumentId()
+{
+	return ++s_lastDocumentId;
+}
+
+uint64_t CTrace::NowMicroseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void CTrace::Write(const TraceRecord& record)
+{
+	uint32_t sinks = s_sinks.load(std::memory_order_relaxed);
+	if (sinks & TRACESINK_FILE)
+	{
+		WriteLine(record);
+	}
+#ifdef _WIN32
+	if (sinks & TRACESINK_ETW)
+	{
+		WriteEtwEvent(record);
+	}
+#endif
+}
+
+void CTrace::Flush()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	WriteBuffer();
+}
+
+void CTraceSpan::Start(TRACEEVENT event, uint64_t document, int page)
+{
+	m_record.event = event;
+	m_record.document = document;
+	m_record.page = page;
+	for (uint64_t& value : m_record.values)
+	{
+		value = 0;
+	}
+	m_record.name.clear();
+	m_record.usStart = CTrace::NowMicroseconds();
+}
+
+void CTraceSpan::Finish()
+{
+	m_record.usDuration = CTrace::NowMicroseconds() - m_record.usStart;
+	CTrace::Write(m_record);
+}
+
+#endif
@@ -0,0 +1,265 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "ChunkCache.h"
+
+// Spans traced on the extraction path. Each carries the TRACEVALUE listed with it.
+enum TRACEEVENT {
+	// CDocumentExtractor::Open to Close: BYTES, PAGES, CHARS, CHUNKS, BLOCK_*, FLAGS (TRUNCATION)
+	TRACEEVENT_DOCUMENT,
+	// loading the document in Open: BYTES, PAGES, FLAGS (1 if linearized)
+	TRACEEVENT_LOAD_DOCUMENT,
+	// FPDF_LoadPage, with what a linearized document pulls for the page
+	TRACEEVENT_LOAD_PAGE,
+	// FPDFText_LoadPage: CHARS of the text page
+	TRACEEVENT_LOAD_TEXT_PAGE,
+	// reading the runs of one chunk of page text: CHARS
+	TRACEEVENT_PAGE_TEXT,
+	// IFilter::Init of the filter, cache lookup and worker included: BYTES, FLAGS (TRACEINIT)
+	TRACEEVENT_FILTER_INIT,
+	TRACEEVENT_COUNT
+};
+
+enum TRACEVALUE {
+	// size of the document
+	TRACEVALUE_BYTES,
+	TRACEVALUE_PAGES,
+	// characters of text
+	TRACEVALUE_CHARS,
+	// chunks emitted
+	TRACEVALUE_CHUNKS,
+	// reads of the document through GetBlock, their bytes, and the time blocked in them on the
+	// source: in the filter, the host's stream
+	TRACEVALUE_BLOCK_CALLS,
+	TRACEVALUE_BLOCK_BYTES,
+	TRACEVALUE_BLOCK_US,
+	// meaning per TRACEEVENT
+	TRACEVALUE_FLAGS,
+	TRACEVALUE_COUNT
+};
+
+// TRACEVALUE_FLAGS of TRACEEVENT_FILTER_INIT
+enum TRACEINIT {
+	TRACEINIT_CACHE_HIT = 1 << 0,
+	TRACEINIT_WORKER = 1 << 1,
+	TRACEINIT_FAILED = 1 << 2,
+};
+
+struct TraceRecord
+{
+	TRACEEVENT event;
+	// document of the span in this process (CTrace::NewDocumentId), 0 if none
+	uint64_t document;
+	// page index, -1 if none
+	int32_t page;
+	// steady clock (CLOCK_MONOTONIC on Linux, as perf uses), in microseconds
+	uint64_t usStart;
+	uint64_t usDuration;
+	uint64_t values[TRACEVALUE_COUNT];
+	// UTF-8 name of the document, if the caller knows it
+	std::string name;
+};
+
+#ifndef PDFTEXT_NO_TRACE
+
+// Process-wide trace of the spans: to a file of JSON lines, and to ETW on Windows.
+//
+// Off until a consumer asks for it: OpenFile() (PDFTEXT_TRACE in the tools, TraceFile in the filter),
+// or an ETW session enabling the provider RegisterProvider() registered. While off a span costs one
+// relaxed atomic load. Define PDFTEXT_NO_TRACE to compile the tracing out altogether.
+//
+// Each line of the file is a Chrome trace event ("ph":"X"), which PdfTraceDump sums up or wraps
+// for chrome://tracing and Perfetto. Several processes may append to one file.
+class CTrace
+{
+public:
+	// Appends the spans to path. Returns false if it can't be opened.
+	static bool OpenFile(const PathString& path);
+	// OpenFile() on the path in the PDFTEXT_TRACE environment variable, if it is set.
+	static bool OpenFileFromEnvironment();
+	// Windows: registers the ETW provider, whose sessions turn the trace on. Elsewhere nothing.
+	static void RegisterProvider();
+	// Flushes and closes the file and unregisters the provider.
+	static void Shutdown();
+
+	static bool IsEnabled()
+	{
+		return s_sinks.load(std::memory_order_relaxed) != 0;
+	}
+
+	// Identifies a document in the records of this process.
+	static uint64_t NewDocumentId();
+	static uint64_t NowMicroseconds();
+
+	static void Write(const TraceRecord& record);
+	// Writes the buffered lines out to the file. Done after every document.
+	static void Flush();
+
+private:
+	// TRACESINK bits of the consumers listening
+	static std::atomic<uint32_t> s_sinks;
+};
+
+// A span: Begin() to End(), or the scope. Does nothing unless the trace was on at Begin().
+class CTraceSpan
+{
+public:
+	CTraceSpan() : m_fOn(false)
+	{
+	}
+
+	CTraceSpan(TRACEEVENT event, uint64_t document, int page = -1) : m_fOn(false)
+	{
+		Begin(event, document, page);
+	}
+
+	~CTraceSpan()
+	{
+		End();
+	}
+
+	void Begin(TRACEEVENT event, uint64_t document, int page = -1)
+	{
+		m_fOn = CTrace::IsEnabled();
+		if (m_fOn)
+		{
+			Start(event, document, page);
+		}
+	}
+
+	// Writes the span.
+	void End()
+	{
+		if (m_fOn)
+		{
+			m_fOn = false;
+			Finish();
+		}
+	}
+
+	bool IsOn() const
+	{
+		return m_fOn;
+	}
+
+	void Set(TRACEVALUE value, uint64_t n)
+	{
+		if (m_fOn)
+		{
+			m_record.values[value] = n;
+		}
+	}
+
+	void Add(TRACEVALUE value, uint64_t n)
+	{
+		if (m_fOn)
+		{
+			m_record.values[value] += n;
+		}
+	}
+
+	void SetName(const std::string& name)
+	{
+		if (m_fOn)
+		{
+			m_record.name = name;
+		}
+	}
+
+private:
+	CTraceSpan(const CTraceSpan&);
+	CTraceSpan& operator=(const CTraceSpan&);
+
+	void Start(TRACEEVENT event, uint64_t document, int page);
+	void Finish();
+
+	bool m_fOn;
+	TraceRecord m_record;
+};
+
+#else
+
+class CTrace
+{
+public:
+	static bool OpenFile(const PathString&)
+	{
+		return false;
+	}
+
+	static bool OpenFileFromEnvironment()
+	{
+		return false;
+	}
+
+	static void RegisterProvider()
+	{
+	}
+
+	static void Shutdown()
+	{
+	}
+
+	static bool IsEnabled()
+	{
+		return false;
+	}
+
+	static uint64_t NewDocumentId()
+	{
+		return 0;
+	}
+
+	static uint64_t NowMicroseconds()
+	{
+		return 0;
+	}
+
+	static void Flush()
+	{
+	}
+};
+
+class CTraceSpan
+{
+public:
+	CTraceSpan()
+	{
+	}
+
+	CTraceSpan(TRACEEVENT, uint64_t, int = -1)
+	{
+	}
+
+	void Begin(TRACEEVENT, uint64_t, int = -1)
+	{
+	}
+
+	void End()
+	{
+	}
+
+	bool IsOn() const
+	{
+		return false;
+	}
+
+	void Set(TRACEVALUE, uint64_t)
+	{
+	}
+
+	void Add(TRACEVALUE, uint64_t)
+	{
+	}
+
+	void SetName(const std::string&)
+	{
+	}
+};
+
+#endif
@@ -0,0 +1,44 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "Utf.h"
+
+void AppendUtf8(std::string& out, const char16_t* text, size_t cch)
+{
+	out.reserve(out.size() + cch);
+	for (size_t x = 0; x < cch; x++)
+	{
+		unsigned int unicode = text[x];
+		if (0xD800 <= unicode && unicode <= 0xDBFF && x + 1 < cch && 0xDC00 <= text[x + 1] && text[x + 1] <= 0xDFFF)
+		{
+			unicode = 0x10000 + ((unicode - 0xD800) << 10) + (text[x + 1] - 0xDC00);
+			x++;
+		}
+		else if (0xD800 <= unicode && unicode <= 0xDFFF)
+		{
+			unicode = 0xFFFD;
+		}
+
+		if (unicode < 0x80)
+		{
+			out.push_back(static_cast<char>(unicode));
+		}
+		else if (unicode < 0x800)
+		{
+			out.push_back(static_cast<char>(0xC0 | (unicode >> 6)));
+			out.push_back(static_cast<char>(0x80 | (unicode & 0x3F)));
+		}
+		else if (unicode < 0x10000)
+		{
+			out.push_back(static_cast<char>(0xE0 | (unicode >> 12)));
+			out.push_back(static_cast<char>(0x80 | ((unicode >> 6) & 0x3F)));
+			out.push_back(static_cast<char>(0x80 | (unicode & 0x3F)));
+		}
+		else
+		{
+			out.push_back(static_cast<char>(0xF0 | (unicode >> 18)));
+			out.push_back(static_cast<char>(0x80 | ((unicode >> 12) & 0x3F)));
+			out.push_back(static_cast<char>(0x80 | ((unicode >> 6) & 0x3F)));
+			out.push_back(static_cast<char>(0x80 | (unicode & 0x3F)));
+		}
+	}
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Appends UTF-16 text to out as UTF-8. Unpaired surrogates become U+FFFD.
+void AppendUtf8(std::string& out, const char16_t* text, size_t cch);
+
+inline std::string ToUtf8(const std::u16string& text)
+{
+	std::string out;
+	AppendUtf8(out, text.data(), text.size());
+	return out;
+}
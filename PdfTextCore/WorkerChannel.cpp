@@ -0,0 +1,468 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "WorkerChannel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	struct MessageHeader
+	{
+		uint32_t type;
+		// body and text
+		uint32_t cb;
+	};
+
+	// the fixed part of a message, the largest of the *Message structs
+	const uint32_t MAX_BODY = 48;
+	static_assert(sizeof(TextMessage) <= MAX_BODY, "TextMessage is the largest, with its language");
+	// a chunk of one huge page with MaxChunkChars 0, and then some
+	const uint32_t MAX_MESSAGE = 256 * 1024 * 1024;
+
+#ifdef _WIN32
+	const CWorkerChannel::Handle NO_HANDLE = NULL;
+
+	void CloseChannelHandle(CWorkerChannel::Handle& h)
+	{
+		if (h != NO_HANDLE)
+		{
+			CloseHandle(h);
+			h = NO_HANDLE;
+		}
+	}
+#else
+	const CWorkerChannel::Handle NO_HANDLE = -1;
+
+	void CloseChannelHandle(CWorkerChannel::Handle& h)
+	{
+		if (h != NO_HANDLE)
+		{
+			close(h);
+			h = NO_HANDLE;
+		}
+	}
+
+	// a dead peer fails the write instead of raising SIGPIPE in the host
+	void SetNoSigPipe(int fd)
+	{
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+		(void)fd;
+#endif
+	}
+#endif
+
+	std::atomic<uint32_t> s_cChannels(0);
+}
+
+CWorkerChannel::CWorkerChannel()
+	: m_hConnection(NO_HANDLE)
+	, m_hWorkerConnection(NO_HANDLE)
+	, m_hWorkerShared(NO_HANDLE)
+	, m_pShared(NULL)
+	, m_cbShared(0)
+#ifdef _WIN32
+	, m_hEvent(NO_HANDLE)
+#endif
+{
+}
+
+CWorkerChannel::~CWorkerChannel()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool CWorkerChannel::Create(uint32_t cbShared)
+{
+	Close();
+
+	WCHAR szName[96];
+	swprintf_s(szName, L"\\\\.\\pipe\\PDFSampleFilter2.Worker.%lu.%u", GetCurrentProcessId(), ++s_cChannels);
+
+	// the only instance, so nothing can connect once the worker end has
+	HANDLE hPipe = CreateNamedPipeW(szName, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 64 * 1024, 64 * 1024, 0, NULL);
+	if (hPipe == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	m_hConnection = hPipe;
+
+	SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+	HANDLE hWorkerPipe = CreateFileW(szName, GENERIC_READ | GENERIC_WRITE, 0, &sa, OPEN_EXISTING, 0, NULL);
+	if (hWorkerPipe == INVALID_HANDLE_VALUE)
+	{
+		Close();
+		return false;
+	}
+	m_hWorkerConnection = hWorkerPipe;
+
+	m_hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+	m_hWorkerShared = CreateFileMappingW(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE, 0, cbShared, NULL);
+	if (m_hEvent == NO_HANDLE || m_hWorkerShared == NO_HANDLE)
+	{
+		Close();
+		return false;
+	}
+	m_pShared = static_cast<uint8_t*>(MapViewOfFile(m_hWorkerShared, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, cbShared));
+	if (m_pShared == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_cbShared = cbShared;
+	return true;
+}
+
+std::vector<std::string> CWorkerChannel::GetWorkerArguments() const
+{
+	std::vector<std::string> arguments;
+	arguments.push_back(std::to_string(WORKER_PROTOCOL_VERSION));
+	arguments.push_back(std::to_string(reinterpret_cast<ULONG_PTR>(m_hWorkerConnection)));
+	arguments.push_back(std::to_string(reinterpret_cast<ULONG_PTR>(m_hWorkerShared)));
+	arguments.push_back(std::to_string(m_cbShared));
+	return arguments;
+}
+
+bool CWorkerChannel::Attach(const std::vector<std::string>& arguments)
+{
+	Close();
+	if (arguments.size() != 4 || strtoul(arguments[0].c_str(), NULL, 10) != WORKER_PROTOCOL_VERSION)
+	{
+		return false;
+	}
+	m_hConnection = reinterpret_cast<HANDLE>(static_cast<ULONG_PTR>(strtoull(arguments[1].c_str(), NULL, 10)));
+	HANDLE hShared = reinterpret_cast<HANDLE>(static_cast<ULONG_PTR>(strtoull(arguments[2].c_str(), NULL, 10)));
+	uint32_t cbShared = static_cast<uint32_t>(strtoul(arguments[3].c_str(), NULL, 10));
+	if (m_hConnection == NO_HANDLE || hShared == NO_HANDLE || cbShared == 0)
+	{
+		return false;
+	}
+
+	m_pShared = static_cast<uint8_t*>(MapViewOfFile(hShared, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, cbShared));
+	CloseHandle(hShared);
+	if (m_pShared == NULL)
+	{
+		return false;
+	}
+	m_cbShared = cbShared;
+	return true;
+}
+
+void CWorkerChannel::Close()
+{
+	if (m_pShared)
+	{
+		UnmapViewOfFile(m_pShared);
+		m_pShared = NULL;
+	}
+	m_cbShared = 0;
+	CloseWorkerEnd();
+	CloseChannelHandle(m_hConnection);
+	CloseChannelHandle(m_hEvent);
+}
+
+bool CWorkerChannel::ReadFully(void* pBuf, size_t cb, uint32_t msTimeout)
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
+	uint8_t* p = static_cast<uint8_t*>(pBuf);
+	while (cb != 0)
+	{
+		DWORD cbChunk = (cb < 0x10000000) ? static_cast<DWORD>(cb) : 0x10000000;
+		DWORD cbDone = 0;
+		if (m_hEvent == NO_HANDLE)
+		{
+			// the worker end is synchronous
+			if (!ReadFile(m_hConnection, p, cbChunk, &cbDone, NULL))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			OVERLAPPED ov = {};
+			ov.hEvent = m_hEvent;
+			if (!ReadFile(m_hConnection, p, cbChunk, NULL, &ov))
+			{
+				if (GetLastError() != ERROR_IO_PENDING)
+				{
+					return false;
+				}
+				DWORD msWait = INFINITE;
+				if (msTimeout != 0)
+				{
+					long long msLeft = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+					msWait = (msLeft <= 0) ? 0 : static_cast<DWORD>(msLeft);
+				}
+				if (WaitForSingleObject(m_hEvent, msWait) != WAIT_OBJECT_0)
+				{
+					CancelIoEx(m_hConnection, &ov);
+					GetOverlappedResult(m_hConnection, &ov, &cbDone, TRUE);
+					return false;
+				}
+			}
+			if (!GetOverlappedResult(m_hConnection, &ov, &cbDone, FALSE))
+			{
+				return false;
+			}
+		}
+		if (cbDone == 0)
+		{
+			return false;
+		}
+		p += cbDone;
+		cb -= cbDone;
+	}
+	return true;
+}
+
+bool CWorkerChannel::WriteFully(const void* pBuf, size_t cb)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pBuf);
+	while (cb != 0)
+	{
+		DWORD cbChunk = (cb < 0x10000000) ? static_cast<DWORD>(cb) : 0x10000000;
+		DWORD cbDone = 0;
+		if (m_hEvent == NO_HANDLE)
+		{
+			if (!WriteFile(m_hConnection, p, cbChunk, &cbDone, NULL))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			OVERLAPPED ov = {};
+			ov.hEvent = m_hEvent;
+			if (!WriteFile(m_hConnection, p, cbChunk, NULL, &ov) && GetLastError() != ERROR_IO_PENDING)
+			{
+				return false;
+			}
+			if (!GetOverlappedResult(m_hConnection, &ov, &cbDone, TRUE))
+			{
+				return false;
+			}
+		}
+		if (cbDone == 0)
+		{
+			return false;
+		}
+		p += cbDone;
+		cb -= cbDone;
+	}
+	return true;
+}
+#else
+bool CWorkerChannel::Create(uint32_t cbShared)
+{
+	Close();
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+		return false;
+	}
+	m_hConnection = fds[0];
+	m_hWorkerConnection = fds[1];
+	fcntl(m_hConnection, F_SETFD, FD_CLOEXEC);
+	fcntl(m_hWorkerConnection, F_SETFD, FD_CLOEXEC);
+	SetNoSigPipe(m_hConnection);
+
+	// unlinked right away: only the two processes can reach it, and it goes with them
+	char szName[64];
+	snprintf(szName, sizeof(szName), "/PDFSampleFilter2.%ld.%u", static_cast<long>(getpid()), ++s_cChannels);
+	m_hWorkerShared = shm_open(szName, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (m_hWorkerShared == NO_HANDLE)
+	{
+		Close();
+		return false;
+	}
+	shm_unlink(szName);
+	fcntl(m_hWorkerShared, F_SETFD, FD_CLOEXEC);
+	if (ftruncate(m_hWorkerShared, cbShared) != 0)
+	{
+		Close();
+		return false;
+	}
+	void* pShared = mmap(NULL, cbShared, PROT_READ | PROT_WRITE, MAP_SHARED, m_hWorkerShared, 0);
+	if (pShared == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_pShared = static_cast<uint8_t*>(pShared);
+	m_cbShared = cbShared;
+	return true;
+}
+
+std::vector<std::string> CWorkerChannel::GetWorkerArguments() const
+{
+	std::vector<std::string> arguments;
+	arguments.push_back(std::to_string(WORKER_PROTOCOL_VERSION));
+	arguments.push_back(std::to_string(m_hWorkerConnection));
+	arguments.push_back(std::to_string(m_hWorkerShared));
+	arguments.push_back(std::to_string(m_cbShared));
+	return arguments;
+}
+
+bool CWorkerChannel::Attach(const std::vector<std::string>& arguments)
+{
+	Close();
+	if (arguments.size() != 4 || strtoul(arguments[0].c_str(), NULL, 10) != WORKER_PROTOCOL_VERSION)
+	{
+		return false;
+	}
+	long fdConnection = strtol(arguments[1].c_str(), NULL, 10);
+	long fdShared = strtol(arguments[2].c_str(), NULL, 10);
+	uint32_t cbShared = static_cast<uint32_t>(strtoul(arguments[3].c_str(), NULL, 10));
+	if (fdConnection <= 0 || fdShared <= 0 || cbShared == 0)
+	{
+		return false;
+	}
+	m_hConnection = static_cast<int>(fdConnection);
+	fcntl(m_hConnection, F_SETFD, FD_CLOEXEC);
+	SetNoSigPipe(m_hConnection);
+
+	void* pShared = mmap(NULL, cbShared, PROT_READ | PROT_WRITE, MAP_SHARED, static_cast<int>(fdShared), 0);
+	close(static_cast<int>(fdShared));
+	if (pShared == MAP_FAILED)
+	{
+		return false;
+	}
+	m_pShared = static_cast<uint8_t*>(pShared);
+	m_cbShared = cbShared;
+	return true;
+}
+
+void CWorkerChannel::Close()
+{
+	if (m_pShared)
+	{
+		munmap(m_pShared, m_cbShared);
+		m_pShared = NULL;
+	}
+	m_cbShared = 0;
+	CloseWorkerEnd();
+	CloseChannelHandle(m_hConnection);
+}
+
+bool CWorkerChannel::ReadFully(void* pBuf, size_t cb, uint32_t msTimeout)
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msTimeout);
+	uint8_t* p = static_cast<uint8_t*>(pBuf);
+	while (cb != 0)
+	{
+		if (msTimeout != 0)
+		{
+			long long msLeft = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			struct pollfd pfd = { m_hConnection, POLLIN, 0 };
+			int cReady = poll(&pfd, 1, (msLeft <= 0) ? 0 : static_cast<int>(msLeft));
+			if (cReady < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (cReady <= 0)
+			{
+				return false;
+			}
+		}
+		ssize_t cbDone = read(m_hConnection, p, cb);
+		if (cbDone < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (cbDone <= 0)
+		{
+			return false;
+		}
+		p += cbDone;
+		cb -= static_cast<size_t>(cbDone);
+	}
+	return true;
+}
+
+bool CWorkerChannel::WriteFully(const void* pBuf, size_t cb)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pBuf);
+	while (cb != 0)
+	{
+#ifdef MSG_NOSIGNAL
+		ssize_t cbDone = send(m_hConnection, p, cb, MSG_NOSIGNAL);
+#else
+		ssize_t cbDone = send(m_hConnection, p, cb, 0);
+#endif
+		if (cbDone < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (cbDone <= 0)
+		{
+			return false;
+		}
+		p += cbDone;
+		cb -= static_cast<size_t>(cbDone);
+	}
+	return true;
+}
+#endif
+
+void CWorkerChannel::GetWorkerHandles(Handle& hConnection, Handle& hShared) const
+{
+	hConnection = m_hWorkerConnection;
+	hShared = m_hWorkerShared;
+}
+
+void CWorkerChannel::CloseWorkerEnd()
+{
+	CloseChannelHandle(m_hWorkerConnection);
+	CloseChannelHandle(m_hWorkerShared);
+}
+
+bool CWorkerChannel::Send(uint32_t type, const void* pBody, uint32_t cbBody, const void* pText, uint32_t cbText)
+{
+	if (m_hConnection == NO_HANDLE || MAX_BODY < cbBody || MAX_MESSAGE - cbBody < cbText)
+	{
+		return false;
+	}
+
+	// the header and the body in one write
+	uint8_t buf[sizeof(MessageHeader) + MAX_BODY];
+	MessageHeader header = { type, cbBody + cbText };
+	memcpy(buf, &header, sizeof(header));
+	if (cbBody != 0)
+	{
+		memcpy(buf + sizeof(header), pBody, cbBody);
+	}
+	return WriteFully(buf, sizeof(header) + cbBody)
+		&& (cbText == 0 || WriteFully(pText, cbText));
+}
+
+bool CWorkerChannel::Receive(uint32_t& type, std::vector<uint8_t>& body, uint32_t msTimeout)
+{
+	MessageHeader header;
+	if (m_hConnection == NO_HANDLE || !ReadFully(&header, sizeof(header), msTimeout) || MAX_MESSAGE < header.cb)
+	{
+		return false;
+	}
+	type = header.type;
+	body.resize(header.cb);
+	return header.cb == 0 || ReadFully(body.data(), header.cb, msTimeout);
+}
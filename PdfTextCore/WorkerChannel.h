@@ -0,0 +1,176 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ChunkSink.h"
+
+// Messages between a client (CRemoteExtractor) and an extraction worker process (PdfWorker).
+//
+// The client asks for one step at a time. While it waits for the reply the worker may ask for
+// bytes of the document (READ), which the client answers with DATA and the bytes in the shared
+// memory, and hand back chunks (PROPERTY, TEXT).
+enum WORKERMESSAGE {
+	// client to worker
+	WORKERMESSAGE_OPEN = 1,		// OpenMessage
+	WORKERMESSAGE_STEP,			// StepMessage
+	WORKERMESSAGE_CLOSE,		// no body
+	WORKERMESSAGE_DATA,			// DataMessage, the bytes in the shared memory
+	// worker to client
+	WORKERMESSAGE_READ,			// RangeMessage, answered with DATA
+	WORKERMESSAGE_PREFETCH,		// RangeMessage, not answered
+	WORKERMESSAGE_OPENED,		// OpenedMessage
+	WORKERMESSAGE_PROPERTY,		// PropertyMessage, and the UTF-16 value of a text property
+	WORKERMESSAGE_TEXT,			// TextMessage and the UTF-16 text
+	WORKERMESSAGE_STEPPED,		// SteppedMessage
+	WORKERMESSAGE_CLOSED,		// ClosedMessage
+};
+
+// Bump when the messages change. The worker refuses a client of another version.
+const uint32_t WORKER_PROTOCOL_VERSION = 7;
+
+struct OpenMessage
+{
+	uint64_t cbFile;
+	uint64_t cchDocument;
+	uint32_t msDocument;
+	uint32_t msPage;
+	uint32_t cchMaxChunk;
+	// TEXTLAYOUT
+	uint32_t layout;
+};
+
+struct StepMessage
+{
+	uint32_t propertyMask;
+	uint32_t fPages;
+};
+
+struct DataMessage
+{
+	uint32_t fOk;
+	uint32_t reserved;
+};
+
+struct RangeMessage
+{
+	uint64_t position;
+	uint64_t size;
+};
+
+struct OpenedMessage
+{
+	uint32_t fOk;
+	int32_t numPages;
+};
+
+// PropertyMessage::type, as the IChunkSink method that takes the property
+enum PROPERTYTYPE {
+	PROPERTYTYPE_TEXT,
+	PROPERTYTYPE_UINT32,
+	PROPERTYTYPE_TIME,
+};
+
+struct PropertyMessage
+{
+	uint32_t property;
+	// PROPERTYTYPE
+	uint32_t type;
+	// the number, or the PackUtcTime of the date
+	uint64_t value;
+};
+
+struct TextMessage
+{
+	int32_t pageIndex;
+	uint32_t fContinued;
+	// NUL terminated
+	char language[MAX_LANGUAGE_CHARS + 1];
+};
+
+struct SteppedMessage
+{
+	uint32_t fMore;
+	uint32_t truncation;
+	// CDocumentExtractor::GetPagesWithoutText
+	uint32_t cPagesWithoutText;
+	// CDocumentExtractor::GetPagesWithUnicodeErrors
+	uint32_t cPagesWithUnicodeErrors;
+};
+
+struct ClosedMessage
+{
+	// resident memory of the worker, for recycling
+	uint64_t cbWorkingSet;
+};
+
+// The connection between a client and one worker process: a duplex byte stream that carries the
+// messages, and a shared memory window that carries the document bytes.
+//
+// Windows: a named pipe and a file mapping. Elsewhere: a socket pair and a POSIX shared memory object.
+// The client creates both and the worker inherits its ends; their values go on its command line.
+class CWorkerChannel
+{
+public:
+#ifdef _WIN32
+	typedef void* Handle;		// HANDLE
+#else
+	typedef int Handle;
+#endif
+
+	CWorkerChannel();
+	~CWorkerChannel();
+
+	// Client: creates the connection and cbShared bytes of shared memory.
+	bool Create(uint32_t cbShared);
+	// Client: the inheritable handles of the worker end, and the command line arguments that pass
+	// them to Attach().
+	void GetWorkerHandles(Handle& hConnection, Handle& hShared) const;
+	std::vector<std::string> GetWorkerArguments() const;
+	// Client: closes the worker end once the worker has inherited it.
+	void CloseWorkerEnd();
+
+	// Worker: attaches to the ends named by the arguments of GetWorkerArguments().
+	// Fails if the client speaks another WORKER_PROTOCOL_VERSION.
+	bool Attach(const std::vector<std::string>& arguments);
+
+	void Close();
+
+	uint8_t* GetSharedMemory() const
+	{
+		return m_pShared;
+	}
+
+	uint32_t GetSharedSize() const
+	{
+		return m_cbShared;
+	}
+
+	// Sends a message: body, then cbText bytes of pText if any. Returns false if the peer is gone.
+	bool Send(uint32_t type, const void* pBody, uint32_t cbBody, const void* pText = NULL, uint32_t cbText = 0);
+
+	// Receives the next message. Waits at most msTimeout milliseconds, 0 is no limit.
+	// Returns false if the peer is gone, on a malformed message and on timeout.
+	bool Receive(uint32_t& type, std::vector<uint8_t>& body, uint32_t msTimeout);
+
+private:
+	CWorkerChannel(const CWorkerChannel&);
+	CWorkerChannel& operator=(const CWorkerChannel&);
+
+	bool ReadFully(void* pBuf, size_t cb, uint32_t msTimeout);
+	bool WriteFully(const void* pBuf, size_t cb);
+
+	Handle m_hConnection;
+	// the worker ends, until CloseWorkerEnd()
+	Handle m_hWorkerConnection;
+	Handle m_hWorkerShared;
+	uint8_t* m_pShared;
+	uint32_t m_cbShared;
+#ifdef _WIN32
+	// event of the overlapped I/O on the client end, whose reads can time out
+	Handle m_hEvent;
+#endif
+};
@@ -0,0 +1,455 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Time a worker gets past its budget before it is taken for hung. The budget is checked between
+	// runs; a single PDFium call can't be interrupted in process, but a worker can be killed.
+	const uint32_t WORKER_GRACE_MS = 5000;
+	// Without a budget, a worker silent for this long is taken for hung: no message, not even a
+	// READ, for a minute is far beyond any page PDFium lays out.
+	const uint32_t WORKER_HANG_MS = 60 * 1000;
+
+#ifdef _WIN32
+	// Kills the workers with the host, even when the host is killed itself.
+	HANDLE GetWorkerJob()
+	{
+		static HANDLE s_hJob = []()
+			{
+				HANDLE hJob = CreateJobObjectW(NULL, NULL);
+				if (hJob)
+				{
+					JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+					limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+					SetInformationJobObject(hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+				}
+				return hJob;
+			}();
+		return s_hJob;
+	}
+#endif
+}
+
+CWorkerProcess::CWorkerProcess()
+	: m_cDocuments(0)
+#ifdef _WIN32
+	, m_hProcess(NULL)
+#else
+	, m_pid(-1)
+#endif
+{
+}
+
+CWorkerProcess::~CWorkerProcess()
+{
+	Kill();
+}
+
+#ifdef _WIN32
+bool CWorkerProcess::Start(const PathString& workerPath, uint32_t cbShared)
+{
+	Kill();
+	if (!m_channel.Create(cbShared))
+	{
+		return false;
+	}
+
+	std::wstring commandLine = L"\"" + workerPath + L"\" --channel";
+	std::vector<std::string> arguments = m_channel.GetWorkerArguments();
+	for (const std::string& argument : arguments)
+	{
+		commandLine += L' ';
+		commandLine.append(argument.begin(), argument.end());
+	}
+
+	// the worker inherits its ends of the channel, and no other handle of the host
+	HANDLE handles[2];
+	m_channel.GetWorkerHandles(handles[0], handles[1]);
+	SIZE_T cbAttributes = 0;
+	InitializeProcThreadAttributeList(NULL, 1, 0, &cbAttributes);
+	std::vector<uint8_t> attributes(cbAttributes);
+	LPPROC_THREAD_ATTRIBUTE_LIST pAttributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributes.data());
+	if (!InitializeProcThreadAttributeList(pAttributes, 1, 0, &cbAttributes))
+	{
+		m_channel.Close();
+		return false;
+	}
+	BOOL fStarted = FALSE;
+	PROCESS_INFORMATION pi = {};
+	if (UpdateProcThreadAttribute(pAttributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, handles, sizeof(handles), NULL, NULL))
+	{
+		STARTUPINFOEXW si = {};
+		si.StartupInfo.cb = sizeof(si);
+		si.lpAttributeList = pAttributes;
+		fStarted = CreateProcessW(workerPath.c_str(), &commandLine[0], NULL, NULL, TRUE,
+			EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW | CREATE_SUSPENDED, NULL, NULL, &si.StartupInfo, &pi);
+	}
+	DeleteProcThreadAttributeList(pAttributes);
+	if (!fStarted)
+	{
+		m_channel.Close();
+		return false;
+	}
+
+	HANDLE hJob = GetWorkerJob();
+	if (hJob)
+	{
+		AssignProcessToJobObject(hJob, pi.hProcess);
+	}
+	ResumeThread(pi.hThread);
+	CloseHandle(pi.hThread);
+	m_hProcess = pi.hProcess;
+	m_channel.CloseWorkerEnd();
+	return true;
+}
+
+void CWorkerProcess::Kill()
+{
+	m_channel.Close();
+	if (m_hProcess)
+	{
+		TerminateProcess(m_hProcess, 1);
+		WaitForSingleObject(m_hProcess, 5000);
+		CloseHandle(m_hProcess);
+		m_hProcess = NULL;
+	}
+}
+#else
+bool CWorkerProcess::Start(const PathString& workerPath, uint32_t cbShared)
+{
+	Kill();
+	if (!m_channel.Create(cbShared))
+	{
+		return false;
+	}
+
+	// everything the child needs is prepared before fork: it may only call async-signal-safe functions
+	std::vector<std::string> arguments = m_channel.GetWorkerArguments();
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(workerPath.c_str()));
+	argv.push_back(const_cast<char*>("--channel"));
+	for (std::string& argument : arguments)
+	{
+		argv.push_back(&argument[0]);
+	}
+	argv.push_back(NULL);
+	int fdConnection, fdShared;
+	m_channel.GetWorkerHandles(fdConnection, fdShared);
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		// the worker ends survive exec, the other descriptors of the host are close-on-exec
+		fcntl(fdConnection, F_SETFD, 0);
+		fcntl(fdShared, F_SETFD, 0);
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+	if (pid < 0)
+	{
+		m_channel.Close();
+		return false;
+	}
+	m_pid = pid;
+	m_channel.CloseWorkerEnd();
+	return true;
+}
+
+void CWorkerProcess::Kill()
+{
+	m_channel.Close();
+	if (m_pid > 0)
+	{
+		kill(m_pid, SIGKILL);
+		while (waitpid(m_pid, NULL, 0) < 0 && errno == EINTR)
+		{
+		}
+		m_pid = -1;
+	}
+}
+#endif
+
+CWorkerPool::CWorkerPool()
+	: m_cWorkers(0), m_cDocumentsPerWorker(0), m_cbMaxWorkingSet(0), m_cBusy(0), m_cStarted(0)
+{
+}
+
+CWorkerPool::~CWorkerPool()
+{
+}
+
+void CWorkerPool::Open(const PathString& workerPath, uint32_t cWorkers, uint32_t cDocumentsPerWorker, uint64_t cbMaxWorkingSet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_workerPath = workerPath;
+	m_cWorkers = workerPath.empty() ? 0 : cWorkers;
+	m_cDocumentsPerWorker = cDocumentsPerWorker;
+	m_cbMaxWorkingSet = cbMaxWorkingSet;
+}
+
+std::unique_ptr<CWorkerProcess> CWorkerPool::Acquire(uint32_t msWait)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!IsEnabled() || !m_released.wait_for(lock, std::chrono::milliseconds(msWait), [this]() { return !m_idle.empty() || m_cBusy < m_cWorkers; }))
+	{
+		return std::unique_ptr<CWorkerProcess>();
+	}
+
+	++m_cBusy;
+	if (!m_idle.empty())
+	{
+		std::unique_ptr<CWorkerProcess> pWorker = std::move(m_idle.back());
+		m_idle.pop_back();
+		return pWorker;
+	}
+
+	// started outside the lock, the slot is already taken
+	lock.unlock();
+	std::unique_ptr<CWorkerProcess> pWorker(new CWorkerProcess());
+	bool fStarted = pWorker->Start(m_workerPath, SHARED_SIZE);
+	lock.lock();
+	if (!fStarted)
+	{
+		--m_cBusy;
+		m_released.notify_one();
+		return std::unique_ptr<CWorkerProcess>();
+	}
+	++m_cStarted;
+	return pWorker;
+}
+
+void CWorkerPool::Release(std::unique_ptr<CWorkerProcess> pWorker, bool fHealthy, uint64_t cbWorkingSet)
+{
+	if (!pWorker)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++pWorker->m_cDocuments;
+		if (fHealthy
+			&& (m_cDocumentsPerWorker == 0 || pWorker->m_cDocuments < m_cDocumentsPerWorker)
+			&& (m_cbMaxWorkingSet == 0 || cbWorkingSet <= m_cbMaxWorkingSet))
+		{
+			m_idle.push_back(std::move(pWorker));
+		}
+		--m_cBusy;
+		m_released.notify_one();
+	}
+	// a worker not kept is recycled here, outside the lock: the next Acquire starts a fresh one
+}
+
+uint32_t CWorkerPool::GetStartCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_cStarted;
+}
+
+CRemoteExtractor::CRemoteExtractor()
+	: m_pPool(NULL)
+	, m_pSource(NULL)
+	, m_cchMaxChunk(0)
+	, m_budget()
+	, m_layout(TEXTLAYOUT_LINES)
+	, m_propertyMask(PDFPROPERTY_ALL)
+	, m_fEmitPages(true)
+	, m_fOpen(false)
+	, m_fDone(false)
+	, m_fLost(false)
+	, m_numPages(0)
+	, m_truncation(TRUNCATION_NONE)
+	, m_cPagesWithoutText(0)
+	, m_cPagesWithUnicodeErrors(0)
+{
+}
+
+CRemoteExtractor::~CRemoteExtractor()
+{
+	Close();
+}
+
+bool CRemoteExtractor::Attach(CWorkerPool& pool, uint32_t msWait)
+{
+	Close();
+	m_pWorker = pool.Acquire(msWait);
+	if (!m_pWorker)
+	{
+		return false;
+	}
+	m_pPool = &pool;
+	return true;
+}
+
+bool CRemoteExtractor::Open(IByteSource* pSource)
+{
+	if (!m_pWorker || m_fOpen || m_fLost)
+	{
+		return false;
+	}
+
+	m_pSource = pSource;
+	m_fDone = false;
+	m_numPages = 0;
+	m_truncation = TRUNCATION_NONE;
+	m_cPagesWithoutText = 0;
+	m_cPagesWithUnicodeErrors = 0;
+
+	OpenMessage open = {};
+	open.cbFile = pSource->GetSize();
+	open.cchDocument = m_budget.cchDocument;
+	open.msDocument = m_budget.msDocument;
+	open.msPage = m_budget.msPage;
+	open.cchMaxChunk = m_cchMaxChunk;
+	open.layout = m_layout;
+	OpenedMessage opened = {};
+	if (!Call(WORKERMESSAGE_OPEN, &open, sizeof(open), WORKERMESSAGE_OPENED, &opened, sizeof(opened), NULL) || !opened.fOk)
+	{
+		return false;
+	}
+	m_fOpen = true;
+	m_numPages = opened.numPages;
+	return true;
+}
+
+void CRemoteExtractor::Close()
+{
+	if (!m_pWorker)
+	{
+		return;
+	}
+
+	ClosedMessage closed = {};
+	if (m_fOpen && !m_fLost)
+	{
+		Call(WORKERMESSAGE_CLOSE, NULL, 0, WORKERMESSAGE_CLOSED, &closed, sizeof(closed), NULL);
+	}
+	m_pPool->Release(std::move(m_pWorker), !m_fLost, closed.cbWorkingSet);
+	m_pPool = NULL;
+	m_pSource = NULL;
+	m_fOpen = false;
+	m_fDone = false;
+	m_fLost = false;
+}
+
+bool CRemoteExtractor::Step(IChunkSink& sink)
+{
+	if (!m_fOpen || m_fDone || m_fLost)
+	{
+		return false;
+	}
+
+	StepMessage step = { m_propertyMask, m_fEmitPages ? 1U : 0U };
+	SteppedMessage stepped = {};
+	if (!Call(WORKERMESSAGE_STEP, &step, sizeof(step), WORKERMESSAGE_STEPPED, &stepped, sizeof(stepped), &sink))
+	{
+		return false;
+	}
+	m_truncation = stepped.truncation;
+	m_cPagesWithoutText = stepped.cPagesWithoutText;
+	m_cPagesWithUnicodeErrors = stepped.cPagesWithUnicodeErrors;
+	m_fDone = !stepped.fMore;
+	return !m_fDone;
+}
+
+bool CRemoteExtractor::Call(uint32_t type, const void* pBody, uint32_t cbBody, uint32_t replyType, void* pReply, uint32_t cbReply, IChunkSink* pSink)
+{
+	CWorkerChannel& channel = m_pWorker->GetChannel();
+
+	// silence for longer than the budget allows is a hang, and without a budget a fixed limit applies:
+	// never wait on a worker forever
+	uint32_t msBudget = (m_budget.msPage < m_budget.msDocument) ? m_budget.msDocument : m_budget.msPage;
+	uint32_t msTimeout = (msBudget == 0) ? WORKER_HANG_MS : msBudget + WORKER_GRACE_MS;
+
+	if (!channel.Send(type, pBody, cbBody))
+	{
+		m_fLost = true;
+		return false;
+	}
+
+	uint32_t received;
+	while (channel.Receive(received, m_message, msTimeout))
+	{
+		const uint8_t* pMessage = m_message.data();
+		size_t cbMessage = m_message.size();
+		if (received == replyType && cbMessage == cbReply)
+		{
+			memcpy(pReply, pMessage, cbReply);
+			return true;
+		}
+		else if ((received == WORKERMESSAGE_READ || received == WORKERMESSAGE_PREFETCH) && cbMessage == sizeof(RangeMessage))
+		{
+			RangeMessage range;
+			memcpy(&range, pMessage, sizeof(range));
+			if (received == WORKERMESSAGE_PREFETCH)
+			{
+				m_pSource->Prefetch(range.position, range.size);
+				continue;
+			}
+			DataMessage data = {};
+			data.fOk = range.size <= channel.GetSharedSize()
+				&& m_pSource->Read(range.position, channel.GetSharedMemory(), static_cast<uint32_t>(range.size));
+			if (!channel.Send(WORKERMESSAGE_DATA, &data, sizeof(data)))
+			{
+				break;
+			}
+		}
+		else if (received == WORKERMESSAGE_PROPERTY && pSink != NULL && sizeof(PropertyMessage) <= cbMessage && cbMessage % sizeof(char16_t) == 0)
+		{
+			PropertyMessage property;
+			memcpy(&property, pMessage, sizeof(property));
+			if (PDFPROPERTY_COUNT <= property.property)
+			{
+				break;
+			}
+			if (property.type == PROPERTYTYPE_UINT32)
+			{
+				pSink->OnPropertyUInt32(static_cast<PDFPROPERTY>(property.property), static_cast<uint32_t>(property.value));
+			}
+			else if (property.type == PROPERTYTYPE_TIME)
+			{
+				pSink->OnPropertyTime(static_cast<PDFPROPERTY>(property.property), UnpackUtcTime(property.value));
+			}
+			else
+			{
+				pSink->OnProperty(static_cast<PDFPROPERTY>(property.property),
+					reinterpret_cast<const char16_t*>(pMessage + sizeof(property)), (cbMessage - sizeof(property)) / sizeof(char16_t));
+			}
+		}
+		else if (received == WORKERMESSAGE_TEXT && pSink != NULL && sizeof(TextMessage) <= cbMessage && cbMessage % sizeof(char16_t) == 0)
+		{
+			TextMessage text;
+			memcpy(&text, pMessage, sizeof(text));
+			text.language[MAX_LANGUAGE_CHARS] = '\0';
+			// the text stays in m_chunkMessage until the next step, the reply goes to m_message
+			m_chunkMessage.swap(m_message);
+			pMessage = m_chunkMessage.data();
+			pSink->OnText(text.pageIndex,
+				reinterpret_cast<const char16_t*>(pMessage + sizeof(text)), (cbMessage - sizeof(text)) / sizeof(char16_t), text.fContinued != 0,
+				text.language);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// crashed, hung or confused: Close() kills it
+	m_fLost = true;
+	return false;
+}
@@ -0,0 +1,214 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ByteSource.h"
+#include "ChunkCache.h"
+#include "ChunkSink.h"
+#include "DocumentExtractor.h"
+#include "WorkerChannel.h"
+
+// An extraction worker process (PdfWorker) and its channel.
+class CWorkerProcess
+{
+public:
+	CWorkerProcess();
+	// Kills the process if it still runs.
+	~CWorkerProcess();
+
+	// Starts workerPath with cbShared bytes of shared memory for the document bytes.
+	bool Start(const PathString& workerPath, uint32_t cbShared);
+	void Kill();
+
+	CWorkerChannel& GetChannel()
+	{
+		return m_channel;
+	}
+
+private:
+	friend class CWorkerPool;
+
+	CWorkerProcess(const CWorkerProcess&);
+	CWorkerProcess& operator=(const CWorkerProcess&);
+
+	// documents extracted so far
+	uint32_t m_cDocuments;
+
+	CWorkerChannel m_channel;
+#ifdef _WIN32
+	void* m_hProcess;			// HANDLE
+#else
+	int m_pid;
+#endif
+};
+
+// Worker processes shared by the documents of a process, one document per worker at a time.
+//
+// PDFium is one global state per process: the workers let documents be extracted on several cores
+// at once, and a crash or a hang in PDFium takes down a worker instead of the host. A worker is
+// recycled after a number of documents or when its memory has grown past a limit.
+class CWorkerPool
+{
+public:
+	CWorkerPool();
+	// Kills the idle workers.
+	~CWorkerPool();
+
+	// Up to cWorkers workers run workerPath. A worker is replaced after cDocumentsPerWorker documents
+	// or when its resident memory exceeds cbMaxWorkingSet after a document; 0 is no limit.
+	// cWorkers 0 leaves the pool disabled.
+	void Open(const PathString& workerPath, uint32_t cWorkers, uint32_t cDocumentsPerWorker, uint64_t cbMaxWorkingSet);
+
+	bool IsEnabled() const
+	{
+		return m_cWorkers != 0;
+	}
+
+	// Takes an idle worker, or starts one. Waits up to msWait while all the workers are busy.
+	// Returns NULL if none is available; the caller then extracts in process.
+	std::unique_ptr<CWorkerProcess> Acquire(uint32_t msWait);
+
+	// Gives back a worker after a document. A worker that failed (fHealthy false) is killed.
+	void Release(std::unique_ptr<CWorkerProcess> pWorker, bool fHealthy, uint64_t cbWorkingSet);
+
+	// workers started so far, recycled ones included
+	uint32_t GetStartCount() const;
+
+	// bytes of shared memory per worker, the largest block transferred at once
+	static const uint32_t SHARED_SIZE = 1024 * 1024;
+
+private:
+	CWorkerPool(const CWorkerPool&);
+	CWorkerPool& operator=(const CWorkerPool&);
+
+	PathString m_workerPath;
+	uint32_t m_cWorkers;
+	uint32_t m_cDocumentsPerWorker;
+	uint64_t m_cbMaxWorkingSet;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_released;
+	std::vector<std::unique_ptr<CWorkerProcess>> m_idle;
+	// workers handed out, or being started
+	uint32_t m_cBusy;
+	uint32_t m_cStarted;
+};
+
+// CDocumentExtractor run in a worker process: the same chunks, from the same IByteSource.
+//
+// The worker reads the document through the channel, so a property-only pass still reads
+// little more than the trailer. The bytes are read on the calling thread, as PDFium would.
+class CRemoteExtractor
+{
+public:
+	CRemoteExtractor();
+	// Gives the worker back.
+	~CRemoteExtractor();
+
+	// Same as CDocumentExtractor. Set before Open().
+	void SetMaxChunkChars(uint32_t cchMaxChunk)
+	{
+		m_cchMaxChunk = cchMaxChunk;
+	}
+
+	void SetBudget(const ExtractionBudget& budget)
+	{
+		m_budget = budget;
+	}
+
+	void SetLayout(TEXTLAYOUT layout)
+	{
+		m_layout = layout;
+	}
+
+	// May change until the first Step().
+	void SetEmitFilter(uint32_t propertyMask, bool fPages)
+	{
+		m_propertyMask = propertyMask;
+		m_fEmitPages = fPages;
+	}
+
+	// Takes a worker from pool for the next document. Returns false if none is available within msWait.
+	bool Attach(CWorkerPool& pool, uint32_t msWait);
+
+	bool IsAttached() const
+	{
+		return m_pWorker != NULL;
+	}
+
+	// pSource must outlive the document. Returns false if it is not a readable PDF, or if the worker
+	// was lost (IsWorkerLost).
+	bool Open(IByteSource* pSource);
+	// Ends the document and gives the worker back to the pool.
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_fOpen;
+	}
+
+	int GetPageCount() const
+	{
+		return m_numPages;
+	}
+
+	uint32_t GetTruncation() const
+	{
+		return m_truncation;
+	}
+
+	uint32_t GetPagesWithoutText() const
+	{
+		return m_cPagesWithoutText;
+	}
+
+	uint32_t GetPagesWithUnicodeErrors() const
+	{
+		return m_cPagesWithUnicodeErrors;
+	}
+
+	// Emits the next chunk, if there is one at this step, to sink.
+	// Returns false when the document has no more chunks, or when the worker was lost.
+	bool Step(IChunkSink& sink);
+
+	// The worker crashed, hung past the budget or broke the protocol on this document.
+	bool IsWorkerLost() const
+	{
+		return m_fLost;
+	}
+
+private:
+	CRemoteExtractor(const CRemoteExtractor&);
+	CRemoteExtractor& operator=(const CRemoteExtractor&);
+
+	// Sends a request and serves the worker until its reply of replyType, which goes to reply.
+	// Chunks go to pSink. Returns false and marks the worker lost if it does not answer.
+	bool Call(uint32_t type, const void* pBody, uint32_t cbBody, uint32_t replyType, void* pReply, uint32_t cbReply, IChunkSink* pSink);
+
+	CWorkerPool* m_pPool;
+	std::unique_ptr<CWorkerProcess> m_pWorker;
+	IByteSource* m_pSource;
+	std::vector<uint8_t> m_message;
+	// the TEXT message of the last step, which the sink may read until the next
+	std::vector<uint8_t> m_chunkMessage;
+
+	uint32_t m_cchMaxChunk;
+	ExtractionBudget m_budget;
+	TEXTLAYOUT m_layout;
+	uint32_t m_propertyMask;
+	bool m_fEmitPages;
+
+	bool m_fOpen;
+	bool m_fDone;
+	bool m_fLost;
+	int m_numPages;
+	uint32_t m_truncation;
+	uint32_t m_cPagesWithoutText;
+	uint32_t m_cPagesWithUnicodeErrors;
+};
@@ -0,0 +1,333 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+// PdfTraceDump: sums up the trace files CTrace writes.
+//
+//   PdfTraceDump [--top N] [--chrome out.json] trace...
+//
+// The trace comes from PDFTEXT_TRACE=file in the tools and PdfWorker, or from TraceFile in the
+// filter: one JSON line per span. Prints per span kind the count and the duration percentiles,
+// the totals of the documents (pages, chars, chunks, GetBlock reads and the time blocked in them)
+// and the N slowest documents (10 by default).
+// --chrome also wraps the lines into a trace for chrome://tracing and Perfetto.
+//
+// A line cut short by a killed process is skipped.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// A span as written by CTrace: the top level members, and those of "args" with an "args." prefix.
+struct Span
+{
+	std::map<std::string, std::string> strings;
+	std::map<std::string, double> numbers;
+
+	double Number(const char* key) const
+	{
+		std::map<std::string, double>::const_iterator it = numbers.find(key);
+		return (it != numbers.end()) ? it->second : 0;
+	}
+
+	std::string String(const char* key) const
+	{
+		std::map<std::string, std::string>::const_iterator it = strings.find(key);
+		return (it != strings.end()) ? it->second : std::string();
+	}
+};
+
+// Just enough JSON for the lines of CTrace: objects of strings, numbers and objects.
+class CLineParser
+{
+public:
+	CLineParser(const std::string& line) : m_line(line), m_pos(0)
+	{
+	}
+
+	bool Parse(Span& span)
+	{
+		return ParseObject(span, std::string()) && (SkipSpaces(), m_pos == m_line.size());
+	}
+
+private:
+	void SkipSpaces()
+	{
+		while (m_pos < m_line.size() && (m_line[m_pos] == ' ' || m_line[m_pos] == '\t' || m_line[m_pos] == '\r'))
+		{
+			m_pos++;
+		}
+	}
+
+	bool Accept(char ch)
+	{
+		SkipSpaces();
+		if (m_pos < m_line.size() && m_line[m_pos] == ch)
+		{
+			m_pos++;
+			return true;
+		}
+		return false;
+	}
+
+	bool ParseString(std::string& value)
+	{
+		if (!Accept('"'))
+		{
+			return false;
+		}
+		value.clear();
+		while (m_pos < m_line.size())
+		{
+			char ch = m_line[m_pos++];
+			if (ch == '"')
+			{
+				return true;
+			}
+			if (ch == '\\' && m_pos < m_line.size())
+			{
+				ch = m_line[m_pos++];
+				if (ch == 'u' && m_pos + 4 <= m_line.size())
+				{
+					// CTrace escapes control characters only
+					ch = static_cast<char>(strtoul(m_line.substr(m_pos, 4).c_str(), NULL, 16));
+					m_pos += 4;
+				}
+			}
+			value += ch;
+		}
+		return false;
+	}
+
+	bool ParseObject(Span& span, const std::string& prefix)
+	{
+		if (!Accept('{'))
+		{
+			return false;
+		}
+		if (Accept('}'))
+		{
+			return true;
+		}
+		do
+		{
+			std::string key;
+			if (!ParseString(key) || !Accept(':'))
+			{
+				return false;
+			}
+			SkipSpaces();
+			if (m_pos == m_line.size())
+			{
+				return false;
+			}
+			if (m_line[m_pos] == '{')
+			{
+				if (!ParseObject(span, prefix + key + "."))
+				{
+					return false;
+				}
+			}
+			else if (m_line[m_pos] == '"')
+			{
+				std::string value;
+				if (!ParseString(value))
+				{
+					return false;
+				}
+				span.strings[prefix + key] = value;
+			}
+			else
+			{
+				const char* pStart = m_line.c_str() + m_pos;
+				char* pEnd;
+				double value = strtod(pStart, &pEnd);
+				if (pEnd == pStart)
+				{
+					return false;
+				}
+				m_pos += pEnd - pStart;
+				span.numbers[prefix + key] = value;
+			}
+		} while (Accept(','));
+		return Accept('}');
+	}
+
+	const std::string& m_line;
+	size_t m_pos;
+};
+
+struct DocumentSpan
+{
+	double ms;
+	double pages;
+	double blockMs;
+	double pid;
+	double doc;
+	std::string file;
+};
+
+double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+	size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.999999);
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+int main(int argc, char** argv)
+{
+	size_t cTop = 10;
+	std::string chromePath;
+	int argi = 1;
+	for (; argi + 1 < argc && strncmp(argv[argi], "--", 2) == 0; argi += 2)
+	{
+		if (strcmp(argv[argi], "--top") == 0)
+		{
+			cTop = strtoul(argv[argi + 1], NULL, 10);
+		}
+		else if (strcmp(argv[argi], "--chrome") == 0)
+		{
+			chromePath = argv[argi + 1];
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (argc <= argi)
+	{
+		std::cerr << "PdfTraceDump [--top N] [--chrome out.json] trace..." << std::endl;
+		return 1;
+	}
+
+	std::ofstream chrome;
+	if (!chromePath.empty())
+	{
+		chrome.open(chromePath, std::ios::binary);
+		if (!chrome)
+		{
+			std::cerr << "can't write " << chromePath << std::endl;
+			return 1;
+		}
+		chrome << "{\"traceEvents\":[\n";
+	}
+
+	// durations in ms by span kind
+	std::map<std::string, std::vector<double>> durations;
+	std::vector<DocumentSpan> documents;
+	double pages = 0, chars = 0, chunks = 0, blockCalls = 0, blockBytes = 0, blockMs = 0, documentMs = 0;
+	int cTruncated = 0, cMalformed = 0;
+	bool fFirst = true;
+	for (; argi < argc; argi++)
+	{
+		std::ifstream in(argv[argi], std::ios::binary);
+		if (!in)
+		{
+			std::cerr << "can't read " << argv[argi] << std::endl;
+			return 1;
+		}
+		std::string line;
+		while (std::getline(in, line))
+		{
+			Span span;
+			if (line.empty())
+			{
+				continue;
+			}
+			if (!CLineParser(line).Parse(span) || span.String("name").empty())
+			{
+				cMalformed++;
+				continue;
+			}
+			if (chrome.is_open())
+			{
+				chrome << (fFirst ? "" : ",\n") << line;
+				fFirst = false;
+			}
+
+			std::string name = span.String("name");
+			double ms = span.Number("dur") / 1000;
+			durations[name].push_back(ms);
+			if (name == "Document")
+			{
+				DocumentSpan document = { ms, span.Number("args.pages"), span.Number("args.blockUs") / 1000,
+					span.Number("pid"), span.Number("args.doc"), span.String("args.file") };
+				documents.push_back(document);
+				pages += document.pages;
+				chars += span.Number("args.chars");
+				chunks += span.Number("args.chunks");
+				blockCalls += span.Number("args.blockCalls");
+				blockBytes += span.Number("args.blockBytes");
+				blockMs += document.blockMs;
+				documentMs += ms;
+				cTruncated += (span.Number("args.flags") != 0) ? 1 : 0;
+			}
+		}
+	}
+	if (chrome.is_open())
+	{
+		chrome << "\n]}\n";
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "span             count      total ms     p50 ms     p95 ms     max ms" << std::endl;
+	for (std::map<std::string, std::vector<double>>::iterator it = durations.begin(); it != durations.end(); ++it)
+	{
+		std::vector<double>& ms = it->second;
+		std::sort(ms.begin(), ms.end());
+		double total = 0;
+		for (double d : ms)
+		{
+			total += d;
+		}
+		std::cout << std::left << std::setw(14) << it->first << std::right
+			<< std::setw(8) << ms.size()
+			<< std::setw(14) << total
+			<< std::setw(11) << Percentile(ms, 50)
+			<< std::setw(11) << Percentile(ms, 95)
+			<< std::setw(11) << ms.back() << std::endl;
+	}
+
+	std::cout << std::endl
+		<< "documents        " << documents.size() << " (" << cTruncated << " truncated)" << std::endl
+		<< "pages            " << static_cast<uint64_t>(pages) << std::endl
+		<< "chunks           " << static_cast<uint64_t>(chunks) << " (" << static_cast<uint64_t>(chars) << " chars)" << std::endl
+		<< "GetBlock         " << static_cast<uint64_t>(blockCalls) << " calls, " << static_cast<uint64_t>(blockBytes) << " bytes, "
+		<< blockMs << " ms blocked (" << ((documentMs > 0) ? blockMs * 100 / documentMs : 0) << "% of the document time)" << std::endl;
+	if (cMalformed != 0)
+	{
+		std::cout << "skipped          " << cMalformed << " malformed lines" << std::endl;
+	}
+
+	std::sort(documents.begin(), documents.end(), [](const DocumentSpan& a, const DocumentSpan& b) { return b.ms < a.ms; });
+	if (cTop != 0 && !documents.empty())
+	{
+		std::cout << std::endl << "slowest documents      ms   pages  blocked ms  document" << std::endl;
+		for (size_t x = 0; x < documents.size() && x < cTop; x++)
+		{
+			const DocumentSpan& document = documents[x];
+			std::cout << "  " << std::setw(20) << document.ms
+				<< std::setw(8) << static_cast<uint64_t>(document.pages)
+				<< std::setw(12) << document.blockMs << "  ";
+			if (document.file.empty())
+			{
+				std::cout << "pid " << static_cast<uint64_t>(document.pid) << " doc " << static_cast<uint64_t>(document.doc);
+			}
+			else
+			{
+				std::cout << document.file;
+			}
+			std::cout << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,438 @@
+// Copyright (c) 2025 HIRAOKA HYPERS TOOLS, Inc.
+
+// PdfWorker: extraction worker process of CWorkerPool.
+//
+//   PdfWorker --channel <protocol version> <connection> <shared memory> <shared size>
+//
+// Started by the pool with the worker ends of a CWorkerChannel; not meant to be run by hand.
+// Runs CDocumentExtractor for one document at a time and exits when the client goes away.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#ifdef __linux__
+#include <signal.h>
+#include <sys/prctl.h>
+#include <cstdio>
+#else
+#include <sys/resource.h>
+#endif
+#endif
+#include "../PdfTextCore/DocumentExtractor.h"
+#include "../PdfTextCore/PdfiumLibrary.h"
+#include "../PdfTextCore/Trace.h"
+#include "../PdfTextCore/WorkerChannel.h"
+
+// The document as the client reads it, through the channel: READ asks for a range, and the bytes
+// come back in the shared memory.
+//
+// Each READ is a round trip to the client, and PDFium reads in many small, scattered pieces. So the
+// reads go through a cache of whole blocks, as CBlockCache does in the filter: the missing blocks of
+// a read are fetched with one READ, and a read-ahead window that doubles while the reads stay
+// sequential fetches the following blocks with them.
+class CChannelByteSource : public IByteSource
+{
+public:
+	CChannelByteSource(CWorkerChannel& channel) : m_channel(channel), m_cbFile(0), m_fBroken(false), m_useClock(0), m_lastBlock(UINT64_MAX), m_cReadAheadWindow(0)
+	{
+	}
+
+	// A new document: the blocks of the previous one are dropped.
+	void SetSize(uint64_t cbFile)
+	{
+		m_cbFile = cbFile;
+		// no more slots than the file has blocks; the memory is kept for the next document
+		uint64_t cFileBlocks = (cbFile + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		size_t cSlots = (cFileBlocks < CACHE_BLOCKS) ? static_cast<size_t>(cFileBlocks) : CACHE_BLOCKS;
+		if (m_arena.size() < cSlots * BLOCK_SIZE)
+		{
+			m_arena.resize(cSlots * BLOCK_SIZE);
+		}
+		m_slots.assign(cSlots, Slot());
+		m_blockToSlot.clear();
+		m_useClock = 0;
+		m_lastBlock = UINT64_MAX;
+		m_cReadAheadWindow = 0;
+	}
+
+	// the client went away in the middle of a read
+	bool IsBroken() const
+	{
+		return m_fBroken;
+	}
+
+	uint64_t GetSize() const override
+	{
+		return m_cbFile;
+	}
+
+	bool Read(uint64_t position, uint8_t* pBuf, uint32_t size) override
+	{
+		if (m_cbFile < position || m_cbFile - position < size)
+		{
+			return false;
+		}
+		if (size == 0)
+		{
+			return true;
+		}
+		if (m_slots.size() / 2 * BLOCK_SIZE < size)
+		{
+			// would evict the blocks it is made of
+			return ReadChannel(position, pBuf, size);
+		}
+
+		uint64_t first = position / BLOCK_SIZE;
+		uint64_t last = (position + size - 1) / BLOCK_SIZE;
+		uint64_t lastFileBlock = (m_cbFile - 1) / BLOCK_SIZE;
+		bool fSequential = (first == m_lastBlock || first == m_lastBlock + 1);
+		if (!fSequential)
+		{
+			m_cReadAheadWindow = 0;
+		}
+
+		for (uint64_t block = first; block <= last; block++)
+		{
+			auto it = m_blockToSlot.find(block);
+			if (it == m_blockToSlot.end())
+			{
+				// the missing blocks of this read in one READ
+				uint32_t cBlocks = 1;
+				while (block + cBlocks <= last && m_blockToSlot.find(block + cBlocks) == m_blockToSlot.end())
+				{
+					cBlocks++;
+				}
+				if (fSequential && block + cBlocks > last)
+				{
+					uint32_t cMaxAhead = static_cast<uint32_t>(m_slots.size() / 2);
+					m_cReadAheadWindow = (m_cReadAheadWindow == 0) ? 1 : std::min(m_cReadAheadWindow * 2, cMaxAhead);
+					for (uint32_t x = 0; x < m_cReadAheadWindow && cBlocks < cMaxAhead; x++)
+					{
+						uint64_t next = block + cBlocks;
+						if (lastFileBlock < next || m_blockToSlot.find(next) != m_blockToSlot.end())
+						{
+							break;
+						}
+						cBlocks++;
+					}
+				}
+				if (!Fill(block, cBlocks))
+				{
+					return false;
+				}
+				it = m_blockToSlot.find(block);
+			}
+
+			Slot& slot = m_slots[it->second];
+			slot.lastUse = ++m_useClock;
+			uint32_t offset = static_cast<uint32_t>(position - block * BLOCK_SIZE);
+			uint32_t cb = std::min(slot.cbValid - offset, size);
+			memcpy(pBuf, &m_arena[it->second * BLOCK_SIZE + offset], cb);
+			pBuf += cb;
+			position += cb;
+			size -= cb;
+		}
+		m_lastBlock = last;
+		return true;
+	}
+
+	void Prefetch(uint64_t position, uint64_t size) override
+	{
+		RangeMessage range = { position, size };
+		if (!m_channel.Send(WORKERMESSAGE_PREFETCH, &range, sizeof(range)))
+		{
+			m_fBroken = true;
+		}
+	}
+
+private:
+	static const uint32_t BLOCK_SIZE = 64 * 1024;
+	// 4 MB at most, for a file as large
+	static const size_t CACHE_BLOCKS = 64;
+
+	struct Slot
+	{
+		uint64_t block;
+		uint64_t lastUse;
+		uint32_t cbValid;
+		bool fInUse;
+	};
+
+	// Fetches cBlocks blocks from block into the cache, with one READ per shared memory full.
+	bool Fill(uint64_t block, uint32_t cBlocks)
+	{
+		uint32_t cBlocksPerRead = std::max<uint32_t>(m_channel.GetSharedSize() / BLOCK_SIZE, 1);
+		for (uint32_t iBlock = 0; iBlock < cBlocks; iBlock += cBlocksPerRead)
+		{
+			uint64_t position = (block + iBlock) * BLOCK_SIZE;
+			uint64_t cbRun = std::min<uint64_t>(static_cast<uint64_t>(std::min(cBlocks - iBlock, cBlocksPerRead)) * BLOCK_SIZE, m_cbFile - position);
+			if (!ReadShared(position, static_cast<uint32_t>(cbRun)))
+			{
+				return false;
+			}
+			for (uint32_t ib = 0; ib < cbRun; ib += BLOCK_SIZE)
+			{
+				size_t iSlot = Evict();
+				Slot& slot = m_slots[iSlot];
+				slot.block = (position + ib) / BLOCK_SIZE;
+				slot.lastUse = ++m_useClock;
+				slot.cbValid = static_cast<uint32_t>(std::min<uint64_t>(BLOCK_SIZE, cbRun - ib));
+				slot.fInUse = true;
+				memcpy(&m_arena[iSlot * BLOCK_SIZE], m_channel.GetSharedMemory() + ib, slot.cbValid);
+				m_blockToSlot[slot.block] = iSlot;
+			}
+		}
+		return true;
+	}
+
+	// a free slot, or the least recently used one
+	size_t Evict()
+	{
+		size_t iVictim = 0;
+		for (size_t i = 0; i < m_slots.size(); i++)
+		{
+			if (!m_slots[i].fInUse)
+			{
+				return i;
+			}
+			if (m_slots[i].lastUse < m_slots[iVictim].lastUse)
+			{
+				iVictim = i;
+			}
+		}
+		m_blockToSlot.erase(m_slots[iVictim].block);
+		m_slots[iVictim].fInUse = false;
+		return iVictim;
+	}
+
+	// [position, position + size) straight from the client, in shared memory sized pieces
+	bool ReadChannel(uint64_t position, uint8_t* pBuf, uint32_t size)
+	{
+		while (size != 0)
+		{
+			uint32_t cbPiece = (size < m_channel.GetSharedSize()) ? size : m_channel.GetSharedSize();
+			if (!ReadShared(position, cbPiece))
+			{
+				return false;
+			}
+			memcpy(pBuf, m_channel.GetSharedMemory(), cbPiece);
+			position += cbPiece;
+			pBuf += cbPiece;
+			size -= cbPiece;
+		}
+		return true;
+	}
+
+	// One READ: [position, position + size) into the shared memory.
+	bool ReadShared(uint64_t position, uint32_t size)
+	{
+		RangeMessage range = { position, size };
+		uint32_t type;
+		DataMessage data;
+		if (!m_channel.Send(WORKERMESSAGE_READ, &range, sizeof(range))
+			|| !m_channel.Receive(type, m_message, 0)
+			|| type != WORKERMESSAGE_DATA || m_message.size() != sizeof(data))
+		{
+			m_fBroken = true;
+			return false;
+		}
+		memcpy(&data, m_message.data(), sizeof(data));
+		return data.fOk != 0;
+	}
+
+	CWorkerChannel& m_channel;
+	uint64_t m_cbFile;
+	bool m_fBroken;
+	std::vector<uint8_t> m_message;
+
+	// m_slots.size() blocks of BLOCK_SIZE bytes
+	std::vector<uint8_t> m_arena;
+	std::vector<Slot> m_slots;
+	std::unordered_map<uint64_t, size_t> m_blockToSlot;
+	uint64_t m_useClock;
+	// last block of the previous read, to tell sequential reads
+	uint64_t m_lastBlock;
+	// read-ahead in blocks, doubled on each sequential miss
+	uint32_t m_cReadAheadWindow;
+};
+
+// Hands the chunks of a step back to the client.
+class CChannelSink : public IChunkSink
+{
+public:
+	CChannelSink(CWorkerChannel& channel) : m_channel(channel), m_fBroken(false)
+	{
+	}
+
+	bool IsBroken() const
+	{
+		return m_fBroken;
+	}
+
+	void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override
+	{
+		PropertyMessage message = { static_cast<uint32_t>(property), PROPERTYTYPE_TEXT, 0 };
+		Send(WORKERMESSAGE_PROPERTY, &message, sizeof(message), value, cch);
+	}
+
+	void OnPropertyUInt32(PDFPROPERTY property, uint32_t value) override
+	{
+		PropertyMessage message = { static_cast<uint32_t>(property), PROPERTYTYPE_UINT32, value };
+		Send(WORKERMESSAGE_PROPERTY, &message, sizeof(message), NULL, 0);
+	}
+
+	void OnPropertyTime(PDFPROPERTY property, const UtcTime& time) override
+	{
+		PropertyMessage message = { static_cast<uint32_t>(property), PROPERTYTYPE_TIME, PackUtcTime(time) };
+		Send(WORKERMESSAGE_PROPERTY, &message, sizeof(message), NULL, 0);
+	}
+
+	void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language) override
+	{
+		TextMessage message = {};
+		message.pageIndex = pageIndex;
+		message.fContinued = fContinued ? 1U : 0U;
+		memcpy(message.language, language, std::min(strlen(language), MAX_LANGUAGE_CHARS));
+		Send(WORKERMESSAGE_TEXT, &message, sizeof(message), text, cch);
+	}
+
+private:
+	void Send(uint32_t type, const void* pBody, uint32_t cbBody, const char16_t* text, size_t cch)
+	{
+		if (!m_channel.Send(type, pBody, cbBody, text, static_cast<uint32_t>(cch * sizeof(char16_t))))
+		{
+			m_fBroken = true;
+		}
+	}
+
+	CWorkerChannel& m_channel;
+	bool m_fBroken;
+};
+
+// Resident memory, which the pool compares with its limit after each document.
+uint64_t GetWorkingSetBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#elif defined(__linux__)
+	unsigned long cPages = 0, cResidentPages = 0;
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (fp == NULL)
+	{
+		return 0;
+	}
+	if (fscanf(fp, "%lu %lu", &cPages, &cResidentPages) != 2)
+	{
+		cResidentPages = 0;
+	}
+	fclose(fp);
+	return static_cast<uint64_t>(cResidentPages) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+	// the peak: there is no portable current figure
+	struct rusage usage;
+	return (getrusage(RUSAGE_SELF, &usage) == 0) ? static_cast<uint64_t>(usage.ru_maxrss) : 0;
+#endif
+}
+
+// Serves the client until it goes away. Returns the exit code.
+int Serve(CWorkerChannel& channel)
+{
+	CChannelByteSource source(channel);
+	CDocumentExtractor pdf;
+	std::vector<uint8_t> message;
+	uint32_t type;
+	while (channel.Receive(type, message, 0))
+	{
+		bool fSent;
+		if (type == WORKERMESSAGE_OPEN && message.size() == sizeof(OpenMessage))
+		{
+			OpenMessage open;
+			memcpy(&open, message.data(), sizeof(open));
+			pdf.Close();
+			source.SetSize(open.cbFile);
+			pdf.SetMaxChunkChars(open.cchMaxChunk);
+			ExtractionBudget budget = { open.msDocument, open.msPage, open.cchDocument };
+			pdf.SetBudget(budget);
+			pdf.SetLayout((open.layout == TEXTLAYOUT_NONE || open.layout == TEXTLAYOUT_STRUCTURE) ? static_cast<TEXTLAYOUT>(open.layout) : TEXTLAYOUT_LINES);
+			pdf.SetEmitFilter(PDFPROPERTY_ALL, true);
+
+			OpenedMessage opened = {};
+			if (pdf.Open(&source))
+			{
+				opened.fOk = 1;
+				opened.numPages = pdf.GetPageCount();
+			}
+			fSent = !source.IsBroken() && channel.Send(WORKERMESSAGE_OPENED, &opened, sizeof(opened));
+		}
+		else if (type == WORKERMESSAGE_STEP && message.size() == sizeof(StepMessage))
+		{
+			StepMessage step;
+			memcpy(&step, message.data(), sizeof(step));
+			pdf.SetEmitFilter(step.propertyMask, step.fPages != 0);
+
+			CChannelSink sink(channel);
+			SteppedMessage stepped = {};
+			if (pdf.IsOpen() && pdf.Step(sink))
+			{
+				stepped.fMore = 1;
+			}
+			stepped.truncation = pdf.GetTruncation();
+			stepped.cPagesWithoutText = pdf.GetPagesWithoutText();
+			stepped.cPagesWithUnicodeErrors = pdf.GetPagesWithUnicodeErrors();
+			fSent = !source.IsBroken() && !sink.IsBroken() && channel.Send(WORKERMESSAGE_STEPPED, &stepped, sizeof(stepped));
+		}
+		else if (type == WORKERMESSAGE_CLOSE && message.empty())
+		{
+			pdf.Close();
+			ClosedMessage closed = { GetWorkingSetBytes() };
+			fSent = channel.Send(WORKERMESSAGE_CLOSED, &closed, sizeof(closed));
+		}
+		else
+		{
+			return 2;
+		}
+
+		if (!fSent)
+		{
+			break;
+		}
+	}
+
+	pdf.Close();
+	CPdfiumLibrary::Shutdown();
+	CTrace::Shutdown();
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || strcmp(argv[1], "--channel") != 0)
+	{
+		return 1;
+	}
+
+#ifdef __linux__
+	// go with the host even if it dies while we are stuck in PDFium
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+
+	// the documents of the worker go to ETW sessions, and to PDFTEXT_TRACE inherited from the host
+	CTrace::RegisterProvider();
+	CTrace::OpenFileFromEnvironment();
+
+	CWorkerChannel channel;
+	if (!channel.Attach(std::vector<std::string>(argv + 2, argv + argc)))
+	{
+		return 1;
+	}
+	return Serve(channel);
+}
@@ -1,150 +1,248 @@
 // UsePdfium.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
+// Prints what the filter emits for PDF files, through the same PdfTextCore code.
+// --batch extracts a whole tree in parallel to NDJSON instead, with a throughput summary.
+// Builds with UsePdfium.vcxproj on Windows and with CMake elsewhere.
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
-#include <atlbase.h>
-#include <atlstr.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 #include <fpdfview.h>
-#include <fpdf_doc.h>
 #include <fpdf_text.h>
-#include <fcntl.h>
-#include <io.h>
-
-struct DRect {
-	// left
-	double l;
-	// top (PDF coord, up is plus)
-	double t;
-	// right
-	double r;
-	// bottom (PDF coord, up is plus)
-	double b;
-
-	bool SeemsToContinue(const DRect& prev) const
+#include "../PdfTextCore/DocumentExtractor.h"
+#include "../PdfTextCore/FileByteSource.h"
+#include "../PdfTextCore/PageTextExtractor.h"
+#include "../PdfTextCore/PdfiumLibrary.h"
+#include "../PdfTextCore/ScratchText.h"
+#include "../PdfTextCore/Trace.h"
+#include "../PdfTextCore/Utf.h"
+#include "../PdfTextCore/WorkerPool.h"
+
+namespace fs = std::filesystem;
+typedef std::chrono::steady_clock Clock;
+
+// --runs: print the runs of each page with their rectangles instead of the chunks
+bool g_fRuns = false;
+// --compare: print both extractions of each page instead of the runs
+bool g_fCompare = false;
+int g_numComparedPages = 0;
+int g_numDifferentPages = 0;
+// the legacy text of every compared page
+CScratchText g_legacyText;
+// --worker: extract in a PdfWorker process, which must print the same chunks
+CWorkerPool g_workerPool;
+// --layout none|lines|structure: how the runs of a page are joined
+TEXTLAYOUT g_layout = TEXTLAYOUT_LINES;
+
+// Prints the chunks as the filter would hand them to the indexer.
+class CPrintSink : public IChunkSink
+{
+public:
+	void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override
 	{
-		double h = t - b;
-		double sharedHeight = std::fmin(t, prev.t) - std::fmax(b, prev.b);
-		return true
-			&& (prev.r <= l && l < prev.r + h / 2)
-			&& h * 0.5 <= sharedHeight
-			;
+		std::string text;
+		AppendUtf8(text, value, cch);
+		std::cout << PropertyName(property) << ": " << text << '\n';
+	}
+
+	void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char* language) override
+	{
+		std::string utf8;
+		AppendUtf8(utf8, text, cch);
+		// no flush per chunk: a long document would be written a line at a time
+		std::cout << (fContinued ? " Continued " : "Page ") << pageIndex;
+		if (*language != '\0')
+		{
+			std::cout << " (" << language << ")";
+		}
+		std::cout << '\n' << " `" << utf8 << "`" << '\n';
 	}
 };
 
-int Apply(LPCWSTR pdfFile)
+// The former extraction of the filter, one FPDFText_GetBoundedText per FPDFText_GetRect rectangle.
+// This is the golden output CPageTextExtractor is compared against. The filter cut a rectangle at
+// 2048 characters; here the size is asked first, so that a long run doesn't show as a difference.
+std::u16string ExtractLegacyText(FPDF_TEXTPAGE textPage, CScratchText& scratch)
 {
-	std::wcout << L"--- " << pdfFile << std::endl;
+	scratch.Clear();
+	int numRects = FPDFText_CountRects(textPage, 0, -1);
+	for (int x = 0; x < numRects; x++) {
+		DblRect rect;
+		if (FPDFText_GetRect(textPage, x, &rect.l, &rect.t, &rect.r, &rect.b)) {
+			// the size comes in wide characters: where they are 32 bits, each may take two UTF-16 units
+			int cch = FPDFText_GetBoundedText(textPage, rect.l, rect.t, rect.r, rect.b, NULL, 0);
+			if (cch <= 0) {
+				continue;
+			}
+			int cchBuffer = cch * ((sizeof(wchar_t) == sizeof(char16_t)) ? 1 : 2) + 1;
+			size_t ich = scratch.GetSize();
+			char16_t* p = scratch.Extend(static_cast<size_t>(cchBuffer));
+			int numText = FPDFText_GetBoundedText(textPage, rect.l, rect.t, rect.r, rect.b, reinterpret_cast<unsigned short*>(p), cchBuffer);
+			// the count may include the terminator
+			while (1 <= numText && p[numText - 1] == 0) {
+				numText--;
+			}
+			scratch.Truncate(ich + static_cast<size_t>(std::max(numText, 0)));
+		}
+	}
+	return std::u16string(scratch.GetData(0), scratch.GetSize());
+}
 
-	CW2A test_doc(pdfFile, CP_UTF8);
-	FPDF_DOCUMENT doc = FPDF_LoadDocument(test_doc, NULL);
-	if (!doc) {
-		ULONG errorCode = FPDF_GetLastError();
-		std::wcout << L"& FPDF_LoadDocument failed with code: " << errorCode << std::endl;
-		return 1;
+std::u16string ExtractText(FPDF_TEXTPAGE textPage)
+{
+	std::u16string text;
+	CPageTextExtractor extractor;
+	extractor.Begin(textPage);
+	CPageTextExtractor::Run run;
+	while (extractor.ReadRun(run)) {
+		text.append(run.text, run.cch);
 	}
+	return text;
+}
 
-	const char* props[] = {
-		"Title",
-		"Author",
-		"Subject",
-		"Keywords",
-		"Creator",
-		"Producer",
-		"CreationDate",
-		"ModDate",
-		nullptr,
-	};
+void Compare(int pageIndex, FPDF_TEXTPAGE textPage)
+{
+	std::u16string legacy = ExtractLegacyText(textPage, g_legacyText);
+	std::u16string text = ExtractText(textPage);
 
-	WCHAR content[2048];
-	for (int x = 0; props[x]; x++) {
-		ULONG cb = FPDF_GetMetaText(doc, props[x], content, sizeof(WCHAR) * 2048);
-		if (cb != 0) {
-			std::wcout << props[x] << L": " << content << std::endl;
+	g_numComparedPages++;
+	if (legacy == text) {
+		std::cout << "Page " << pageIndex << " same" << std::endl;
+	}
+	else {
+		g_numDifferentPages++;
+		std::cout << "Page " << pageIndex << " differs" << std::endl
+			<< " - `" << ToUtf8(legacy) << "`" << std::endl
+			<< " + `" << ToUtf8(text) << "`" << std::endl;
+	}
+}
+
+void PrintRuns(FPDF_TEXTPAGE textPage)
+{
+	CPageTextExtractor extractor;
+	extractor.Begin(textPage);
+	CPageTextExtractor::Run run;
+	for (int x = 0; extractor.ReadRun(run); x++) {
+		std::string text;
+		AppendUtf8(text, run.text, run.cch);
+		std::cout << " Rect " << std::setw(3) << x
+			<< " " << std::setw(8) << run.rect.l
+			<< " " << std::setw(8) << run.rect.t
+			<< " " << std::setw(8) << run.rect.r
+			<< " " << std::setw(8) << run.rect.b
+			<< " "
+			<< (run.continuous ? "|" : "+")
+			<< " `" << text << "`"
+			<< std::endl;
+	}
+}
+
+int Apply(const fs::path& pdfFile)
+{
+	std::cout << "--- " << pdfFile.u8string() << std::endl;
+
+	CFileByteSource source;
+	if (g_workerPool.IsEnabled()) {
+		CRemoteExtractor remote;
+		remote.SetLayout(g_layout);
+		if (!source.Open(pdfFile.c_str()) || !remote.Attach(g_workerPool, 0) || !remote.Open(&source)) {
+			std::cout << "& loading failed" << (remote.IsWorkerLost() ? " in the worker" : "") << std::endl;
+			return 1;
 		}
-		else {
-			std::wcout << props[x] << L" not found." << std::endl;
-		}
-	}
-
-	int numPages = FPDF_GetPageCount(doc);
-	for (int y = 0; y < numPages; y++) {
-		FPDF_PAGE page = FPDF_LoadPage(doc, y);
-		if (page != NULL) {
-			std::wcout << L"Page " << y << std::endl;
-			FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
-			if (textPage != NULL) {
-				int numRects = FPDFText_CountRects(textPage, 0, -1);
-				DRect prevRect;
-				for (int x = 0; x < numRects; x++) {
-					DRect rect;
-					if (FPDFText_GetRect(textPage, x, &rect.l, &rect.t, &rect.r, &rect.b)) {
-						bool continuous = x != 0 && rect.SeemsToContinue(prevRect);
-						int numText = FPDFText_GetBoundedText(textPage, rect.l, rect.t, rect.r, rect.b, (PUSHORT)content, 2048);
-						if (1 <= numText) {
-							std::wcout << L" Rect " << std::setw(3) << x
-								<< L" " << std::setw(8) << rect.l
-								<< L" " << std::setw(8) << rect.t
-								<< L" " << std::setw(8) << rect.r
-								<< L" " << std::setw(8) << rect.b
-								<< L" "
-								<< (continuous ? L"|" : L"+")
-								<< L" `" << content << L"`"
-								<< std::endl;
-						}
-						prevRect = rect;
+		CPrintSink sink;
+		while (remote.Step(sink)) {
+		}
+		if (remote.IsWorkerLost()) {
+			std::cout << "& worker lost" << std::endl;
+			return 1;
+		}
+		std::cout << "EOD" << std::endl;
+		return 0;
+	}
+
+	CDocumentExtractor pdf;
+	pdf.SetLayout(g_layout);
+	pdf.SetTraceName(pdfFile.u8string());
+	if (!source.Open(pdfFile.c_str()) || !pdf.Open(&source)) {
+		unsigned long errorCode = FPDF_GetLastError();
+		std::cout << "& loading failed with code: " << errorCode << std::endl;
+		return 1;
+	}
+
+	if (g_fRuns || g_fCompare) {
+		FPDF_DOCUMENT doc = pdf.GetDocument();
+		int numPages = FPDF_GetPageCount(doc);
+		for (int y = 0; y < numPages; y++) {
+			FPDF_PAGE page = FPDF_LoadPage(doc, y);
+			if (page != NULL) {
+				std::cout << "Page " << y << std::endl;
+				FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+				if (textPage != NULL) {
+					if (g_fCompare) {
+						Compare(y, textPage);
+					}
+					else {
+						PrintRuns(textPage);
 					}
+					FPDFText_ClosePage(textPage);
 				}
-				FPDFText_ClosePage(textPage);
+				FPDF_ClosePage(page);
 			}
-			FPDF_ClosePage(page);
+		}
+	}
+	else {
+		CPrintSink sink;
+		while (pdf.Step(sink)) {
 		}
 	}
 
-	std::wcout << L"EOD" << std::endl;
-
-	FPDF_CloseDocument(doc);
+	std::cout << "EOD" << std::endl;
 	return 0;
 }
 
-int Walk(LPCWSTR path)
+bool IsPdf(const fs::path& path)
+{
+	std::string ext = path.extension().u8string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+	return ext == ".pdf";
+}
+
+int Walk(const fs::path& path)
 {
-	DWORD attr = GetFileAttributesW(path);
-	if (attr == INVALID_FILE_ATTRIBUTES)
+	std::error_code ec;
+	if (!fs::exists(path, ec))
 	{
 		return 1;
 	}
-	else if (attr & FILE_ATTRIBUTE_DIRECTORY)
+	else if (fs::is_directory(path, ec))
 	{
-		std::wcout << L"--- " << path << std::endl;
+		std::cout << "--- " << path.u8string() << std::endl;
 
-		_wfinddata_t fd;
-		intptr_t handle = _wfindfirst(CAtlStringW(path) + L"\\*", &fd);
-		if (handle != -1)
+		for (const fs::directory_entry& entry : fs::directory_iterator(path, ec))
 		{
-			do
+			if (entry.is_directory(ec))
 			{
-				if (wcscmp(fd.name, L".") != 0 && wcscmp(fd.name, L"..") != 0)
-				{
-					CAtlStringW fullPath = path;
-					fullPath += L"\\";
-					fullPath += fd.name;
-					if (fd.attrib & FILE_ATTRIBUTE_DIRECTORY)
-					{
-						Walk(fullPath);
-					}
-					else
-					{
-						// Check if the file is a PDF
-						if (fullPath.Right(4).CompareNoCase(L".pdf") == 0)
-						{
-							Apply(fullPath);
-						}
-					}
-				}
-			} while (_wfindnext(handle, &fd) == 0);
-
-			_findclose(handle);
+				Walk(entry.path());
+			}
+			else if (IsPdf(entry.path()))
+			{
+				Apply(entry.path());
+			}
 		}
 		return 0;
 	}
@@ -154,33 +252,471 @@ int Walk(LPCWSTR path)
 	}
 }
 
-int wmain(int argc, wchar_t** argv)
+// --batch: extracts a whole tree on several threads and writes what the indexer would receive,
+// one JSON object per document, to check a share before the indexer is pointed at it.
+struct BatchOptions
+{
+	// threads, each extracting one document at a time; in process they share PDFium (CPdfiumLock)
+	uint32_t cThreads;
+	// PdfWorker processes, one per thread; 0 extracts in process
+	uint32_t cWorkers;
+	uint32_t cchMaxChunk;
+	// NDJSON output, "-" for stdout
+	fs::path ndjsonPath;
+	// one <relative path>.json per document instead
+	fs::path outDir;
+};
+
+struct BatchDocument
+{
+	fs::path path;
+	uint64_t cbFile;
+};
+
+// Documents dealt out to the threads up front, largest first. A thread takes from the front of
+// its own deque and, once that is empty, steals from the back of another's, so that a thread held
+// up by a large document does not hold up the rest of its share.
+class CDocumentQueues
+{
+public:
+	CDocumentQueues(size_t cThreads) : m_cSteals(0) {
+		for (size_t x = 0; x < cThreads; x++) {
+			m_queues.emplace_back(new Queue);
+		}
+	}
+
+	void Deal(std::vector<BatchDocument>& documents) {
+		std::stable_sort(documents.begin(), documents.end(), [](const BatchDocument& a, const BatchDocument& b) { return a.cbFile > b.cbFile; });
+		for (size_t x = 0; x < documents.size(); x++) {
+			m_queues[x % m_queues.size()]->documents.push_back(std::move(documents[x]));
+		}
+	}
+
+	// Returns false once every deque is empty: nothing is added after Deal().
+	bool Take(size_t iThread, BatchDocument& document) {
+		for (size_t x = 0; x < m_queues.size(); x++) {
+			Queue& queue = *m_queues[(iThread + x) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.documents.empty()) {
+				if (x == 0) {
+					document = std::move(queue.documents.front());
+					queue.documents.pop_front();
+				}
+				else {
+					document = std::move(queue.documents.back());
+					queue.documents.pop_back();
+					m_cSteals++;
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint64_t GetStealCount() const {
+		return m_cSteals;
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<BatchDocument> documents;
+	};
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::atomic<uint64_t> m_cSteals;
+};
+
+// Appends UTF-8 text as the contents of a JSON string.
+void AppendJson(std::string& json, const std::string& text)
+{
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			json += '\\';
+			json += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+			json += escape;
+		}
+		else {
+			json += c;
+		}
+	}
+}
+
+// Writes the chunks of a document as one JSON object:
+//   {"path": ..., "ok": true, "pages": N, "truncation": 0, "ms": ...,
+//    "properties": {"Title": ...}, "text": [{"page": 0, "text": ...}, ...]}
+// The continued chunks of a page are joined back. Pages come in the order the filter emits them.
+class CJsonSink : public IChunkSink
+{
+public:
+	CJsonSink() : m_cchText(0), m_fInPage(false) {
+	}
+
+	void OnProperty(PDFPROPERTY property, const char16_t* value, size_t cch) override {
+		m_properties += m_properties.empty() ? "\"" : ", \"";
+		m_properties += PropertyName(property);
+		m_properties += "\": \"";
+		AppendText(m_properties, value, cch);
+		m_properties += '"';
+	}
+
+	void OnText(int pageIndex, const char16_t* text, size_t cch, bool fContinued, const char*) override {
+		if (!fContinued || !m_fInPage) {
+			m_pages += m_fInPage ? "\"}, {\"page\": " : "{\"page\": ";
+			m_pages += std::to_string(pageIndex);
+			m_pages += ", \"text\": \"";
+			m_fInPage = true;
+		}
+		AppendText(m_pages, text, cch);
+		m_cchText += cch;
+	}
+
+	// Appends the object, without a line break.
+	void Write(std::string& json, const std::string& path, bool fOk, const char* error, int cPages, uint32_t truncation, double ms) const {
+		json += "{\"path\": \"";
+		AppendJson(json, path);
+		json += fOk ? "\", \"ok\": true" : "\", \"ok\": false";
+		if (error != NULL) {
+			json += ", \"error\": \"";
+			json += error;
+			json += '"';
+		}
+		char numbers[96];
+		snprintf(numbers, sizeof(numbers), ", \"pages\": %d, \"truncation\": %u, \"ms\": %.3f", cPages, truncation, ms);
+		json += numbers;
+		json += ", \"properties\": {";
+		json += m_properties;
+		json += "}, \"text\": [";
+		json += m_pages;
+		json += m_fInPage ? "\"}]}" : "]}";
+	}
+
+	uint64_t m_cchText;
+
+private:
+	void AppendText(std::string& json, const char16_t* text, size_t cch) {
+		m_utf8.clear();
+		AppendUtf8(m_utf8, text, cch);
+		AppendJson(json, m_utf8);
+	}
+
+	std::string m_properties;
+	std::string m_pages;
+	bool m_fInPage;
+	std::string m_utf8;
+};
+
+// What a thread got through, summed up at the end.
+struct BatchTotals
 {
-	if (argc < 2) {
-		fputws(L"UsePdfium [input.pdf | dir]", stderr);
+	uint64_t cDocuments;
+	uint64_t cFailed;
+	uint64_t cWorkersLost;
+	uint64_t cPages;
+	uint64_t cbFiles;
+	uint64_t cchText;
+	uint64_t cbOutput;
+};
+
+// Where the JSON goes: lines appended to one buffered stream under a lock, or a file per document.
+class CBatchOutput
+{
+public:
+	bool Open(const BatchOptions& options, const fs::path& root) {
+		m_outDir = options.outDir;
+		m_root = fs::is_directory(root) ? root : root.parent_path();
+		if (!m_outDir.empty()) {
+			return true;
+		}
+		if (options.ndjsonPath == "-") {
+			m_pStream = &std::cout;
+			return true;
+		}
+		m_file.rdbuf()->pubsetbuf(m_buffer, sizeof(m_buffer));
+		m_file.open(options.ndjsonPath, std::ios::binary | std::ios::trunc);
+		m_pStream = &m_file;
+		return m_file.is_open();
+	}
+
+	bool Write(const fs::path& path, const std::string& json) {
+		if (m_outDir.empty()) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pStream->write(json.data(), json.size()).put('\n');
+			return m_pStream->good();
+		}
+
+		std::error_code ec;
+		fs::path outPath = m_outDir / path.lexically_relative(m_root);
+		outPath += ".json";
+		fs::create_directories(outPath.parent_path(), ec);
+		std::ofstream file(outPath, std::ios::binary | std::ios::trunc);
+		file.write(json.data(), json.size()).put('\n');
+		return file.good();
+	}
+
+	bool Close() {
+		if (m_pStream == NULL) {
+			return true;
+		}
+		m_pStream->flush();
+		return m_pStream->good();
+	}
+
+private:
+	std::ostream* m_pStream = NULL;
+	std::ofstream m_file;
+	char m_buffer[1024 * 1024];
+	std::mutex m_mutex;
+	fs::path m_outDir;
+	fs::path m_root;
+};
+
+void ExtractDocument(const BatchDocument& document, const BatchOptions& options, CBatchOutput& output, BatchTotals& totals, std::string& json)
+{
+	Clock::time_point start = Clock::now();
+	CJsonSink sink;
+	CFileByteSource source;
+	bool fOk = false;
+	const char* error = NULL;
+	int cPages = 0;
+	uint32_t truncation = TRUNCATION_NONE;
+	if (!source.Open(document.path.c_str())) {
+		error = "unreadable";
+	}
+	else if (g_workerPool.IsEnabled()) {
+		CRemoteExtractor remote;
+		remote.SetMaxChunkChars(options.cchMaxChunk);
+		remote.SetLayout(g_layout);
+		if (!remote.Attach(g_workerPool, 60 * 1000) || !remote.Open(&source)) {
+			error = remote.IsWorkerLost() ? "worker lost" : "loading failed";
+		}
+		else {
+			cPages = remote.GetPageCount();
+			while (remote.Step(sink)) {
+			}
+			truncation = remote.GetTruncation();
+			fOk = !remote.IsWorkerLost();
+			error = fOk ? NULL : "worker lost";
+		}
+		totals.cWorkersLost += remote.IsWorkerLost() ? 1 : 0;
+	}
+	else {
+		CDocumentExtractor pdf;
+		pdf.SetMaxChunkChars(options.cchMaxChunk);
+		pdf.SetLayout(g_layout);
+		pdf.SetTraceName(document.path.u8string());
+		if (!pdf.Open(&source)) {
+			error = "loading failed";
+		}
+		else {
+			cPages = pdf.GetPageCount();
+			while (pdf.Step(sink)) {
+			}
+			truncation = pdf.GetTruncation();
+			fOk = true;
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	json.clear();
+	sink.Write(json, document.path.u8string(), fOk, error, cPages, truncation, ms);
+	if (!output.Write(document.path, json)) {
+		fOk = false;
+	}
+
+	totals.cDocuments++;
+	totals.cFailed += fOk ? 0 : 1;
+	totals.cPages += cPages;
+	totals.cbFiles += document.cbFile;
+	totals.cchText += sink.m_cchText;
+	totals.cbOutput += json.size() + 1;
+}
+
+int RunBatch(const fs::path& root, const BatchOptions& options)
+{
+	// the whole tree first, so that the threads can be dealt their shares by size
+	std::vector<BatchDocument> documents;
+	std::error_code ec;
+	if (fs::is_directory(root, ec)) {
+		for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; it != end; it.increment(ec)) {
+			if (it->is_regular_file(ec) && IsPdf(it->path())) {
+				documents.push_back({ it->path(), it->file_size(ec) });
+			}
+		}
+	}
+	else if (fs::exists(root, ec)) {
+		documents.push_back({ root, fs::file_size(root, ec) });
+	}
+	if (documents.empty()) {
+		std::cerr << "no PDF in " << root.u8string() << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<CBatchOutput> pOutput(new CBatchOutput);
+	if (!pOutput->Open(options, root)) {
+		std::cerr << "can't write " << options.ndjsonPath.u8string() << std::endl;
 		return 1;
 	}
 
-	// [visual c++ - Why are certain Unicode characters causing std::wcout to fail in a console app? - Stack Overflow](https://stackoverflow.com/questions/19193429/why-are-certain-unicode-characters-causing-stdwcout-to-fail-in-a-console-app)
-	if (_setmode(_fileno(stdout), _O_U16TEXT) == -1) {
+	size_t cThreads = std::max<size_t>(1, std::min<size_t>(options.cThreads, documents.size()));
+	CDocumentQueues queues(cThreads);
+	queues.Deal(documents);
+
+	Clock::time_point start = Clock::now();
+	std::vector<BatchTotals> totals(cThreads, BatchTotals());
+	std::vector<std::thread> threads;
+	for (size_t x = 0; x < cThreads; x++) {
+		threads.emplace_back([&, x]() {
+			std::string json;
+			BatchDocument document;
+			while (queues.Take(x, document)) {
+				ExtractDocument(document, options, *pOutput, totals[x], json);
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	bool fWritten = pOutput->Close();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	BatchTotals sum = BatchTotals();
+	for (const BatchTotals& thread : totals) {
+		sum.cDocuments += thread.cDocuments;
+		sum.cFailed += thread.cFailed;
+		sum.cWorkersLost += thread.cWorkersLost;
+		sum.cPages += thread.cPages;
+		sum.cbFiles += thread.cbFiles;
+		sum.cchText += thread.cchText;
+		sum.cbOutput += thread.cbOutput;
+	}
+
+	// stderr, as the NDJSON may go to stdout
+	double mb = sum.cbFiles / (1024.0 * 1024.0);
+	std::cerr << std::fixed << std::setprecision(1)
+		<< "Batch: " << sum.cDocuments << " documents (" << sum.cFailed << " failed, " << sum.cWorkersLost << " workers lost), "
+		<< sum.cPages << " pages, " << mb << " MB, " << sum.cchText << " chars, " << sum.cbOutput << " bytes written" << std::endl
+		<< std::setprecision(2) << " " << seconds << " s, "
+		<< sum.cDocuments / seconds << " documents/s, " << sum.cPages / seconds << " pages/s, " << mb / seconds << " MB/s, "
+		<< cThreads << (options.cWorkers != 0 ? " workers" : " threads") << ", " << queues.GetStealCount() << " stolen" << std::endl;
+
+	return (sum.cFailed == 0 && fWritten) ? 0 : 1;
+}
+
+int Run(const fs::path& program, const std::vector<fs::path>& args)
+{
+	bool fWorker = false;
+	bool fBatch = false;
+	BatchOptions batch = BatchOptions();
+	batch.cThreads = std::max(1U, std::thread::hardware_concurrency());
+	batch.cchMaxChunk = 64 * 1024;
+	batch.ndjsonPath = "-";
+	size_t argi = 0;
+	for (; argi < args.size(); argi++) {
+		if (args[argi] == "--compare") {
+			g_fCompare = true;
+		}
+		else if (args[argi] == "--runs") {
+			g_fRuns = true;
+		}
+		else if (args[argi] == "--worker") {
+			fWorker = true;
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--layout") {
+			g_layout = LayoutFromName(args[++argi].u8string().c_str());
+		}
+		else if (args[argi] == "--batch") {
+			fBatch = true;
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--threads") {
+			batch.cThreads = std::max(1U, static_cast<uint32_t>(strtoul(args[++argi].u8string().c_str(), NULL, 10)));
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--workers") {
+			batch.cWorkers = static_cast<uint32_t>(strtoul(args[++argi].u8string().c_str(), NULL, 10));
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--max-chunk") {
+			batch.cchMaxChunk = static_cast<uint32_t>(strtoul(args[++argi].u8string().c_str(), NULL, 10));
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--ndjson") {
+			batch.ndjsonPath = args[++argi];
+		}
+		else if (argi + 1 < args.size() && args[argi] == "--out-dir") {
+			batch.outDir = args[++argi];
+		}
+		else {
+			break;
+		}
+	}
+
+	if (args.size() <= argi) {
+		std::cerr << "UsePdfium [--runs | --compare | --worker] [--layout none|lines|structure] [input.pdf | dir]" << std::endl
+			<< "UsePdfium --batch [--threads N | --workers N] [--max-chunk N] [--layout none|lines|structure] [--ndjson out.ndjson | --out-dir dir] [input.pdf | dir]" << std::endl;
 		return 1;
 	}
 
-	// [PDFium - Getting Started with PDFium](https://pdfium.googlesource.com/pdfium/+/HEAD/docs/getting-started.md)
+	if (fBatch && batch.cWorkers != 0) {
+		// a thread per worker
+		batch.cThreads = batch.cWorkers;
+	}
+	else if (fWorker) {
+		batch.cWorkers = 1;
+	}
+	if (batch.cWorkers != 0) {
+		fs::path workerPath = program.parent_path() / "PdfWorker";
+#ifdef _WIN32
+		workerPath += ".exe";
+#endif
+		g_workerPool.Open(workerPath.native(), batch.cWorkers, 0, 0);
+	}
 
-	FPDF_LIBRARY_CONFIG config;
-	config.version = 2;
-	config.m_pUserFontPaths = NULL;
-	config.m_pIsolate = NULL;
-	config.m_v8EmbedderSlot = 0;
+	if (fBatch) {
+		int exitCode = RunBatch(args[argi], batch);
+		CPdfiumLibrary::Shutdown();
+		return exitCode;
+	}
 
-	FPDF_InitLibraryWithConfig(&config);
+	// PDFium starts with the first document (CPdfiumLibrary)
+	int exitCode = Walk(args[argi]);
 
-	int exitCode = Walk(argv[1]);
+	if (g_fCompare) {
+		std::cout << "Compared " << g_numComparedPages << " pages, " << g_numDifferentPages << " differ"
+			<< " (legacy text grown " << g_legacyText.GetGrowthCount() << " times)" << std::endl;
+		if (exitCode == 0 && g_numDifferentPages != 0) {
+			exitCode = 2;
+		}
+	}
+
+	CPdfiumLibrary::Shutdown();
+	return exitCode;
+}
 
-	FPDF_DestroyLibrary();
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv)
+{
+	// the output is UTF-8
+	SetConsoleOutputCP(CP_UTF8);
+
+	// PDFTEXT_TRACE=file traces the extraction, see PdfTraceDump
+	CTrace::OpenFileFromEnvironment();
+	int exitCode = Run(argv[0], std::vector<fs::path>(argv + 1, argv + argc));
+	CTrace::Shutdown();
+	return exitCode;
+}
+#else
+int main(int argc, char** argv)
+{
+	// PDFTEXT_TRACE=file traces the extraction, see PdfTraceDump
+	CTrace::OpenFileFromEnvironment();
+	int exitCode = Run(argv[0], std::vector<fs::path>(argv + 1, argv + argc));
+	CTrace::Shutdown();
 	return exitCode;
 }
+#endif
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
 // Debug program: F5 or Debug > Start Debugging menu